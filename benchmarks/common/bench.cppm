@@ -0,0 +1,126 @@
+
+module;
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+export module bench;
+
+namespace bench {
+
+export using Clock = std::chrono::steady_clock;
+
+export auto nowNs() -> uint64_t {
+    //
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now().time_since_epoch() ).count();
+}
+
+// Keep value alive from optimizer point of view.
+export template <typename T>
+auto doNotOptimize( const T &value ) -> void {
+    asm volatile( "" : : "r,m"( value ) : "memory" );
+}
+
+// Run body `iterations` times and return nanoseconds per iteration.
+export template <typename F>
+auto nsPerOp( uint64_t iterations, F &&body ) -> double {
+    const auto start = nowNs();
+    for ( uint64_t i = 0; i < iterations; ++i ) {
+        body( i );
+    }
+    return static_cast<double>( nowNs() - start ) / static_cast<double>( iterations );
+}
+
+export using Params = std::vector<std::pair<std::string, std::string>>;
+export using Values = std::vector<std::pair<std::string, double>>;
+
+// Numeric command line option "--name value", fallback when absent or malformed.
+export template <typename T>
+auto option( int argc, char **argv, std::string_view name, T fallback ) -> T {
+    for ( int i = 1; i + 1 < argc; ++i ) {
+        if ( name == argv[i] ) {
+            auto value = T{};
+            const auto *end = argv[i + 1] + std::strlen( argv[i + 1] );
+            if ( const auto [ptr, ec] = std::from_chars( argv[i + 1], end, value ); ec == std::errc{} && ptr == end ) {
+                return value;
+            }
+        }
+    }
+    return fallback;
+}
+
+// Percentiles of raw samples (sorted in place), keys prefixed with `prefix`.
+export auto percentiles( std::vector<uint64_t> &samples, std::string_view prefix ) -> Values {
+    if ( samples.empty() ) {
+        return {};
+    }
+
+    std::sort( samples.begin(), samples.end() );
+    const auto at = [&samples]( double q ) -> double {
+        return static_cast<double>( samples[static_cast<size_t>( q * static_cast<double>( samples.size() - 1 ) )] );
+    };
+
+    const auto key = [prefix]( std::string_view name ) -> std::string {
+        auto result = std::string{ prefix };
+        result += name;
+        return result;
+    };
+
+    return {
+      { key( "p50" ), at( 0.5 ) },
+      { key( "p90" ), at( 0.9 ) },
+      { key( "p99" ), at( 0.99 ) },
+      { key( "p999" ), at( 0.999 ) },
+      { key( "max" ), static_cast<double>( samples.back() ) } };
+}
+
+// Machine readable benchmark output. Every benchmark binary prints one
+// JSON document to stdout:
+//
+// { "suite": "...", "results": [ { "name": "...", "params": {...}, "values": {...} }, ... ] }
+//
+// so results can be stored and diffed between releases.
+export struct Report final {
+    explicit Report( std::string suite )
+        : suite_{ std::move( suite ) } {}
+
+    Report( const Report &other ) = delete;
+    auto operator=( const Report &other ) -> Report & = delete;
+
+    ~Report() = default;
+
+    auto add( std::string_view name, const Params &params, const Values &values ) -> void {
+        auto entry = nlohmann::json{ { "name", name } };
+        for ( const auto &[key, value] : params ) {
+            entry["params"][key] = value;
+        }
+        for ( const auto &[key, value] : values ) {
+            entry["values"][key] = value;
+        }
+        // Progress goes to stderr, stdout stays valid JSON.
+        std::cerr << entry.dump() << '\n';
+
+        results_.push_back( std::move( entry ) );
+    }
+
+    auto print() const -> void {
+        const auto doc = nlohmann::json{ { "suite", suite_ }, { "results", results_ } };
+        std::cout << doc.dump( 2 ) << '\n';
+    }
+
+private:
+    std::string suite_;
+    nlohmann::json results_ = nlohmann::json::array();
+};
+
+}  // namespace bench
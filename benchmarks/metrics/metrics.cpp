@@ -0,0 +1,107 @@
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <curl/curl.h>
+
+import poller;
+import bench;
+
+// Cost of the metrics hooks Poller runs per request (host lookup, submit,
+// two clock reads and completion accounting) compared with an empty loop.
+// A real loopback HTTP round trip is tens of microseconds, so anything in
+// the tens of nanoseconds here is noise on the request path.
+
+constexpr uint64_t kIterations = 10'000'000;
+
+auto recordOnce( poller::Metrics &metrics, uint64_t i ) -> void {
+    const auto host = metrics.hostId( "api.example.com" );
+    metrics.onSubmit( host );
+    const auto started = std::chrono::steady_clock::now();
+    const auto latency =
+      std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - started );
+    metrics.onComplete( host, CURLE_OK, 200, static_cast<uint64_t>( latency.count() ) + ( i & 1023 ), 512, 0 );
+}
+
+auto main( int argc, char **argv ) -> int {
+    auto report = bench::Report{ "metrics" };
+
+    {
+        const auto ns = bench::nsPerOp( kIterations, []( uint64_t i ) -> void { bench::doNotOptimize( i ); } );
+        report.add( "empty_loop", {}, { { "ns_per_op", ns } } );
+    }
+
+    {
+        const auto ns = bench::nsPerOp( kIterations, []( uint64_t ) -> void {
+            //
+            bench::doNotOptimize( std::chrono::steady_clock::now() );
+        } );
+        report.add( "steady_clock_now", {}, { { "ns_per_op", ns } } );
+    }
+
+    {
+        auto metrics = poller::Metrics{};
+        const auto ns = bench::nsPerOp( kIterations, [&metrics]( uint64_t ) -> void {
+            //
+            bench::doNotOptimize( metrics.hostId( "api.example.com" ) );
+        } );
+        report.add( "host_lookup", {}, { { "ns_per_op", ns } } );
+    }
+
+    {
+        auto metrics = poller::Metrics{};
+        const auto host = metrics.hostId( "api.example.com" );
+        const auto ns = bench::nsPerOp( kIterations, [&metrics, host]( uint64_t i ) -> void {
+            metrics.onSubmit( host );
+            metrics.onComplete( host, CURLE_OK, 200, i & 4095, 512, 0 );
+        } );
+        report.add( "submit_complete", {}, { { "ns_per_op", ns } } );
+    }
+
+    // Full per-request hook sequence, from 1 up to hardware_concurrency
+    // threads hammering the same registry. Per-thread shards should keep
+    // ns/op flat as threads are added.
+    for ( unsigned threads = 1; threads <= std::max( 1u, std::thread::hardware_concurrency() ); threads *= 2 ) {
+        auto metrics = poller::Metrics{};
+        auto total = std::atomic<uint64_t>{ 0 };
+        auto workers = std::vector<std::jthread>{};
+
+        for ( unsigned t = 0; t < threads; ++t ) {
+            workers.emplace_back( [&metrics, &total]() -> void {
+                const auto start = bench::nowNs();
+                for ( uint64_t i = 0; i < kIterations / 4; ++i ) {
+                    recordOnce( metrics, i );
+                }
+                total += bench::nowNs() - start;
+            } );
+        }
+        workers.clear();
+
+        const auto ns = static_cast<double>( total.load() ) / static_cast<double>( threads * ( kIterations / 4 ) );
+        report.add( "request_hooks", { { "threads", std::to_string( threads ) } }, { { "ns_per_op", ns } } );
+    }
+
+    {
+        auto metrics = poller::Metrics{};
+        for ( int h = 0; h < 16; ++h ) {
+            const auto host = metrics.hostId( "host-" + std::to_string( h ) );
+            for ( uint64_t i = 0; i < 1000; ++i ) {
+                metrics.onSubmit( host );
+                metrics.onComplete( host, CURLE_OK, 200, i * 37, 512, 0 );
+            }
+        }
+        const auto ns = bench::nsPerOp( 100, [&metrics]( uint64_t ) -> void {
+            //
+            bench::doNotOptimize( metrics.prometheus().size() );
+        } );
+        report.add( "prometheus_dump", { { "hosts", "16" } }, { { "ns_per_op", ns } } );
+    }
+
+    report.print();
+
+    return 0;
+}
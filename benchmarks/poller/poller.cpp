@@ -0,0 +1,245 @@
+
+// Open-loop end-to-end Poller benchmark.
+//
+// Requests are issued on a fixed schedule (request i is due at
+// start + i / rate) no matter how fast responses come back, so a slow
+// server or a stalled client can't throttle the load (coordinated
+// omission). Corrected latency is measured from the scheduled send time,
+// uncorrected one from the moment the request was actually handed to
+// Poller; a large gap between the two means the client itself could not
+// keep up with requested rate.
+//
+// Meant to run against the local uvtcp server:
+//
+//   uvtcp --port 10000 --size 1024 &
+//   poller_bench --url http://127.0.0.1:10000/ --rate 2000 --duration 10 [--workers 4] [--h2]
+//
+// Prints JSON report to stdout.
+
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+import poller;
+import poller_std;
+import bench;
+
+using namespace std::chrono_literals;
+
+namespace {
+
+struct Options {
+    std::string url{ "http://127.0.0.1:10000/" };
+    uint64_t rate{ 1000 };
+    uint64_t duration{ 10 };
+    uint64_t warmup{ 1 };
+    long timeout{ 10 };
+    // Threads resuming request coroutines, 0 resumes on curl thread.
+    unsigned workers{ 0 };
+    bool h2{ false };
+};
+
+template <typename T>
+auto parseNumber( std::string_view text, T &value ) -> bool {
+    const auto [ptr, ec] = std::from_chars( text.data(), text.data() + text.size(), value );
+    return ec == std::errc{} && ptr == text.data() + text.size();
+}
+
+auto parseArgs( int argc, char **argv, Options &options ) -> bool {
+    for ( int i = 1; i < argc; ++i ) {
+        const auto arg = std::string_view{ argv[i] };
+        if ( arg == "--h2" ) {
+            options.h2 = true;
+            continue;
+        }
+
+        const auto value = i + 1 < argc ? std::string_view{ argv[++i] } : std::string_view{};
+        auto ok = !value.empty();
+
+        if ( arg == "--url" ) {
+            options.url = value;
+        } else if ( arg == "--rate" ) {
+            ok = ok && parseNumber( value, options.rate ) && options.rate > 0;
+        } else if ( arg == "--duration" ) {
+            ok = ok && parseNumber( value, options.duration );
+        } else if ( arg == "--warmup" ) {
+            ok = ok && parseNumber( value, options.warmup );
+        } else if ( arg == "--timeout" ) {
+            ok = ok && parseNumber( value, options.timeout );
+        } else if ( arg == "--workers" ) {
+            ok = ok && parseNumber( value, options.workers );
+        } else {
+            ok = false;
+        }
+
+        if ( !ok ) {
+            std::fprintf( stderr, "bad argument: %s\n", arg.data() );
+            return false;
+        }
+    }
+    return true;
+}
+
+struct BenchClient final : poller::Poller {
+    BenchClient( Options options, poller::pstd::Executor &executor )
+        : poller::Poller{ executor }
+        , options_{ std::move( options ) } {}
+
+    BenchClient( const BenchClient &other ) = delete;
+    BenchClient( BenchClient &&other ) = delete;
+
+    auto operator=( const BenchClient &other ) -> BenchClient & = delete;
+    auto operator=( BenchClient &&other ) -> BenchClient & = delete;
+
+    ~BenchClient() = default;
+
+    auto run() -> void override {
+        const auto interval = std::chrono::nanoseconds{ 1'000'000'000 / options_.rate };
+        const auto warmup = options_.rate * options_.warmup;
+        total_ = options_.rate * ( options_.warmup + options_.duration );
+
+        const auto start = bench::Clock::now() + 10ms;
+        for ( uint64_t i = 0; i < total_; ++i ) {
+            const auto intended = start + i * interval;
+            std::this_thread::sleep_until( intended );
+
+            if ( i == warmup ) {
+                measureStart_ = bench::Clock::now();
+            }
+
+            auto req = poller::HttpRequestGet{};
+            req.setUrl( options_.url ).setTimeout( options_.timeout );
+            if ( options_.h2 ) {
+                req.forceUseV2();
+            }
+            request( std::move( req ), intended, i >= warmup );
+        }
+        sendEnd_ = bench::Clock::now();
+
+        const auto deadline = sendEnd_ + std::chrono::seconds{ options_.timeout + 1 };
+        while ( completed_.load( std::memory_order_acquire ) < total_ && bench::Clock::now() < deadline ) {
+            std::this_thread::sleep_for( 1ms );
+        }
+        end_ = bench::Clock::now();
+    }
+
+    auto report( bench::Report &report ) -> void {
+        std::lock_guard _{ lock_ };
+
+        const auto measured = corrected_.count();
+        const auto elapsed = std::chrono::duration<double>( end_ - measureStart_ ).count();
+        const auto sendElapsed = std::chrono::duration<double>( sendEnd_ - measureStart_ ).count();
+
+        const auto params = bench::Params{
+          { "url", options_.url },
+          { "protocol", options_.h2 ? "h2c" : "http/1.1" },
+          { "rate", std::to_string( options_.rate ) },
+          { "duration", std::to_string( options_.duration ) },
+          { "workers", std::to_string( options_.workers ) } };
+
+        report.add(
+          "throughput", params,
+          { { "requests", static_cast<double>( measured ) },
+            { "incomplete", static_cast<double>( total_ - completed_.load() ) },
+            { "send_rate", static_cast<double>( options_.rate * options_.duration ) / sendElapsed },
+            { "completion_rate", static_cast<double>( measured ) / elapsed },
+            { "status_2xx", static_cast<double>( classes_[2] ) },
+            { "status_4xx", static_cast<double>( classes_[4] ) },
+            { "status_5xx", static_cast<double>( classes_[5] ) },
+            { "errors", static_cast<double>( classes_[0] ) } } );
+
+        const auto latency = [&]( std::string_view name, const poller::LatencyHistogram &h ) -> void {
+            report.add(
+              name, params,
+              { { "mean_us", h.mean() },
+                { "p50_us", static_cast<double>( h.quantile( 0.5 ) ) },
+                { "p90_us", static_cast<double>( h.quantile( 0.9 ) ) },
+                { "p99_us", static_cast<double>( h.quantile( 0.99 ) ) },
+                { "p999_us", static_cast<double>( h.quantile( 0.999 ) ) },
+                { "max_us", static_cast<double>( h.max() ) } } );
+        };
+
+        latency( "latency_corrected", corrected_ );
+        latency( "latency_uncorrected", uncorrected_ );
+    }
+
+private:
+    auto request( poller::HttpRequest req, bench::Clock::time_point intended, bool measured ) -> poller::Task<void> {
+        const auto sent = bench::Clock::now();
+
+        auto resp = co_await requestAsync<void>( std::move( req ) );
+
+        const auto done = bench::Clock::now();
+
+        if ( measured ) {
+            const auto us = []( auto d ) -> uint64_t {
+                return static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::microseconds>( d ).count() );
+            };
+
+            std::lock_guard _{ lock_ };
+            corrected_.record( us( done - intended ) );
+            uncorrected_.record( us( done - sent ) );
+            // Code 0 means transfer failed (timeout, connection refused).
+            ++classes_[resp.code >= 100 && resp.code < 600 ? resp.code / 100 : 0];
+        }
+
+        completed_.fetch_add( 1, std::memory_order_release );
+    }
+
+private:
+    Options options_;
+
+    uint64_t total_{};
+    std::atomic<uint64_t> completed_{ 0 };
+
+    bench::Clock::time_point measureStart_{};
+    bench::Clock::time_point sendEnd_{};
+    bench::Clock::time_point end_{};
+
+    std::mutex lock_;
+    poller::LatencyHistogram corrected_;
+    poller::LatencyHistogram uncorrected_;
+    std::array<uint64_t, 6> classes_{};
+};
+
+}  // namespace
+
+auto main( int argc, char **argv ) -> int {
+    auto options = Options{};
+    if ( !parseArgs( argc, argv, options ) ) {
+        std::fprintf(
+          stderr,
+          "usage: %s [--url http://127.0.0.1:10000/] [--rate req/s] [--duration s] [--warmup s] [--timeout s] "
+          "[--workers n] [--h2]\n",
+          argv[0] );
+        return 1;
+    }
+
+    auto report = bench::Report{ "poller" };
+    {
+        auto pool = std::optional<poller::pstd::ThreadPool>{};
+        auto inlineExecutor = poller::pstd::InlineExecutor{};
+        auto poolExecutor = std::optional<poller::pstd::ThreadPoolExecutor>{};
+        if ( options.workers ) {
+            pool.emplace( options.workers );
+            poolExecutor.emplace( *pool );
+        }
+
+        auto client = BenchClient{
+          options, poolExecutor ? static_cast<poller::pstd::Executor &>( *poolExecutor ) : inlineExecutor };
+        client.run();
+        client.report( report );
+    }
+    report.print();
+
+    return 0;
+}
@@ -0,0 +1,172 @@
+// Parallel algorithms of poller_std against serial std:: and, where the
+// standard library has it, std::execution::par on the same data.
+//
+//   algorithm_bench [--items 10000000] [--threads N] [--repeat 3]
+//
+// Every kernel reports the best of `--repeat` runs in seconds and items
+// per second, pool runs scale from one worker up to `--threads`. Prints
+// JSON report to stdout.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <version>
+
+#if defined( __cpp_lib_execution )
+#include <execution>
+#endif
+
+import poller_std;
+import bench;
+
+namespace {
+
+auto threadCounts( unsigned max ) -> std::vector<unsigned> {
+    auto result = std::vector<unsigned>{};
+    for ( unsigned n = 1; n < max; n *= 2 ) {
+        result.push_back( n );
+    }
+    result.push_back( max );
+    return result;
+}
+
+// Best of `repeat` runs of body, `prepare` resets the input before each.
+template <typename Prepare, typename Body>
+auto bestOf( unsigned repeat, Prepare prepare, Body body ) -> double {
+    auto best = 0.0;
+    for ( unsigned r = 0; r < repeat; ++r ) {
+        prepare();
+        const auto start = bench::nowNs();
+        body();
+        const auto elapsed = static_cast<double>( bench::nowNs() - start ) / 1e9;
+        best = r == 0 ? elapsed : std::min( best, elapsed );
+    }
+    return best;
+}
+
+struct Kernel {
+    std::string name;
+    std::function<void()> prepare;
+    std::function<void()> serial;
+    std::function<void( poller::pstd::ThreadPool & )> pool;
+    std::function<void()> par;
+};
+
+auto run( bench::Report &report, const Kernel &kernel, uint64_t items, unsigned maxThreads, unsigned repeat )
+  -> void {
+    const auto add = [&]( const std::string &impl, unsigned threads, double seconds ) -> void {
+        report.add(
+          kernel.name, { { "impl", impl }, { "threads", std::to_string( threads ) } },
+          { { "seconds", seconds }, { "items_per_sec", static_cast<double>( items ) / seconds } } );
+    };
+
+    add( "serial", 1, bestOf( repeat, kernel.prepare, kernel.serial ) );
+
+    // Calling thread joins, so N workers plus the caller.
+    for ( const auto threads : threadCounts( maxThreads ) ) {
+        auto pool = poller::pstd::ThreadPool{ threads - 1 };
+        add( "pool", threads, bestOf( repeat, kernel.prepare, [&]() -> void { kernel.pool( pool ); } ) );
+    }
+
+#if defined( __cpp_lib_execution )
+    add( "std_par", std::thread::hardware_concurrency(), bestOf( repeat, kernel.prepare, kernel.par ) );
+#endif
+}
+
+}  // namespace
+
+auto main( int argc, char **argv ) -> int {
+    using namespace poller::pstd;
+
+    const auto items = bench::option<uint64_t>( argc, argv, "--items", 10'000'000 );
+    const auto threads =
+      bench::option<unsigned>( argc, argv, "--threads", std::max( 2u, std::thread::hardware_concurrency() ) );
+    const auto repeat = std::max( 1u, bench::option<unsigned>( argc, argv, "--repeat", 3 ) );
+
+    auto rng = std::mt19937_64{ 42 };
+    auto source = std::vector<uint64_t>( items );
+    for ( auto &value : source ) {
+        value = rng();
+    }
+    auto doubles = std::vector<double>( items );
+    for ( uint64_t i = 0; i < items; ++i ) {
+        doubles[i] = static_cast<double>( source[i] % 1'000'000 ) / 7.0;
+    }
+
+    auto data = std::vector<uint64_t>( items );
+    auto out = std::vector<double>( items );
+    auto sum = 0.0;
+    const auto restore = [&]() -> void { std::ranges::copy( source, data.begin() ); };
+    const auto nothing = []() -> void {};
+    const auto heavy = []( double x ) -> double { return std::sqrt( x ) * std::log1p( x ); };
+
+    auto kernels = std::vector<Kernel>{};
+
+    kernels.push_back( {
+      "parallel_for", nothing,
+      [&]() -> void {
+          for ( uint64_t i = 0; i < items; ++i ) {
+              out[i] = heavy( doubles[i] );
+          }
+      },
+      [&]( ThreadPool &pool ) -> void {
+          parallelFor( pool, uint64_t{ 0 }, items, [&]( uint64_t i ) -> void { out[i] = heavy( doubles[i] ); } );
+      },
+      [&]() -> void {
+#if defined( __cpp_lib_execution )
+          std::transform( std::execution::par, doubles.begin(), doubles.end(), out.begin(), heavy );
+#endif
+      } } );
+
+    kernels.push_back( {
+      "parallel_reduce", nothing, [&]() -> void { sum = std::reduce( doubles.begin(), doubles.end(), 0.0 ); },
+      [&]( ThreadPool &pool ) -> void { sum = parallelReduce( pool, doubles.begin(), doubles.end(), 0.0 ); },
+      [&]() -> void {
+#if defined( __cpp_lib_execution )
+          sum = std::reduce( std::execution::par, doubles.begin(), doubles.end(), 0.0 );
+#endif
+      } } );
+
+    kernels.push_back( {
+      "parallel_transform", nothing,
+      [&]() -> void { std::transform( doubles.begin(), doubles.end(), out.begin(), heavy ); },
+      [&]( ThreadPool &pool ) -> void { parallelTransform( pool, doubles.begin(), doubles.end(), out.begin(), heavy ); },
+      [&]() -> void {
+#if defined( __cpp_lib_execution )
+          std::transform( std::execution::par, doubles.begin(), doubles.end(), out.begin(), heavy );
+#endif
+      } } );
+
+    kernels.push_back( {
+      "parallel_sort", restore, [&]() -> void { std::sort( data.begin(), data.end() ); },
+      [&]( ThreadPool &pool ) -> void { parallelSort( pool, data.begin(), data.end() ); },
+      [&]() -> void {
+#if defined( __cpp_lib_execution )
+          std::sort( std::execution::par, data.begin(), data.end() );
+#endif
+      } } );
+
+    kernels.push_back( {
+      "parallel_scan", restore, [&]() -> void { std::inclusive_scan( data.begin(), data.end(), data.begin() ); },
+      [&]( ThreadPool &pool ) -> void { parallelScan( pool, data.begin(), data.end(), data.begin() ); },
+      [&]() -> void {
+#if defined( __cpp_lib_execution )
+          std::inclusive_scan( std::execution::par, data.begin(), data.end(), data.begin() );
+#endif
+      } } );
+
+    auto result = bench::Report{ "algorithms" };
+    for ( const auto &kernel : kernels ) {
+        run( result, kernel, items, threads, repeat );
+    }
+    bench::doNotOptimize( sum );
+    bench::doNotOptimize( out.data() );
+    result.print();
+    return 0;
+}
@@ -0,0 +1,436 @@
+
+// poller_std containers and ThreadPool microbenchmarks.
+//
+//   std_bench [--items 1000000] [--threads N]
+//
+// Queue latency is push-to-pop time of timestamped items, ThreadPool
+// latency is submit-to-execute time. All latencies in nanoseconds.
+// Prints JSON report to stdout.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+import poller_std;
+import bench;
+
+namespace {
+
+constexpr uint64_t kStop = ~uint64_t{ 0 };
+
+auto threadCounts( unsigned max ) -> std::vector<unsigned> {
+    auto result = std::vector<unsigned>{};
+    for ( unsigned n = 1; n < max; n *= 2 ) {
+        result.push_back( n );
+    }
+    result.push_back( max );
+    return result;
+}
+
+template <typename Pairs>
+auto merge( Pairs values, const Pairs &more ) -> Pairs {
+    values.insert( values.end(), more.begin(), more.end() );
+    return values;
+}
+
+// Producers push timestamps, consumers pop them and record push-to-pop
+// latency. Every consumer stops at its own kStop marker.
+template <typename Queue, typename Push, typename Pop>
+auto runQueue(
+  bench::Report &report, std::string_view name, Queue &queue, unsigned producers, unsigned consumers,
+  uint64_t items, Push push, Pop pop ) -> void {
+    auto latencies = std::vector<std::vector<uint64_t>>( consumers );
+    auto threads = std::vector<std::jthread>{};
+
+    const auto start = bench::nowNs();
+
+    for ( unsigned c = 0; c < consumers; ++c ) {
+        threads.emplace_back( [&, c]() -> void {
+            auto &samples = latencies[c];
+            samples.reserve( items / consumers + 1 );
+            for ( uint64_t value{};; ) {
+                pop( queue, value );
+                if ( value == kStop ) {
+                    return;
+                }
+                samples.push_back( bench::nowNs() - value );
+            }
+        } );
+    }
+
+    {
+        auto producerThreads = std::vector<std::jthread>{};
+        for ( unsigned p = 0; p < producers; ++p ) {
+            producerThreads.emplace_back( [&, p]() -> void {
+                const auto count = items / producers + ( p < items % producers ? 1 : 0 );
+                for ( uint64_t i = 0; i < count; ++i ) {
+                    push( queue, bench::nowNs() );
+                }
+            } );
+        }
+    }
+
+    for ( unsigned c = 0; c < consumers; ++c ) {
+        push( queue, kStop );
+    }
+    threads.clear();
+
+    const auto elapsed = static_cast<double>( bench::nowNs() - start ) / 1e9;
+
+    auto all = std::vector<uint64_t>{};
+    all.reserve( items );
+    for ( auto &samples : latencies ) {
+        all.insert( all.end(), samples.begin(), samples.end() );
+    }
+
+    report.add(
+      name, { { "producers", std::to_string( producers ) }, { "consumers", std::to_string( consumers ) } },
+      merge(
+        bench::Values{ { "ops_per_sec", static_cast<double>( items ) / elapsed } }, bench::percentiles( all, "latency_" ) ) );
+}
+
+auto benchSpsc( bench::Report &report, uint64_t items ) -> void {
+    auto queue = poller::spsc_lock_free_queue<uint64_t>{ 1024 };
+    runQueue(
+      report, "spsc_lock_free_queue", queue, 1, 1, items,
+      []( auto &q, uint64_t value ) -> void {
+          while ( !q.push( value ) ) {
+              std::this_thread::yield();
+          }
+      },
+      []( auto &q, uint64_t &value ) -> void {
+          while ( !q.pop( value ) ) {
+              std::this_thread::yield();
+          }
+      } );
+
+    auto blocking = poller::spsc_lock_free_queue<uint64_t>{ 1024 };
+    runQueue(
+      report, "spsc_lock_free_queue_blocking", blocking, 1, 1, items,
+      []( auto &q, uint64_t value ) -> void { q.push_blocking( value ); },
+      []( auto &q, uint64_t &value ) -> void { q.pop_blocking( value ); } );
+}
+
+// push_n/pop_n in batches of kSpscBatch, latency of every item.
+auto benchSpscBatch( bench::Report &report, uint64_t items ) -> void {
+    constexpr size_t kSpscBatch = 32;
+    auto queue = poller::spsc_lock_free_queue<uint64_t>{ 1024 };
+    auto samples = std::vector<uint64_t>{};
+    samples.reserve( items );
+
+    const auto start = bench::nowNs();
+    auto consumer = std::jthread{ [&]() -> void {
+        auto batch = std::array<uint64_t, kSpscBatch>{};
+        while ( samples.size() < items ) {
+            const auto n = queue.pop_n( batch.begin(), batch.size() );
+            if ( n == 0 ) {
+                std::this_thread::yield();
+                continue;
+            }
+            const auto now = bench::nowNs();
+            for ( size_t i = 0; i < n; ++i ) {
+                samples.push_back( now - batch[i] );
+            }
+        }
+    } };
+
+    auto batch = std::array<uint64_t, kSpscBatch>{};
+    for ( uint64_t sent = 0; sent < items; ) {
+        const auto count = static_cast<size_t>( std::min<uint64_t>( kSpscBatch, items - sent ) );
+        batch.fill( bench::nowNs() );
+        for ( size_t done = 0; done < count; ) {
+            const auto n = queue.push_n( batch.begin() + done, count - done );
+            if ( n == 0 ) {
+                std::this_thread::yield();
+            }
+            done += n;
+        }
+        sent += count;
+    }
+    consumer.join();
+
+    const auto elapsed = static_cast<double>( bench::nowNs() - start ) / 1e9;
+    report.add(
+      "spsc_lock_free_queue_batch", { { "batch", std::to_string( kSpscBatch ) } },
+      merge(
+        bench::Values{ { "ops_per_sec", static_cast<double>( items ) / elapsed } },
+        bench::percentiles( samples, "latency_" ) ) );
+}
+
+auto benchLocking( bench::Report &report, uint64_t items, unsigned maxThreads ) -> void {
+    for ( const auto producers : threadCounts( maxThreads ) ) {
+        for ( const auto consumers : threadCounts( maxThreads ) ) {
+            auto queue = poller::locking_queue<uint64_t>{ 1024 };
+            runQueue(
+              report, "locking_queue", queue, producers, consumers, items,
+              []( auto &q, uint64_t value ) -> void { q.push( value ); },
+              []( auto &q, uint64_t &value ) -> void { q.pop( value ); } );
+        }
+    }
+}
+
+auto benchSemaphore( bench::Report &report, uint64_t items, unsigned maxThreads ) -> void {
+    for ( const auto producers : threadCounts( maxThreads ) ) {
+        for ( const auto consumers : threadCounts( maxThreads ) ) {
+            auto queue = poller::semaphore_queue<uint64_t>{ 1024 };
+            runQueue(
+              report, "semaphore_queue", queue, producers, consumers, items,
+              []( auto &q, uint64_t value ) -> void { q.push( value ); },
+              []( auto &q, uint64_t &value ) -> void { q.pop( value ); } );
+        }
+    }
+}
+
+auto benchDeque( bench::Report &report, uint64_t items, unsigned maxThreads ) -> void {
+    static int dummy{};
+
+    {
+        auto deque = poller::WorkStealingDeque<int *>{};
+        const auto start = bench::nowNs();
+        for ( uint64_t i = 0; i < items; ++i ) {
+            deque.Push( &dummy );
+        }
+        for ( uint64_t i = 0; i < items; ++i ) {
+            bench::doNotOptimize( deque.Pop() );
+        }
+        const auto ns = static_cast<double>( bench::nowNs() - start ) / static_cast<double>( 2 * items );
+        report.add( "workstealingdeque_push_pop", { { "thieves", "0" } }, { { "ns_per_op", ns } } );
+    }
+
+    // Owner pushes and pops every other item back, like a worker that
+    // spawns and runs its own tasks, while thieves steal the rest.
+    for ( const auto thieves : threadCounts( maxThreads ) ) {
+        auto deque = poller::WorkStealingDeque<int *>{};
+        auto consumed = std::atomic<uint64_t>{ 0 };
+        auto steals = std::atomic<uint64_t>{ 0 };
+        auto failed = std::atomic<uint64_t>{ 0 };
+        auto threads = std::vector<std::jthread>{};
+
+        const auto start = bench::nowNs();
+
+        for ( unsigned t = 0; t < thieves; ++t ) {
+            threads.emplace_back( [&]() -> void {
+                uint64_t ok{};
+                uint64_t miss{};
+                while ( consumed.load( std::memory_order_relaxed ) < items ) {
+                    if ( deque.Steal() ) {
+                        ++ok;
+                        consumed.fetch_add( 1, std::memory_order_relaxed );
+                    } else {
+                        ++miss;
+                    }
+                }
+                steals += ok;
+                failed += miss;
+            } );
+        }
+
+        uint64_t popped{};
+        for ( uint64_t i = 0; i < items; ++i ) {
+            deque.Push( &dummy );
+            if ( ( i & 1 ) && deque.Pop() ) {
+                ++popped;
+                consumed.fetch_add( 1, std::memory_order_relaxed );
+            }
+        }
+        while ( deque.Pop() ) {
+            ++popped;
+            consumed.fetch_add( 1, std::memory_order_relaxed );
+        }
+        threads.clear();
+
+        const auto elapsed = static_cast<double>( bench::nowNs() - start ) / 1e9;
+        const auto attempts = steals.load() + failed.load();
+        report.add(
+          "workstealingdeque_steal", { { "thieves", std::to_string( thieves ) } },
+          { { "ops_per_sec", static_cast<double>( items ) / elapsed },
+            { "stolen", static_cast<double>( steals.load() ) },
+            { "popped", static_cast<double>( popped ) },
+            { "steal_success_ratio", attempts ? static_cast<double>( steals.load() ) / attempts : 0.0 } } );
+    }
+}
+
+auto benchList( bench::Report &report, uint64_t items, unsigned maxThreads ) -> void {
+    for ( const auto writers : threadCounts( maxThreads ) ) {
+        auto list = poller::list<uint64_t>{};
+        auto threads = std::vector<std::jthread>{};
+
+        const auto start = bench::nowNs();
+        for ( unsigned w = 0; w < writers; ++w ) {
+            threads.emplace_back( [&]() -> void {
+                for ( uint64_t i = 0; i < items / writers; ++i ) {
+                    list.append( std::make_shared<uint64_t>( i ) );
+                }
+            } );
+        }
+        threads.clear();
+        const auto appendElapsed = static_cast<double>( bench::nowNs() - start ) / 1e9;
+
+        uint64_t sum{};
+        const auto traverseStart = bench::nowNs();
+        list.for_each( [&sum]( const auto &item ) -> void { sum += *item; } );
+        bench::doNotOptimize( sum );
+        const auto traverseElapsed = static_cast<double>( bench::nowNs() - traverseStart ) / 1e9;
+
+        report.add(
+          "list", { { "writers", std::to_string( writers ) } },
+          { { "append_ops_per_sec", static_cast<double>( list.size() ) / appendElapsed },
+            { "for_each_items_per_sec", static_cast<double>( list.size() ) / traverseElapsed } } );
+    }
+}
+
+auto fib( poller::pstd::ThreadPool &pool, int n ) -> uint64_t {
+    if ( n < 20 ) {
+        return n < 2 ? n : fib( pool, n - 1 ) + fib( pool, n - 2 );
+    }
+
+    uint64_t left{};
+    auto done = std::atomic<bool>{ false };
+    pool.submit( [&]() -> void {
+        left = fib( pool, n - 1 );
+        done.store( true, std::memory_order_release );
+    } );
+    const auto right = fib( pool, n - 2 );
+    pool.wait( [&done]() -> bool { return done.load( std::memory_order_acquire ); } );
+
+    return left + right;
+}
+
+auto benchThreadPool( bench::Report &report, uint64_t items, unsigned maxThreads ) -> void {
+    for ( const auto workers : threadCounts( maxThreads ) ) {
+        const auto params = bench::Params{ { "workers", std::to_string( workers ) } };
+
+        // Submit-to-execute latency, one task at a time with idle gaps so
+        // workers go to sleep and have to be woken up.
+        {
+            auto pool = poller::pstd::ThreadPool{ workers };
+            auto samples = std::vector<uint64_t>{};
+            samples.reserve( 10'000 );
+
+            for ( int i = 0; i < 10'000; ++i ) {
+                auto executed = std::atomic<uint64_t>{ 0 };
+                const auto submitted = bench::nowNs();
+                pool.submit( [&executed]() -> void { executed.store( bench::nowNs(), std::memory_order_release ); } );
+                pool.wait();
+                samples.push_back( executed.load( std::memory_order_acquire ) - submitted );
+                if ( i % 16 == 0 ) {
+                    std::this_thread::sleep_for( std::chrono::microseconds{ 200 } );
+                }
+            }
+
+            report.add( "threadpool_submit_latency", params, bench::percentiles( samples, "latency_" ) );
+        }
+
+        // Empty task throughput, submitted from outside the pool.
+        {
+            auto pool = poller::pstd::ThreadPool{ workers };
+            const auto start = bench::nowNs();
+            for ( uint64_t i = 0; i < items; ++i ) {
+                pool.submit( []() -> void {} );
+            }
+            pool.wait();
+            const auto elapsed = static_cast<double>( bench::nowNs() - start ) / 1e9;
+            report.add(
+              "threadpool_empty", params, { { "tasks_per_sec", static_cast<double>( items ) / elapsed } } );
+        }
+
+        // Tiny task: a few hundred nanoseconds of arithmetic.
+        {
+            auto pool = poller::pstd::ThreadPool{ workers };
+            auto sink = std::atomic<uint64_t>{ 0 };
+            const auto start = bench::nowNs();
+            for ( uint64_t i = 0; i < items; ++i ) {
+                pool.submit( [&sink, i]() -> void {
+                    auto x = i;
+                    for ( int k = 0; k < 64; ++k ) {
+                        x = x * 6364136223846793005ull + 1442695040888963407ull;
+                    }
+                    sink.fetch_add( x & 1, std::memory_order_relaxed );
+                } );
+            }
+            pool.wait();
+            const auto elapsed = static_cast<double>( bench::nowNs() - start ) / 1e9;
+            report.add(
+              "threadpool_tiny", params, { { "tasks_per_sec", static_cast<double>( items ) / elapsed } } );
+        }
+
+        // Recursive fork-join, joins help executing via wait(predicate).
+        {
+            auto pool = poller::pstd::ThreadPool{ workers };
+            const auto start = bench::nowNs();
+            const auto result = fib( pool, 32 );
+            const auto elapsed = static_cast<double>( bench::nowNs() - start ) / 1e9;
+            bench::doNotOptimize( result );
+            report.add( "threadpool_fork_join", merge( params, bench::Params{ { "fib", "32" } } ), { { "seconds", elapsed } } );
+        }
+    }
+}
+
+// Many non-worker threads submitting at once. "injection" is the plain
+// submit() path. "mutex" serializes submitters with a lock, which is what
+// single-owner deque push required of external threads before.
+auto benchExternalSubmit( bench::Report &report, uint64_t items, unsigned maxThreads ) -> void {
+    for ( const auto producers : threadCounts( maxThreads ) ) {
+        for ( const auto serialized : { false, true } ) {
+            auto pool = poller::pstd::ThreadPool{ maxThreads };
+            auto lock = std::mutex{};
+            auto threads = std::vector<std::jthread>{};
+
+            const auto start = bench::nowNs();
+            for ( unsigned p = 0; p < producers; ++p ) {
+                threads.emplace_back( [&, p]() -> void {
+                    const auto count = items / producers + ( p < items % producers ? 1 : 0 );
+                    for ( uint64_t i = 0; i < count; ++i ) {
+                        if ( serialized ) {
+                            auto guard = std::lock_guard{ lock };
+                            pool.submit( []() -> void {} );
+                        } else {
+                            pool.submit( []() -> void {} );
+                        }
+                    }
+                } );
+            }
+            threads.clear();
+            pool.wait();
+            const auto elapsed = static_cast<double>( bench::nowNs() - start ) / 1e9;
+
+            report.add(
+              "threadpool_external_submit",
+              { { "producers", std::to_string( producers ) },
+                { "workers", std::to_string( maxThreads ) },
+                { "path", serialized ? "mutex" : "injection" } },
+              { { "tasks_per_sec", static_cast<double>( items ) / elapsed } } );
+        }
+    }
+}
+
+}  // namespace
+
+auto main( int argc, char **argv ) -> int {
+    const auto items = bench::option<uint64_t>( argc, argv, "--items", 1'000'000 );
+    const auto threads =
+      bench::option<unsigned>( argc, argv, "--threads", std::max( 2u, std::thread::hardware_concurrency() ) );
+
+    auto report = bench::Report{ "poller_std" };
+
+    benchSpsc( report, items );
+    benchSpscBatch( report, items );
+    benchLocking( report, items, threads );
+    benchSemaphore( report, items, threads );
+    benchDeque( report, items, threads );
+    benchList( report, items, threads );
+    benchThreadPool( report, items, threads );
+    benchExternalSubmit( report, items, threads );
+
+    report.print();
+
+    return 0;
+}
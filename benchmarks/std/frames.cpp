@@ -0,0 +1,158 @@
+
+// Coroutine frame allocation: pstd::FrameAllocator against global operator new.
+//
+//   frame_bench [--items 1000000]
+//
+// "local" creates and destroys frames on one thread, "cross_thread"
+// destroys them on another thread as Poller does when a request coroutine
+// finishes on the curl worker. Prints JSON report to stdout.
+
+#include <coroutine>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+import poller_std;
+import bench;
+
+namespace {
+
+struct DefaultFrame {};
+
+// Minimal lazy coroutine, frame size is padded with locals.
+template <typename Base, size_t Padding>
+struct Frame {
+    struct promise_type : Base {
+        auto get_return_object() -> Frame {
+            //
+            return { std::coroutine_handle<promise_type>::from_promise( *this ) };
+        }
+
+        auto initial_suspend() noexcept -> std::suspend_always {
+            //
+            return {};
+        }
+
+        auto final_suspend() noexcept -> std::suspend_always {
+            //
+            return {};
+        }
+
+        auto return_void() -> void {
+            //
+        }
+
+        auto unhandled_exception() -> void {
+            //
+        }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+template <typename Base, size_t Padding>
+auto coroutine( uint64_t i ) -> Frame<Base, Padding> {
+    volatile char padding[Padding];
+    padding[0] = static_cast<char>( i );
+    co_await std::suspend_always{};
+    bench::doNotOptimize( padding[0] );
+}
+
+template <typename Base, size_t Padding>
+auto local( uint64_t items ) -> double {
+    return bench::nsPerOp( items, []( uint64_t i ) -> void {
+        auto frame = coroutine<Base, Padding>( i );
+        frame.handle.destroy();
+    } );
+}
+
+// Keeps a window of frames alive, frees them in FIFO order.
+template <typename Base, size_t Padding>
+auto window( uint64_t items ) -> double {
+    constexpr size_t kWindow = 256;
+    auto frames = std::vector<std::coroutine_handle<>>( kWindow );
+    const auto ns = bench::nsPerOp( items, [&frames]( uint64_t i ) -> void {
+        auto &slot = frames[i % kWindow];
+        if ( slot ) {
+            slot.destroy();
+        }
+        slot = coroutine<Base, Padding>( i ).handle;
+    } );
+    for ( auto handle : frames ) {
+        if ( handle ) {
+            handle.destroy();
+        }
+    }
+    return ns;
+}
+
+template <typename Base, size_t Padding>
+auto crossThread( uint64_t items ) -> double {
+    auto queue = poller::spsc_lock_free_queue<void *>{ 1024 };
+
+    const auto start = bench::nowNs();
+    auto consumer = std::jthread{ [&queue, items]() -> void {
+        void *address{};
+        for ( uint64_t i = 0; i < items; ++i ) {
+            while ( !queue.pop( address ) ) {
+                std::this_thread::yield();
+            }
+            std::coroutine_handle<>::from_address( address ).destroy();
+        }
+    } };
+
+    for ( uint64_t i = 0; i < items; ++i ) {
+        auto *address = coroutine<Base, Padding>( i ).handle.address();
+        while ( !queue.push( address ) ) {
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+
+    return static_cast<double>( bench::nowNs() - start ) / static_cast<double>( items );
+}
+
+template <size_t Padding>
+auto run( bench::Report &report, uint64_t items ) -> void {
+    using Pooled = poller::pstd::PooledFrame;
+
+    const auto params = []( std::string_view allocator ) -> bench::Params {
+        return { { "allocator", std::string{ allocator } }, { "padding", std::to_string( Padding ) } };
+    };
+
+    report.add( "local", params( "default" ), { { "ns_per_op", local<DefaultFrame, Padding>( items ) } } );
+    report.add( "local", params( "pooled" ), { { "ns_per_op", local<Pooled, Padding>( items ) } } );
+    report.add( "window", params( "default" ), { { "ns_per_op", window<DefaultFrame, Padding>( items ) } } );
+    report.add( "window", params( "pooled" ), { { "ns_per_op", window<Pooled, Padding>( items ) } } );
+    report.add(
+      "cross_thread", params( "default" ), { { "ns_per_op", crossThread<DefaultFrame, Padding>( items ) } } );
+    report.add( "cross_thread", params( "pooled" ), { { "ns_per_op", crossThread<Pooled, Padding>( items ) } } );
+}
+
+}  // namespace
+
+auto main( int argc, char **argv ) -> int {
+    const auto items = bench::option<uint64_t>( argc, argv, "--items", 1'000'000 );
+
+    auto report = bench::Report{ "frame_allocator" };
+
+    run<16>( report, items );
+    run<256>( report, items );
+    run<2048>( report, items );
+
+    const auto stats = poller::pstd::FrameAllocator::stats();
+    report.add(
+      "stats", {},
+      { { "allocations", static_cast<double>( stats.allocations ) },
+        { "deallocations", static_cast<double>( stats.deallocations ) },
+        { "reused", static_cast<double>( stats.reused ) },
+        { "remote_deallocations", static_cast<double>( stats.remote_deallocations ) },
+        { "oversized", static_cast<double>( stats.oversized ) } } );
+
+    report.print();
+
+    return 0;
+}
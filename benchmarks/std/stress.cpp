@@ -0,0 +1,423 @@
+// Consistency checks for the lock-free containers of poller_std and the
+// poller Channel. Not a benchmark: nothing is timed, numbered items are
+// moved between threads and every one of them must come out exactly once.
+//
+//   stress_test [--items 200000] [--threads 4] [--rounds 3]
+//
+// Meant to run under ThreadSanitizer as well, configure with
+// -DPOLLER_SANITIZE=thread. Prints one line per check to stderr, exits
+// with 1 if any of them failed.
+//
+// deque: every thread owns a WorkStealingDeque, pushes its share in bursts
+// large enough to grow the array and drains it back to a few items, so the
+// array shrinks again, while the others steal from it, single items and
+// halves. Retired arrays are reclaimed under concurrent steals.
+//
+// pool: external threads submit to a ThreadPool through the injection
+// queue, pausing now and then so workers park and have to be woken. Every
+// task submits one more from the worker, into its own queue, where idle
+// siblings steal it in batches.
+//
+// spsc: one producer, one consumer, items must arrive in order, with plain,
+// batch and blocking push/pop on a small ring that is full or empty most
+// of the time.
+//
+// mpmc: several producers and consumers on a small mpmc_lock_free_queue.
+//
+// channel: sender and receiver coroutines, half of the receivers taking
+// batches, on a small Channel. Parked coroutines are resumed inline by
+// whoever unblocks them, then once more on a ThreadPoolExecutor.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <coroutine>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+import poller_std;
+import poller;
+import bench;
+
+namespace {
+
+using poller::Channel;
+using poller::mpmc_lock_free_queue;
+using poller::spsc_lock_free_queue;
+using poller::WorkStealingDeque;
+using poller::pstd::ThreadPool;
+using poller::pstd::ThreadPoolExecutor;
+
+// A lost wakeup shows up as a hang, give up and fail instead.
+constexpr auto kStuckAfter = std::chrono::seconds{ 60 };
+
+// How many times every item was taken.
+class Tally {
+public:
+    explicit Tally( size_t items )
+        : seen_( items ) {
+        /* noop */
+    }
+
+    auto take( size_t item ) -> void {
+        //
+        seen_[item].fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    [[nodiscard]]
+    auto check( std::string_view name ) const -> bool {
+        size_t missing = 0;
+        size_t duplicated = 0;
+        for ( const auto &seen : seen_ ) {
+            const auto count = seen.load( std::memory_order_relaxed );
+            missing += count == 0;
+            duplicated += count > 1;
+        }
+
+        std::cerr << name << ": " << seen_.size() << " items";
+        if ( missing == 0 && duplicated == 0 ) {
+            std::cerr << ", ok\n";
+            return true;
+        }
+        std::cerr << ", " << missing << " missing, " << duplicated << " taken more than once\n";
+        return false;
+    }
+
+private:
+    std::vector<std::atomic<uint32_t>> seen_;
+};
+
+// Waits until `counter` reaches `expected`, a lost wakeup exits the process.
+auto waitFor( const std::atomic<size_t> &counter, size_t expected, std::string_view name ) -> void {
+    const auto deadline = std::chrono::steady_clock::now() + kStuckAfter;
+    while ( counter.load( std::memory_order_acquire ) != expected ) {
+        if ( std::chrono::steady_clock::now() > deadline ) {
+            std::cerr << name << ": stuck at " << counter.load() << " of " << expected << '\n';
+            std::_Exit( 1 );
+        }
+        std::this_thread::sleep_for( std::chrono::milliseconds{ 1 } );
+    }
+}
+
+auto checkDeque( size_t items, unsigned threads ) -> bool {
+    using Deque = WorkStealingDeque<size_t *>;
+
+    auto values = std::vector<size_t>( items );
+    std::iota( values.begin(), values.end(), size_t{ 0 } );
+
+    auto deques = std::vector<std::unique_ptr<Deque>>{};
+    for ( unsigned i = 0; i != threads; ++i ) {
+        deques.push_back( std::make_unique<Deque>( 16 ) );
+    }
+
+    auto tally = Tally{ items };
+    auto taken = std::atomic<size_t>{ 0 };
+
+    const auto worker = [&]( unsigned self ) -> void {
+        auto &own = *deques[self];
+        auto rng = std::minstd_rand{ self + 1 };
+        const auto take = [&]( size_t *item ) -> void {
+            tally.take( *item );
+            taken.fetch_add( 1, std::memory_order_release );
+        };
+        const auto steal = [&]() -> void {
+            if ( const auto victim = rng() % threads; victim != self ) {
+                auto &deque = *deques[victim];
+                if ( auto *item = rng() % 2 ? deque.Steal() : deque.StealHalf( own, 64 ) ) {
+                    take( item );
+                }
+            }
+        };
+
+        for ( size_t next = self; next < items; ) {
+            for ( auto burst = 1 + rng() % 4096; burst != 0 && next < items; --burst, next += threads ) {
+                own.Push( &values[next] );
+            }
+            while ( own.Size() > 2 ) {
+                if ( auto *item = own.Pop() ) {
+                    take( item );
+                }
+                if ( rng() % 8 == 0 ) {
+                    steal();
+                }
+            }
+        }
+
+        while ( taken.load( std::memory_order_acquire ) != items ) {
+            if ( auto *item = own.Pop() ) {
+                take( item );
+            } else {
+                steal();
+            }
+        }
+    };
+
+    auto workers = std::vector<std::jthread>{};
+    for ( unsigned i = 0; i != threads; ++i ) {
+        workers.emplace_back( worker, i );
+    }
+    workers.clear();
+
+    return tally.check( "deque" );
+}
+
+auto checkPool( size_t items, unsigned threads ) -> bool {
+    auto tally = Tally{ items };
+    auto done = std::atomic<size_t>{ 0 };
+    auto pool = ThreadPool{ threads };
+
+    const auto run = [&]( size_t item ) -> void {
+        tally.take( item );
+        done.fetch_add( 1, std::memory_order_release );
+    };
+
+    // Producer `self` submits even items, the task of item i submits i + 1.
+    const auto producer = [&]( unsigned self ) -> void {
+        auto rng = std::minstd_rand{ self + 1 };
+        for ( auto next = size_t{ self } * 2; next < items; next += size_t{ threads } * 2 ) {
+            pool.submit( [&run, &pool, next, items] -> void {
+                run( next );
+                if ( next + 1 < items ) {
+                    pool.submit( [&run, next] -> void { run( next + 1 ); } );
+                }
+            } );
+            if ( rng() % 256 == 0 ) {
+                std::this_thread::sleep_for( std::chrono::microseconds{ 200 } );
+            }
+        }
+    };
+
+    auto producers = std::vector<std::jthread>{};
+    for ( unsigned i = 0; i != threads; ++i ) {
+        producers.emplace_back( producer, i );
+    }
+    producers.clear();
+
+    waitFor( done, items, "pool" );
+    return tally.check( "pool" );
+}
+
+enum class Mode : uint8_t { kSingle, kBatch, kBlocking };
+
+auto checkSpsc( size_t items, const Mode mode, std::string_view name ) -> bool {
+    auto queue = spsc_lock_free_queue<size_t>{ 64 };
+    auto tally = Tally{ items };
+
+    auto producer = std::jthread{ [&] -> void {
+        auto rng = std::minstd_rand{ 1 };
+        auto batch = std::array<size_t, 32>{};
+        for ( size_t next = 0; next < items; ) {
+            switch ( mode ) {
+                case Mode::kSingle: {
+                    if ( queue.push( next ) ) {
+                        ++next;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                    break;
+                }
+                case Mode::kBatch: {
+                    const auto count = std::min<size_t>( 1 + rng() % batch.size(), items - next );
+                    std::iota( batch.begin(), batch.begin() + count, next );
+                    if ( const auto pushed = queue.push_n( batch.begin(), count ) ) {
+                        next += pushed;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                    break;
+                }
+                case Mode::kBlocking: {
+                    queue.push_blocking( next++ );
+                    break;
+                }
+            }
+        }
+    } };
+
+    // Keeps consuming after a mismatch, a blocked producer is joined below.
+    auto ordered = true;
+    auto rng = std::minstd_rand{ 2 };
+    auto batch = std::array<size_t, 32>{};
+    for ( size_t expected = 0; expected < items; ) {
+        size_t count = 0;
+        switch ( mode ) {
+            case Mode::kSingle: {
+                count = queue.pop( batch[0] ) ? 1 : 0;
+                break;
+            }
+            case Mode::kBatch: {
+                count = queue.pop_n( batch.begin(), 1 + rng() % batch.size() );
+                break;
+            }
+            case Mode::kBlocking: {
+                queue.pop_blocking( batch[0] );
+                count = 1;
+                break;
+            }
+        }
+        if ( count == 0 ) {
+            std::this_thread::yield();
+        }
+        for ( size_t i = 0; i != count; ++i, ++expected ) {
+            if ( batch[i] != expected && std::exchange( ordered, false ) ) {
+                std::cerr << name << ": got item " << batch[i] << ", expected " << expected << '\n';
+            }
+            if ( batch[i] < items ) {
+                tally.take( batch[i] );
+            }
+        }
+    }
+
+    return tally.check( name ) && ordered;
+}
+
+auto checkMpmc( size_t items, unsigned threads ) -> bool {
+    auto queue = mpmc_lock_free_queue<size_t>{ 64 };
+    auto tally = Tally{ items };
+    auto popped = std::atomic<size_t>{ 0 };
+
+    const auto producer = [&]( unsigned self ) -> void {
+        for ( size_t next = self; next < items; next += threads ) {
+            while ( !queue.try_push( next ) ) {
+                std::this_thread::yield();
+            }
+        }
+    };
+
+    const auto consumer = [&] -> void {
+        auto item = size_t{};
+        while ( popped.load( std::memory_order_acquire ) != items ) {
+            if ( queue.try_pop( item ) ) {
+                tally.take( item );
+                popped.fetch_add( 1, std::memory_order_release );
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    };
+
+    auto workers = std::vector<std::jthread>{};
+    for ( unsigned i = 0; i != threads; ++i ) {
+        workers.emplace_back( consumer );
+        workers.emplace_back( producer, i );
+    }
+    workers.clear();
+
+    return tally.check( "mpmc" );
+}
+
+// Starts eagerly and frees its frame when done.
+struct Detached {
+    struct promise_type {
+        auto get_return_object() noexcept -> Detached {
+            //
+            return {};
+        }
+
+        auto initial_suspend() noexcept -> std::suspend_never {
+            //
+            return {};
+        }
+
+        auto final_suspend() noexcept -> std::suspend_never {
+            //
+            return {};
+        }
+
+        auto return_void() noexcept -> void {
+            //
+        }
+
+        auto unhandled_exception() noexcept -> void {
+            //
+            std::terminate();
+        }
+    };
+};
+
+// Last sender closes the channel.
+auto sendShare( Channel<size_t> &channel, size_t first, size_t step, size_t items, std::atomic<size_t> &senders,
+                std::atomic<size_t> &finished ) -> Detached {
+    for ( auto next = first; next < items; next += step ) {
+        if ( !co_await channel.send( next ) ) {
+            break;
+        }
+    }
+    if ( senders.fetch_sub( 1, std::memory_order_acq_rel ) == 1 ) {
+        channel.close();
+    }
+    finished.fetch_add( 1, std::memory_order_release );
+}
+
+auto receiveAll( Channel<size_t> &channel, Tally &tally, bool batched, std::atomic<size_t> &finished ) -> Detached {
+    if ( batched ) {
+        auto batch = std::array<size_t, 16>{};
+        while ( const auto count = co_await channel.receiveBatch( batch ) ) {
+            for ( size_t i = 0; i != count; ++i ) {
+                tally.take( batch[i] );
+            }
+        }
+    } else {
+        while ( const auto item = co_await channel.receive() ) {
+            tally.take( *item );
+        }
+    }
+    finished.fetch_add( 1, std::memory_order_release );
+}
+
+auto checkChannel( size_t items, unsigned threads, poller::pstd::Executor *executor, std::string_view name ) -> bool {
+    auto channel = Channel<size_t>{ 64, executor };
+    auto tally = Tally{ items };
+    auto senders = std::atomic<size_t>{ threads };
+    auto finished = std::atomic<size_t>{ 0 };
+
+    // Threads only start the coroutines, which then move to whichever
+    // thread resumes them.
+    auto starters = std::vector<std::jthread>{};
+    for ( unsigned i = 0; i != threads; ++i ) {
+        starters.emplace_back( [&, i] -> void { receiveAll( channel, tally, i % 2 == 1, finished ); } );
+        starters.emplace_back( [&, i] -> void { sendShare( channel, i, threads, items, senders, finished ); } );
+    }
+    starters.clear();
+
+    waitFor( finished, size_t{ threads } * 2, name );
+    return tally.check( name );
+}
+
+}  // namespace
+
+auto main( int argc, char **argv ) -> int {
+    const auto items = bench::option<size_t>( argc, argv, "--items", 200'000 );
+    const auto threads = std::max( bench::option<unsigned>( argc, argv, "--threads", 4 ), 2u );
+    const auto rounds = bench::option<unsigned>( argc, argv, "--rounds", 3 );
+
+    auto ok = true;
+    for ( unsigned round = 0; round != rounds; ++round ) {
+        std::cerr << "round " << round << '\n';
+        ok &= checkDeque( items, threads );
+        ok &= checkPool( items, threads );
+        ok &= checkSpsc( items, Mode::kSingle, "spsc single" );
+        ok &= checkSpsc( items, Mode::kBatch, "spsc batch" );
+        ok &= checkSpsc( items, Mode::kBlocking, "spsc blocking" );
+        ok &= checkMpmc( items, threads );
+        ok &= checkChannel( items, threads, nullptr, "channel inline" );
+        {
+            auto pool = ThreadPool{ threads };
+            auto executor = ThreadPoolExecutor{ pool };
+            ok &= checkChannel( items, threads, &executor, "channel executor" );
+        }
+    }
+
+    std::cerr << ( ok ? "all checks passed\n" : "FAILED\n" );
+    return ok ? 0 : 1;
+}
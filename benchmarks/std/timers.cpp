@@ -0,0 +1,185 @@
+// pstd::TimerWheel against libuv timers, which sit in a binary min-heap
+// of the loop.
+//
+//   timer_bench [--timers 1000000] [--span-ms 60000] [--fire-ms 50]
+//               [--resolution-us 1000]
+//
+// Both keep timers preallocated, so only the queue is measured: schedule
+// with random delays up to `--span-ms`, reschedule every timer (deadline
+// refresh), cancel every timer and fire every timer. For the last one
+// timers get delays up to `--fire-ms`, the benchmark sleeps until all are
+// due and times a single advance() against uv_run( UV_RUN_NOWAIT ).
+// Prints JSON report to stdout, nanoseconds per timer.
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <uv.h>
+
+import poller_std;
+import bench;
+
+namespace {
+
+using poller::pstd::Timer;
+using poller::pstd::TimerWheel;
+
+uint64_t fired = 0;
+
+struct BenchTimer final : Timer {
+    BenchTimer()
+        : Timer{ &BenchTimer::fire } {
+        /* noop */
+    }
+
+    static auto fire( Timer & ) -> void {
+        //
+        ++fired;
+    }
+};
+
+auto onUvTimer( uv_timer_t * ) -> void {
+    //
+    ++fired;
+}
+
+struct Result {
+    double schedule;
+    double reschedule;
+    double cancel;
+    double fire;
+};
+
+auto perTimer( uint64_t start, size_t count ) -> double {
+    //
+    return static_cast<double>( bench::nowNs() - start ) / static_cast<double>( count );
+}
+
+auto runWheel( const std::vector<uint64_t> &delays, const std::vector<uint64_t> &short_delays, uint64_t fire_ms,
+               std::chrono::microseconds resolution ) -> Result {
+    using std::chrono::milliseconds;
+
+    auto result = Result{};
+    auto timers = std::vector<BenchTimer>( delays.size() );
+    auto wheel = TimerWheel{ resolution };
+
+    auto start = bench::nowNs();
+    for ( size_t i = 0; i != timers.size(); ++i ) {
+        wheel.schedule( timers[i], milliseconds{ delays[i] } );
+    }
+    result.schedule = perTimer( start, timers.size() );
+
+    start = bench::nowNs();
+    for ( size_t i = 0; i != timers.size(); ++i ) {
+        wheel.reschedule( timers[i], milliseconds{ delays[timers.size() - 1 - i] } );
+    }
+    result.reschedule = perTimer( start, timers.size() );
+
+    start = bench::nowNs();
+    for ( auto &timer : timers ) {
+        wheel.cancel( timer );
+    }
+    result.cancel = perTimer( start, timers.size() );
+
+    wheel.advance();
+    for ( size_t i = 0; i != timers.size(); ++i ) {
+        wheel.schedule( timers[i], milliseconds{ short_delays[i] } );
+    }
+    std::this_thread::sleep_for( milliseconds{ fire_ms + 1 } + resolution );
+    fired = 0;
+    start = bench::nowNs();
+    wheel.advance();
+    result.fire = perTimer( start, timers.size() );
+    if ( fired != timers.size() ) {
+        std::cerr << "wheel fired " << fired << " of " << timers.size() << '\n';
+    }
+    return result;
+}
+
+auto runUv( const std::vector<uint64_t> &delays, const std::vector<uint64_t> &short_delays, uint64_t fire_ms )
+  -> Result {
+    auto result = Result{};
+    auto loop = uv_loop_t{};
+    uv_loop_init( &loop );
+    auto timers = std::vector<uv_timer_t>( delays.size() );
+    for ( auto &timer : timers ) {
+        uv_timer_init( &loop, &timer );
+    }
+
+    auto start = bench::nowNs();
+    for ( size_t i = 0; i != timers.size(); ++i ) {
+        uv_timer_start( &timers[i], onUvTimer, delays[i], 0 );
+    }
+    result.schedule = perTimer( start, timers.size() );
+
+    start = bench::nowNs();
+    for ( size_t i = 0; i != timers.size(); ++i ) {
+        uv_timer_start( &timers[i], onUvTimer, delays[timers.size() - 1 - i], 0 );
+    }
+    result.reschedule = perTimer( start, timers.size() );
+
+    start = bench::nowNs();
+    for ( auto &timer : timers ) {
+        uv_timer_stop( &timer );
+    }
+    result.cancel = perTimer( start, timers.size() );
+
+    uv_update_time( &loop );
+    for ( size_t i = 0; i != timers.size(); ++i ) {
+        uv_timer_start( &timers[i], onUvTimer, short_delays[i], 0 );
+    }
+    std::this_thread::sleep_for( std::chrono::milliseconds{ fire_ms + 1 } );
+    fired = 0;
+    start = bench::nowNs();
+    uv_run( &loop, UV_RUN_NOWAIT );
+    result.fire = perTimer( start, timers.size() );
+    if ( fired != timers.size() ) {
+        std::cerr << "uv fired " << fired << " of " << timers.size() << '\n';
+    }
+
+    for ( auto &timer : timers ) {
+        uv_close( reinterpret_cast<uv_handle_t *>( &timer ), nullptr );
+    }
+    uv_run( &loop, UV_RUN_DEFAULT );
+    uv_loop_close( &loop );
+    return result;
+}
+
+}  // namespace
+
+auto main( int argc, char **argv ) -> int {
+    const auto count = bench::option<size_t>( argc, argv, "--timers", 1'000'000 );
+    const auto span_ms = bench::option<uint64_t>( argc, argv, "--span-ms", 60'000 );
+    const auto fire_ms = bench::option<uint64_t>( argc, argv, "--fire-ms", 50 );
+    const auto resolution = std::chrono::microseconds{ bench::option<uint64_t>( argc, argv, "--resolution-us", 1000 ) };
+
+    auto rng = std::mt19937_64{ 42 };
+    auto delays = std::vector<uint64_t>( count );
+    auto short_delays = std::vector<uint64_t>( count );
+    for ( size_t i = 0; i != count; ++i ) {
+        delays[i] = 1 + rng() % span_ms;
+        short_delays[i] = rng() % ( fire_ms + 1 );
+    }
+
+    auto report = bench::Report{ "timers" };
+    const auto add = [&]( const std::string &impl, const Result &result ) -> void {
+        const auto params = bench::Params{ { "impl", impl }, { "timers", std::to_string( count ) } };
+        report.add( "timer_schedule", params, { { "ns_per_op", result.schedule } } );
+        report.add( "timer_reschedule", params, { { "ns_per_op", result.reschedule } } );
+        report.add( "timer_cancel", params, { { "ns_per_op", result.cancel } } );
+        report.add( "timer_fire", params, { { "ns_per_op", result.fire } } );
+    };
+
+    std::cerr << "wheel\n";
+    add( "wheel", runWheel( delays, short_delays, fire_ms, resolution ) );
+    std::cerr << "uv_heap\n";
+    add( "uv_heap", runUv( delays, short_delays, fire_ms ) );
+
+    report.print();
+    return 0;
+}
@@ -1,183 +1,862 @@
 
+// Loopback HTTP benchmark server.
+//
+// Single libuv loop serving HTTP/1.1 (keep-alive, pipelining) and h2c with
+// prior knowledge (HTTP/2 over cleartext, what curl does with
+// CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE, i.e. HttpRequest::forceUseV2()) on
+// the same port. Every request gets a response body of configured size
+// after configured delay, with a status drawn from configured status mix.
+// Request headers and bodies are ignored.
+//
+// Usage:
+//   uvtcp [--host 127.0.0.1] [--port 10000] [--size 1024] [--delay 0]
+//         [--status 200:95,500:4,503:1] [--seed 42]
+//
+// --size   response body size in bytes
+// --delay  response delay in milliseconds
+// --status comma separated status:weight pairs
+//
+// On SIGINT/SIGTERM served request counters are printed to stderr.
+
 #include <uv.h>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
-#include <unistd.h>
 #include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace {
 
-static uv_loop_t *loop{};
-static uv_tcp_t server{};
-
-/*
- * Stores everything about a request
- */
-struct client_request_data {
-    time_t start;
-    char *text;
-    size_t text_len;
-    char *response;
-    int work_started;
-    uv_tcp_t *client;
-    uv_work_t *work_req;
-    uv_write_t *write_req;
-    uv_timer_t *timer;
+// ================================
+// Configuration
+// ================================
+
+struct StatusWeight {
+    int status;
+    uint32_t weight;
 };
 
-/* Allocate buffers as requested by UV */
-static void alloc_buffer( uv_handle_t *handle, size_t size, uv_buf_t *buf ) {
-    char *base{};
-    base = static_cast<char *>( calloc( 1, size ) );
-    if ( !base )
-        *buf = uv_buf_init( nullptr, 0 );
-    else
-        *buf = uv_buf_init( base, size );
-}
-
-/* Callback to free the handle */
-static void on_close_free( uv_handle_t *handle ) {
-    free( handle );
-}
-
-/*
- * Callback for freeing up all resources allocated for request
- */
-static void close_data( struct client_request_data *data ) {
-    if ( !data ) return;
-    if ( data->client ) uv_close( (uv_handle_t *)data->client, on_close_free );
-    if ( data->work_req ) free( data->work_req );
-    if ( data->write_req ) free( data->write_req );
-    if ( data->timer ) uv_close( (uv_handle_t *)data->timer, on_close_free );
-    if ( data->text ) free( data->text );
-    if ( data->response ) free( data->response );
-    free( data );
-}
-
-/*
- *  Callback for when the TCP write is complete
- */
-static void on_write_end( uv_write_t *req, int status ) {
-    struct client_request_data *data{};
-    data = static_cast<client_request_data *>( req->data );
-    close_data( data );
-}
-
-/*
- * Callback for post completion of the work associated with the
- * request
- */
-static void after_process_command( uv_work_t *req, int status ) {
-    struct client_request_data *data{};
-    data = static_cast<client_request_data *>( req->data );
-    uv_buf_t buf = uv_buf_init( data->response, strlen( data->response ) + 1 );
-    data->write_req = static_cast<uv_write_t *>( malloc( sizeof( *data->write_req ) ) );
-    data->write_req->data = data;
-    uv_timer_stop( data->timer );
-
-    // NOTE: plain c-style cast in previous.
-    uv_write( data->write_req, reinterpret_cast<uv_stream_t *>( data->client ), &buf, 1, on_write_end );
-}
-
-/*
- * Callback for doing the actual work.
- */
-static void process_command( uv_work_t *req ) {
-    struct client_request_data *data{};
-    char *x{};
-    data = static_cast<client_request_data *>( req->data );
-    // Do the actual time-consuming request processing here
-    data->response = strdup( "Hello World, work's done\n" );
-}
-
-/* Callback for read function, called multiple times per request */
-static void read_cb( uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf ) {
-    uv_tcp_t *client{};
-    struct client_request_data *data{};
-    char *tmp{};
-
-    // NOTE: plain c-style cast in previous.
-    client = reinterpret_cast<uv_tcp_t *>( stream );
-
-    data = static_cast<client_request_data *>( stream->data );
-
-    if ( nread == -1 || nread == UV_EOF ) {
-        free( buf->base );
-        uv_timer_stop( data->timer );
-        close_data( data );
-    } else {
-        if ( !data->text ) {
-            data->text = static_cast<char *>( malloc( nread + 1 ) );
-            memcpy( data->text, buf->base, nread );
-            data->text[nread] = '\0';
-            data->text_len = nread;
+struct Config {
+    std::string host{ "127.0.0.1" };
+    int port{ 10000 };
+    size_t size{ 1024 };
+    uint64_t delay{ 0 };
+    std::vector<StatusWeight> mix{ { 200, 1 } };
+    uint64_t seed{ 42 };
+};
+
+Config config{};
+
+uv_loop_t *loop{};
+uv_tcp_t server{};
+uv_signal_t sigint{};
+uv_signal_t sigterm{};
+
+// Shared response body, filled once.
+std::string body{};
+
+struct Stats {
+    uint64_t connections{};
+    uint64_t http1{};
+    uint64_t http2{};
+} stats{};
+
+template <typename T>
+auto parseNumber( std::string_view text, T &value ) -> bool {
+    const auto [ptr, ec] = std::from_chars( text.data(), text.data() + text.size(), value );
+    return ec == std::errc{} && ptr == text.data() + text.size();
+}
+
+// "200:95,500:5" -> { {200, 95}, {500, 5} }
+auto parseMix( std::string_view text, std::vector<StatusWeight> &mix ) -> bool {
+    mix.clear();
+    while ( !text.empty() ) {
+        const auto comma = text.find( ',' );
+        const auto item = text.substr( 0, comma );
+        text = comma == std::string_view::npos ? std::string_view{} : text.substr( comma + 1 );
+
+        const auto colon = item.find( ':' );
+        auto entry = StatusWeight{ 0, 1 };
+        if ( !parseNumber( item.substr( 0, colon ), entry.status ) ) {
+            return false;
+        }
+        if ( colon != std::string_view::npos && !parseNumber( item.substr( colon + 1 ), entry.weight ) ) {
+            return false;
+        }
+        if ( entry.status < 100 || entry.status > 999 ) {
+            return false;
+        }
+        mix.push_back( entry );
+    }
+    return !mix.empty();
+}
+
+auto parseArgs( int argc, char **argv ) -> bool {
+    for ( int i = 1; i < argc; ++i ) {
+        const auto arg = std::string_view{ argv[i] };
+        const auto value = i + 1 < argc ? std::string_view{ argv[i + 1] } : std::string_view{};
+        auto ok = !value.empty();
+
+        if ( arg == "--host" ) {
+            config.host = value;
+        } else if ( arg == "--port" ) {
+            ok = ok && parseNumber( value, config.port );
+        } else if ( arg == "--size" ) {
+            ok = ok && parseNumber( value, config.size );
+        } else if ( arg == "--delay" ) {
+            ok = ok && parseNumber( value, config.delay );
+        } else if ( arg == "--status" ) {
+            ok = ok && parseMix( value, config.mix );
+        } else if ( arg == "--seed" ) {
+            ok = ok && parseNumber( value, config.seed );
         } else {
-            tmp = static_cast<char *>( realloc( data->text, data->text_len + nread + 1 ) );
-            memcpy( tmp + data->text_len, buf->base, nread );
-            tmp[data->text_len + nread] = '\0';
-            data->text = tmp;
-            data->text_len += nread;
+            ok = false;
         }
-        free( buf->base );
-        if (
-          !data->work_started && data->text_len && ( strstr( data->text, "\r\n" ) || strstr( data->text, "\n\n" ) ) ) {
-            data->work_req = static_cast<uv_work_t *>( malloc( sizeof( *data->work_req ) ) );
-            data->work_req->data = data;
-            data->work_started = 1;
-            uv_read_stop( stream );
-            uv_queue_work( loop, data->work_req, process_command, after_process_command );
+
+        if ( !ok ) {
+            std::fprintf( stderr, "bad argument: %s\n", argv[i] );
+            return false;
         }
+        ++i;
     }
+    return true;
 }
 
-/* Callback for the timer which signifies a timeout */
-static void client_timeout_cb( uv_timer_t *handle ) {
-    struct client_request_data *data{};
-    data = static_cast<struct client_request_data *>( handle->data );
-    uv_timer_stop( handle );
-    if ( data->work_started ) return;
-    close_data( data );
+// Deterministic status draw (xorshift64), reproducible between runs.
+auto nextStatus() -> int {
+    if ( config.mix.size() == 1 ) {
+        return config.mix.front().status;
+    }
+
+    static uint64_t state = config.seed ? config.seed : 1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+
+    uint64_t total{};
+    for ( const auto &entry : config.mix ) {
+        total += entry.weight;
+    }
+
+    auto pick = state % total;
+    for ( const auto &entry : config.mix ) {
+        if ( pick < entry.weight ) {
+            return entry.status;
+        }
+        pick -= entry.weight;
+    }
+    return config.mix.back().status;
+}
+
+auto reason( int status ) -> const char * {
+    switch ( status ) {
+        case 200:
+            return "OK";
+        case 204:
+            return "No Content";
+        case 400:
+            return "Bad Request";
+        case 404:
+            return "Not Found";
+        case 429:
+            return "Too Many Requests";
+        case 500:
+            return "Internal Server Error";
+        case 502:
+            return "Bad Gateway";
+        case 503:
+            return "Service Unavailable";
+        case 504:
+            return "Gateway Timeout";
+        default:
+            return "Unknown";
+    }
 }
 
-/* Callback for handling the new connection */
-static void connection_cb( uv_stream_t *server, int status ) {
-    struct client_request_data *data{}; /* if status not zero there was an error */
-    if ( status == -1 ) {
+// ================================
+// Connection
+// ================================
+
+// HTTP/2 frame types and flags (RFC 9113).
+constexpr uint8_t kFrameData = 0x0;
+constexpr uint8_t kFrameHeaders = 0x1;
+constexpr uint8_t kFrameRstStream = 0x3;
+constexpr uint8_t kFrameSettings = 0x4;
+constexpr uint8_t kFramePing = 0x6;
+constexpr uint8_t kFrameGoaway = 0x7;
+constexpr uint8_t kFrameWindowUpdate = 0x8;
+constexpr uint8_t kFrameContinuation = 0x9;
+
+constexpr uint8_t kFlagEndStream = 0x1;
+constexpr uint8_t kFlagAck = 0x1;
+constexpr uint8_t kFlagEndHeaders = 0x4;
+
+constexpr uint16_t kSettingsInitialWindowSize = 0x4;
+constexpr uint16_t kSettingsMaxFrameSize = 0x5;
+constexpr uint16_t kSettingsMaxConcurrentStreams = 0x3;
+
+constexpr std::string_view kPreface{ "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n" };
+
+constexpr size_t kMaxHeaderBytes = 64 * 1024;
+
+struct H2Stream {
+    int64_t window{};
+    int status{};
+    size_t sent{};
+    // Request fully received (END_STREAM seen).
+    bool requested{ false };
+    // Delay expired, response may be sent.
+    bool ready{ false };
+    bool headersSent{ false };
+};
+
+struct Connection {
+    uv_tcp_t tcp{};
+
+    // Open handles (tcp and delay timers) plus writes in flight. Connection
+    // is freed when it drops to zero.
+    int refs{ 1 };
+    bool closing{ false };
+    bool closeAfterFlush{ false };
+
+    enum class Protocol { Unknown, Http1, Http2 } protocol{ Protocol::Unknown };
+
+    std::string in{};
+    std::string out{};
+
+    // HTTP/1.1: delayed response in progress, keep pipelined requests queued.
+    bool busy{ false };
+
+    // HTTP/2.
+    int64_t connectionWindow{ 65535 };
+    int64_t initialWindow{ 65535 };
+    uint32_t maxFrame{ 16384 };
+    uint32_t continuationStream{ 0 };
+    bool continuationEndStream{ false };
+    std::unordered_map<uint32_t, H2Stream> streams{};
+};
+
+struct WriteRequest {
+    uv_write_t req{};
+    Connection *connection{};
+    std::string data{};
+};
+
+struct DelayTimer {
+    uv_timer_t timer{};
+    Connection *connection{};
+    uint32_t stream{};
+    int status{};
+    bool keepAlive{};
+    void ( *fire )( DelayTimer * ){};
+};
+
+auto processHttp1( Connection *c ) -> void;
+auto flushHttp2( Connection *c ) -> void;
+
+auto release( Connection *c ) -> void {
+    if ( --c->refs == 0 ) {
+        delete c;
+    }
+}
+
+auto closeConnection( Connection *c ) -> void {
+    if ( c->closing ) {
+        return;
+    }
+    c->closing = true;
+    uv_close( reinterpret_cast<uv_handle_t *>( &c->tcp ), []( uv_handle_t *handle ) -> void {
+        //
+        release( static_cast<Connection *>( handle->data ) );
+    } );
+}
+
+auto flush( Connection *c ) -> void {
+    if ( c->closing ) {
+        c->out.clear();
+        return;
+    }
+
+    if ( !c->out.empty() ) {
+        auto *w = new WriteRequest{};
+        w->connection = c;
+        w->data.swap( c->out );
+        w->req.data = w;
+        ++c->refs;
+
+        auto buf = uv_buf_init( w->data.data(), static_cast<unsigned>( w->data.size() ) );
+        const auto r = uv_write( &w->req, reinterpret_cast<uv_stream_t *>( &c->tcp ), &buf, 1,
+                                 []( uv_write_t *req, int status ) -> void {
+                                     auto *w = static_cast<WriteRequest *>( req->data );
+                                     auto *c = w->connection;
+                                     delete w;
+                                     if ( status < 0 || ( c->closeAfterFlush && c->out.empty() ) ) {
+                                         closeConnection( c );
+                                     }
+                                     release( c );
+                                 } );
+        if ( r < 0 ) {
+            delete w;
+            release( c );
+            closeConnection( c );
+        }
         return;
     }
-    data = static_cast<client_request_data *>( calloc( 1, sizeof( *data ) ) );
-    data->start = time( nullptr );
-    auto client = static_cast<uv_tcp_t *>( malloc( sizeof( uv_tcp_t ) ) );
-    client->data = data;
-    data->client = client;
-    /* initialize the new client */
-    uv_tcp_init( loop, client );
-    if ( uv_accept( server, (uv_stream_t *)client ) == 0 ) {
-        /* start reading from stream */ uv_timer_t *timer{};
-        timer = static_cast<uv_timer_t *>( malloc( sizeof( *timer ) ) );
-        timer->data = data;
-        data->timer = timer;
-        uv_timer_init( loop, timer );
-        uv_timer_set_repeat( timer, 1 );
-        uv_timer_start( timer, client_timeout_cb, 10000, 20000 );
 
-        // NOTE: plain c-style cast in previous.
-        uv_read_start( reinterpret_cast<uv_stream_t *>( client ), alloc_buffer, read_cb );
+    if ( c->closeAfterFlush ) {
+        closeConnection( c );
+    }
+}
+
+// Start response after configured delay (or right away).
+auto schedule( Connection *c, uint32_t stream, int status, bool keepAlive, void ( *fire )( DelayTimer * ) ) -> void {
+    auto *t = new DelayTimer{};
+    t->connection = c;
+    t->stream = stream;
+    t->status = status;
+    t->keepAlive = keepAlive;
+    t->fire = fire;
+    ++c->refs;
+
+    uv_timer_init( loop, &t->timer );
+    t->timer.data = t;
+    uv_timer_start(
+      &t->timer,
+      []( uv_timer_t *handle ) -> void {
+          auto *t = static_cast<DelayTimer *>( handle->data );
+          if ( !t->connection->closing ) {
+              t->fire( t );
+          }
+          uv_close( reinterpret_cast<uv_handle_t *>( handle ), []( uv_handle_t *handle ) -> void {
+              auto *t = static_cast<DelayTimer *>( handle->data );
+              release( t->connection );
+              delete t;
+          } );
+      },
+      config.delay, 0 );
+}
+
+// ================================
+// HTTP/1.1
+// ================================
+
+auto respondHttp1( Connection *c, int status, bool keepAlive ) -> void {
+    auto &out = c->out;
+    out += "HTTP/1.1 ";
+    out += std::to_string( status );
+    out += ' ';
+    out += reason( status );
+    out += "\r\nContent-Type: application/octet-stream\r\nContent-Length: ";
+    out += std::to_string( body.size() );
+    out += keepAlive ? "\r\n\r\n" : "\r\nConnection: close\r\n\r\n";
+    out += body;
+
+    ++stats.http1;
+
+    if ( !keepAlive ) {
+        c->closeAfterFlush = true;
+        uv_read_stop( reinterpret_cast<uv_stream_t *>( &c->tcp ) );
+    }
+}
+
+auto iequals( std::string_view a, std::string_view b ) -> bool {
+    return a.size() == b.size() && std::equal( a.begin(), a.end(), b.begin(), []( char x, char y ) -> bool {
+               return std::tolower( static_cast<unsigned char>( x ) ) == std::tolower( static_cast<unsigned char>( y ) );
+           } );
+}
+
+auto trim( std::string_view s ) -> std::string_view {
+    while ( !s.empty() && ( s.front() == ' ' || s.front() == '\t' ) ) {
+        s.remove_prefix( 1 );
+    }
+    while ( !s.empty() && ( s.back() == ' ' || s.back() == '\t' ) ) {
+        s.remove_suffix( 1 );
+    }
+    return s;
+}
+
+auto processHttp1( Connection *c ) -> void {
+    while ( !c->busy && !c->closing && !c->closeAfterFlush ) {
+        const auto view = std::string_view{ c->in };
+        const auto end = view.find( "\r\n\r\n" );
+        if ( end == std::string_view::npos ) {
+            if ( view.size() > kMaxHeaderBytes ) {
+                c->out += "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\n"
+                          "Connection: close\r\n\r\n";
+                c->closeAfterFlush = true;
+            }
+            return;
+        }
+
+        auto head = view.substr( 0, end );
+        const auto lineEnd = head.find( "\r\n" );
+        const auto requestLine = head.substr( 0, lineEnd );
+        head = lineEnd == std::string_view::npos ? std::string_view{} : head.substr( lineEnd + 2 );
+
+        auto keepAlive = requestLine.ends_with( "HTTP/1.1" );
+        size_t contentLength{};
+
+        while ( !head.empty() ) {
+            const auto eol = head.find( "\r\n" );
+            const auto line = head.substr( 0, eol );
+            head = eol == std::string_view::npos ? std::string_view{} : head.substr( eol + 2 );
+
+            const auto colon = line.find( ':' );
+            if ( colon == std::string_view::npos ) {
+                continue;
+            }
+            const auto name = trim( line.substr( 0, colon ) );
+            const auto value = trim( line.substr( colon + 1 ) );
 
-    } else {
-        /* close client stream on error */
-        close_data( data );
+            if ( iequals( name, "content-length" ) ) {
+                parseNumber( value, contentLength );
+            } else if ( iequals( name, "connection" ) ) {
+                if ( iequals( value, "close" ) ) {
+                    keepAlive = false;
+                } else if ( iequals( value, "keep-alive" ) ) {
+                    keepAlive = true;
+                }
+            }
+        }
+
+        const auto total = end + 4 + contentLength;
+        if ( c->in.size() < total ) {
+            // Wait for the rest of the request body.
+            return;
+        }
+        c->in.erase( 0, total );
+
+        const auto status = nextStatus();
+        if ( config.delay == 0 ) {
+            respondHttp1( c, status, keepAlive );
+            continue;
+        }
+
+        // Responses must go out in request order, hold the rest of the
+        // pipeline until this one is sent.
+        c->busy = true;
+        schedule( c, 0, status, keepAlive, []( DelayTimer *t ) -> void {
+            auto *c = t->connection;
+            c->busy = false;
+            respondHttp1( c, t->status, t->keepAlive );
+            processHttp1( c );
+            flush( c );
+        } );
     }
 }
 
+// ================================
+// HTTP/2 (h2c prior knowledge)
+// ================================
+
+auto put32( std::string &out, uint32_t v ) -> void {
+    out += static_cast<char>( ( v >> 24 ) & 0xff );
+    out += static_cast<char>( ( v >> 16 ) & 0xff );
+    out += static_cast<char>( ( v >> 8 ) & 0xff );
+    out += static_cast<char>( v & 0xff );
+}
+
+auto get32( const char *p ) -> uint32_t {
+    const auto *u = reinterpret_cast<const unsigned char *>( p );
+    return ( uint32_t{ u[0] } << 24 ) | ( uint32_t{ u[1] } << 16 ) | ( uint32_t{ u[2] } << 8 ) | u[3];
+}
+
+auto frameHeader( std::string &out, size_t length, uint8_t type, uint8_t flags, uint32_t stream ) -> void {
+    out += static_cast<char>( ( length >> 16 ) & 0xff );
+    out += static_cast<char>( ( length >> 8 ) & 0xff );
+    out += static_cast<char>( length & 0xff );
+    out += static_cast<char>( type );
+    out += static_cast<char>( flags );
+    put32( out, stream & 0x7fffffff );
+}
+
+// HPACK integer with N-bit prefix (RFC 7541, 5.1).
+auto hpackInteger( std::string &out, uint8_t first, uint8_t prefixBits, size_t value ) -> void {
+    const auto max = ( 1u << prefixBits ) - 1;
+    if ( value < max ) {
+        out += static_cast<char>( first | value );
+        return;
+    }
+    out += static_cast<char>( first | max );
+    value -= max;
+    while ( value >= 128 ) {
+        out += static_cast<char>( ( value & 0x7f ) | 0x80 );
+        value >>= 7;
+    }
+    out += static_cast<char>( value );
+}
+
+// Literal header field without indexing, name from static table.
+auto hpackLiteral( std::string &out, size_t nameIndex, std::string_view value ) -> void {
+    hpackInteger( out, 0x00, 4, nameIndex );
+    hpackInteger( out, 0x00, 7, value.size() );
+    out += value;
+}
+
+auto responseHeaders( int status ) -> std::string {
+    auto block = std::string{};
+
+    // :status, indexed when it is in the static table.
+    switch ( status ) {
+        case 200:
+            block += static_cast<char>( 0x80 | 8 );
+            break;
+        case 204:
+            block += static_cast<char>( 0x80 | 9 );
+            break;
+        case 400:
+            block += static_cast<char>( 0x80 | 12 );
+            break;
+        case 404:
+            block += static_cast<char>( 0x80 | 13 );
+            break;
+        case 500:
+            block += static_cast<char>( 0x80 | 14 );
+            break;
+        default:
+            hpackLiteral( block, 8, std::to_string( status ) );
+    }
+
+    // content-length (28), content-type (31).
+    hpackLiteral( block, 28, std::to_string( body.size() ) );
+    hpackLiteral( block, 31, "application/octet-stream" );
+
+    return block;
+}
+
+auto windowUpdate( std::string &out, uint32_t stream, uint32_t increment ) -> void {
+    frameHeader( out, 4, kFrameWindowUpdate, 0, stream );
+    put32( out, increment & 0x7fffffff );
+}
+
+auto goaway( Connection *c, uint32_t error ) -> void {
+    frameHeader( c->out, 8, kFrameGoaway, 0, 0 );
+    put32( c->out, 0 );
+    put32( c->out, error );
+    c->closeAfterFlush = true;
+}
+
+auto startStream( Connection *c, uint32_t id, H2Stream &stream ) -> void {
+    stream.requested = true;
+    stream.status = nextStatus();
+
+    if ( config.delay == 0 ) {
+        stream.ready = true;
+        return;
+    }
+
+    schedule( c, id, stream.status, true, []( DelayTimer *t ) -> void {
+        auto *c = t->connection;
+        if ( auto it = c->streams.find( t->stream ); it != c->streams.end() ) {
+            it->second.ready = true;
+            flushHttp2( c );
+            flush( c );
+        }
+    } );
+}
+
+// Emit as much of ready responses as flow control windows allow.
+auto flushHttp2( Connection *c ) -> void {
+    for ( auto it = c->streams.begin(); it != c->streams.end(); ) {
+        auto &[id, stream] = *it;
+        if ( !stream.ready ) {
+            ++it;
+            continue;
+        }
+
+        if ( !stream.headersSent ) {
+            const auto block = responseHeaders( stream.status );
+            frameHeader( c->out, block.size(), kFrameHeaders, kFlagEndHeaders | ( body.empty() ? kFlagEndStream : 0 ),
+                         id );
+            c->out += block;
+            stream.headersSent = true;
+        }
+
+        while ( stream.sent < body.size() && c->connectionWindow > 0 && stream.window > 0 ) {
+            const auto chunk = std::min<size_t>(
+              { body.size() - stream.sent, c->maxFrame, static_cast<size_t>( c->connectionWindow ),
+                static_cast<size_t>( stream.window ) } );
+            const auto last = stream.sent + chunk == body.size();
+
+            frameHeader( c->out, chunk, kFrameData, last ? kFlagEndStream : 0, id );
+            c->out.append( body, stream.sent, chunk );
+
+            stream.sent += chunk;
+            stream.window -= static_cast<int64_t>( chunk );
+            c->connectionWindow -= static_cast<int64_t>( chunk );
+        }
+
+        if ( stream.sent == body.size() ) {
+            ++stats.http2;
+            it = c->streams.erase( it );
+        } else {
+            ++it;
+        }
+    }
+}
+
+auto onHeadersComplete( Connection *c, uint32_t id, bool endStream ) -> void {
+    if ( id == 0 ) {
+        return;
+    }
+    const auto [it, inserted] = c->streams.try_emplace( id );
+    if ( inserted ) {
+        it->second.window = c->initialWindow;
+    }
+    // Trailers after request body end the stream too.
+    if ( endStream && !it->second.requested ) {
+        startStream( c, id, it->second );
+    }
+}
+
+auto processHttp2( Connection *c ) -> void {
+    size_t pos{};
+    const auto &in = c->in;
+
+    while ( !c->closeAfterFlush && in.size() - pos >= 9 ) {
+        const auto *p = in.data() + pos;
+        const auto length = ( size_t{ static_cast<unsigned char>( p[0] ) } << 16 ) |
+                            ( size_t{ static_cast<unsigned char>( p[1] ) } << 8 ) | static_cast<unsigned char>( p[2] );
+        const auto type = static_cast<uint8_t>( p[3] );
+        const auto flags = static_cast<uint8_t>( p[4] );
+        const auto id = get32( p + 5 ) & 0x7fffffff;
+
+        if ( length > 16384 ) {
+            // We never advertise bigger SETTINGS_MAX_FRAME_SIZE.
+            goaway( c, 0x6 /* FRAME_SIZE_ERROR */ );
+            break;
+        }
+        if ( in.size() - pos < 9 + length ) {
+            break;
+        }
+
+        auto payload = std::string_view{ p + 9, length };
+        pos += 9 + length;
+
+        if ( c->continuationStream && type != kFrameContinuation ) {
+            goaway( c, 0x1 /* PROTOCOL_ERROR */ );
+            break;
+        }
+
+        switch ( type ) {
+            case kFrameHeaders: {
+                // Header block itself is not needed, every request gets
+                // the same response.
+                if ( flags & kFlagEndHeaders ) {
+                    onHeadersComplete( c, id, flags & kFlagEndStream );
+                } else {
+                    c->continuationStream = id;
+                    c->continuationEndStream = flags & kFlagEndStream;
+                }
+                break;
+            }
+            case kFrameContinuation: {
+                if ( id != c->continuationStream ) {
+                    goaway( c, 0x1 /* PROTOCOL_ERROR */ );
+                    break;
+                }
+                if ( flags & kFlagEndHeaders ) {
+                    c->continuationStream = 0;
+                    onHeadersComplete( c, id, c->continuationEndStream );
+                }
+                break;
+            }
+            case kFrameData: {
+                // Give the credit back right away, request bodies are discarded.
+                if ( length ) {
+                    windowUpdate( c->out, 0, static_cast<uint32_t>( length ) );
+                    if ( !( flags & kFlagEndStream ) ) {
+                        windowUpdate( c->out, id, static_cast<uint32_t>( length ) );
+                    }
+                }
+                if ( flags & kFlagEndStream ) {
+                    if ( auto it = c->streams.find( id ); it != c->streams.end() && !it->second.requested ) {
+                        startStream( c, id, it->second );
+                    }
+                }
+                break;
+            }
+            case kFrameSettings: {
+                if ( flags & kFlagAck ) {
+                    break;
+                }
+                for ( size_t i = 0; i + 6 <= payload.size(); i += 6 ) {
+                    const auto key = static_cast<uint16_t>( ( static_cast<unsigned char>( payload[i] ) << 8 ) |
+                                                            static_cast<unsigned char>( payload[i + 1] ) );
+                    const auto value = get32( payload.data() + i + 2 );
+                    if ( key == kSettingsInitialWindowSize ) {
+                        const auto delta = static_cast<int64_t>( value ) - c->initialWindow;
+                        c->initialWindow = value;
+                        for ( auto &[_, stream] : c->streams ) {
+                            stream.window += delta;
+                        }
+                    } else if ( key == kSettingsMaxFrameSize ) {
+                        c->maxFrame = value;
+                    }
+                }
+                frameHeader( c->out, 0, kFrameSettings, kFlagAck, 0 );
+                break;
+            }
+            case kFramePing: {
+                if ( !( flags & kFlagAck ) && length == 8 ) {
+                    frameHeader( c->out, 8, kFramePing, kFlagAck, 0 );
+                    c->out += payload;
+                }
+                break;
+            }
+            case kFrameWindowUpdate: {
+                if ( length != 4 ) {
+                    break;
+                }
+                const auto increment = get32( payload.data() ) & 0x7fffffff;
+                if ( id == 0 ) {
+                    c->connectionWindow += increment;
+                } else if ( auto it = c->streams.find( id ); it != c->streams.end() ) {
+                    it->second.window += increment;
+                }
+                break;
+            }
+            case kFrameRstStream: {
+                c->streams.erase( id );
+                break;
+            }
+            case kFrameGoaway: {
+                c->closeAfterFlush = true;
+                break;
+            }
+            default:
+                // PRIORITY, unknown extension frames.
+                break;
+        }
+    }
+
+    c->in.erase( 0, pos );
+    flushHttp2( c );
+}
+
+// ================================
+// libuv callbacks
+// ================================
+
+auto allocBuffer( uv_handle_t *, size_t, uv_buf_t *buf ) -> void {
+    // Single loop thread and read callback consumes data synchronously,
+    // one static buffer is enough.
+    static char buffer[64 * 1024];
+    *buf = uv_buf_init( buffer, sizeof( buffer ) );
+}
+
+auto onRead( uv_stream_t *stream, ssize_t nread, const uv_buf_t *buf ) -> void {
+    auto *c = static_cast<Connection *>( stream->data );
+
+    if ( nread < 0 ) {
+        closeConnection( c );
+        return;
+    }
+
+    c->in.append( buf->base, static_cast<size_t>( nread ) );
+
+    if ( c->protocol == Connection::Protocol::Unknown ) {
+        const auto n = std::min( c->in.size(), kPreface.size() );
+        if ( std::string_view{ c->in }.substr( 0, n ) != kPreface.substr( 0, n ) ) {
+            c->protocol = Connection::Protocol::Http1;
+        } else if ( n == kPreface.size() ) {
+            c->protocol = Connection::Protocol::Http2;
+            c->in.erase( 0, kPreface.size() );
+
+            // Server preface.
+            frameHeader( c->out, 6, kFrameSettings, 0, 0 );
+            c->out += static_cast<char>( kSettingsMaxConcurrentStreams >> 8 );
+            c->out += static_cast<char>( kSettingsMaxConcurrentStreams & 0xff );
+            put32( c->out, 1000 );
+        }
+    }
+
+    switch ( c->protocol ) {
+        case Connection::Protocol::Http1:
+            processHttp1( c );
+            break;
+        case Connection::Protocol::Http2:
+            processHttp2( c );
+            break;
+        default:
+            break;
+    }
+
+    flush( c );
+}
+
+auto onConnection( uv_stream_t *listener, int status ) -> void {
+    if ( status < 0 ) {
+        std::fprintf( stderr, "connection error: %s\n", uv_strerror( status ) );
+        return;
+    }
+
+    auto *c = new Connection{};
+    uv_tcp_init( loop, &c->tcp );
+    c->tcp.data = c;
+
+    if ( uv_accept( listener, reinterpret_cast<uv_stream_t *>( &c->tcp ) ) != 0 ) {
+        closeConnection( c );
+        return;
+    }
+
+    ++stats.connections;
+    uv_tcp_nodelay( &c->tcp, 1 );
+    uv_read_start( reinterpret_cast<uv_stream_t *>( &c->tcp ), allocBuffer, onRead );
+}
+
+auto onSignal( uv_signal_t *, int ) -> void {
+    std::fprintf(
+      stderr, "connections: %llu, http/1.1 responses: %llu, h2c responses: %llu\n",
+      static_cast<unsigned long long>( stats.connections ), static_cast<unsigned long long>( stats.http1 ),
+      static_cast<unsigned long long>( stats.http2 ) );
+    uv_stop( loop );
+}
+
+}  // namespace
+
 auto main( int argc, char **argv ) -> int {
+    if ( !parseArgs( argc, argv ) ) {
+        std::fprintf(
+          stderr,
+          "usage: %s [--host 127.0.0.1] [--port 10000] [--size bytes] [--delay ms] [--status 200:95,500:5] "
+          "[--seed n]\n",
+          argv[0] );
+        return 1;
+    }
+
+    body.assign( config.size, 'x' );
+
     loop = uv_default_loop();
+
     struct sockaddr_in addr{};
-    uv_ip4_addr( "0.0.0.0", 10000, &addr ); /* initialize the server */
+    if ( const auto r = uv_ip4_addr( config.host.c_str(), config.port, &addr ); r ) {
+        std::fprintf( stderr, "bad address %s: %s\n", config.host.c_str(), uv_strerror( r ) );
+        return 1;
+    }
+
     uv_tcp_init( loop, &server );
-    /* bind the server to the address above */
-    uv_tcp_bind( &server, (struct sockaddr *)&addr, 0 );
-    int r = uv_listen( (uv_stream_t *)&server, 128, connection_cb );
-    if ( r ) {
-        return fprintf( stderr, "Error on listening: %s.\n", uv_strerror( r ) );
-    } /* execute all tasks in queue */
+    uv_tcp_bind( &server, reinterpret_cast<const struct sockaddr *>( &addr ), 0 );
+
+    if ( const auto r = uv_listen( reinterpret_cast<uv_stream_t *>( &server ), 1024, onConnection ); r ) {
+        std::fprintf( stderr, "error on listening: %s\n", uv_strerror( r ) );
+        return 1;
+    }
+
+    uv_signal_init( loop, &sigint );
+    uv_signal_start( &sigint, onSignal, SIGINT );
+    uv_signal_init( loop, &sigterm );
+    uv_signal_start( &sigterm, onSignal, SIGTERM );
+
+    std::fprintf(
+      stderr, "listening on %s:%d, body %zu bytes, delay %llu ms\n", config.host.c_str(), config.port, config.size,
+      static_cast<unsigned long long>( config.delay ) );
+
     return uv_run( loop, UV_RUN_DEFAULT );
 }
@@ -9,6 +9,7 @@ module;
 export module io:async;
 
 import log;
+import poller_std;
 
 namespace poller::io {
 
@@ -20,7 +21,7 @@ struct Task<void> {
     struct promise_type;
     using handle_type = std::coroutine_handle<promise_type>;
 
-    struct promise_type {
+    struct promise_type : poller::pstd::PooledFrame {
         auto get_return_object() -> Task {
             //
             return Task<void>{ handle_type::from_promise( *this ) };
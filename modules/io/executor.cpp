@@ -0,0 +1,42 @@
+module;
+
+#include <coroutine>
+#include <span>
+#include <vector>
+
+#include <uv.h>
+
+export module io:executor;
+
+import poller_std;
+import :scheduler;
+import :payload;
+
+namespace poller::io {
+
+// Resume coroutines on Scheduler event loop thread, whole batch
+// goes as a single loop job.
+export struct SchedulerExecutor final : pstd::Executor {
+    explicit SchedulerExecutor( Scheduler &scheduler )
+        : scheduler_{ scheduler } {}
+
+    auto execute( std::span<const std::coroutine_handle<>> handles ) -> void override {
+        if ( handles.empty() ) {
+            return;
+        }
+
+        auto batch = std::vector<std::coroutine_handle<>>{ handles.begin(), handles.end() };
+        scheduler_.schedule(
+          [batch = std::move( batch )]( uv_loop_t *, AsyncJobPayload * ) -> void {
+              for ( const auto handle : batch ) {
+                  handle.resume();
+              }
+          },
+          nullptr );
+    }
+
+private:
+    Scheduler &scheduler_;
+};
+
+}  // namespace poller::io
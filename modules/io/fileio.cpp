@@ -29,7 +29,7 @@ struct FileIOAwaitable final {
         return false;
     }
 
-    auto await_suspend( std::coroutine_handle<typename T::promise_type> coroHandle ) noexcept -> void {
+    auto await_suspend( std::coroutine_handle<> coroHandle ) noexcept -> void {
         // Execute on event loop.
         auto newFileIOTask = []( uv_loop_t *loop, AsyncJobPayload *payload ) -> void {
             auto openRqst = static_cast<uv_fs_t *>( std::malloc( sizeof( uv_fs_t ) ) );
@@ -50,7 +50,7 @@ struct FileIOAwaitable final {
                 // Must always clean up the request.
                 uv_fs_req_cleanup( openRqst );
 
-                auto coroHandle = std::coroutine_handle<typename T::promise_type>::from_address( payload->coro );
+                auto coroHandle = std::coroutine_handle<>::from_address( payload->coro );
 
                 if ( !coroHandle ) {
                     log::error()( "Bad coro handle!" );
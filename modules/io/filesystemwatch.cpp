@@ -28,7 +28,7 @@ struct FilesystemWatchAwaitable final {
         return false;
     }
 
-    auto await_suspend( std::coroutine_handle<typename T::promise_type> coroHandle ) -> void {
+    auto await_suspend( std::coroutine_handle<> coroHandle ) -> void {
         auto newFilesystemWatchTask = []( uv_loop_t *loop, AsyncJobPayload *payload ) -> void {
             auto onFSEvent = []( uv_fs_event_t *handle, const char *filename, int events, int status ) -> void {
                 auto payload = static_cast<FilesystemWatchCbPayload *>( handle->data );
@@ -45,7 +45,7 @@ struct FilesystemWatchAwaitable final {
                 } );
 
                 // Awake coroutine.
-                auto coroHandle = std::coroutine_handle<typename T::promise_type>::from_address( payload->coro );
+                auto coroHandle = std::coroutine_handle<>::from_address( payload->coro );
 
                 if ( !coroHandle ) {
                     log::error()( "Bad coro handle!" );
@@ -9,3 +9,4 @@ export import :payload;
 export import :fileio;
 export import :timer;
 export import :filewatch;
+export import :executor;
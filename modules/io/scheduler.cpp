@@ -23,6 +23,8 @@ struct FileIOAwaitable;
 export template <typename T>
 struct FilesystemWatchAwaitable;
 
+export struct SchedulerExecutor;
+
 export struct Scheduler final : SchedulerBase {
 public:
     template <typename T>
@@ -34,7 +36,11 @@ public:
     template <typename T>
     friend struct FilesystemWatchAwaitable;
 
+    friend struct SchedulerExecutor;
+
 public:
+    using SchedulerBase::SchedulerBase;
+
     // Fire once by timeout.
     auto timeout( uint64_t timeout ) -> TimeoutAwaitable<Task<void>>;
 
@@ -18,11 +18,16 @@ struct SchedulerBase {
     SchedulerBase( const SchedulerBase &other ) = delete;
     SchedulerBase( SchedulerBase &&other ) = delete;
 
-    SchedulerBase()
+    // Loop thread is pinned to the first CPU of `placement`, if any.
+    explicit SchedulerBase( const pstd::Placement &placement = {} )
         : loop_{ // Allocate main loop handle.
                  static_cast<uv_loop_t *>( std::malloc( sizeof( uv_loop_t ) ) ) } {
         // Start worker thread.
-        thread_ = std::make_unique<std::thread>( [this]() -> void {
+        thread_ = std::make_unique<std::thread>( [this, cpu = placement.cpuFor( 0 )]() -> void {
+            if ( cpu ) {
+                pstd::pinCurrentThread( *cpu );
+            }
+
             const auto ret = uv_loop_init( loop_ );
 
             // Initialized uv_async_t keep loop in polling phase (loop
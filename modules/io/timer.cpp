@@ -27,7 +27,7 @@ struct TimeoutAwaitable final {
         return false;
     }
 
-    auto await_suspend( std::coroutine_handle<typename T::promise_type> coroHandle ) noexcept -> void {
+    auto await_suspend( std::coroutine_handle<> coroHandle ) noexcept -> void {
         // Execute on event loop.
         auto newTimerTask = []( uv_loop_t *loop, AsyncJobPayload *payload ) -> void {
             auto timer = static_cast<uv_timer_t *>( std::malloc( sizeof( uv_timer_t ) ) );
@@ -41,7 +41,7 @@ struct TimeoutAwaitable final {
             // Coroutine resume callback.
             auto onFiresCb = []( uv_timer_t *timer ) -> void {
                 auto payload = static_cast<AsyncJobPayload *>( timer->data );
-                auto coroHandle = std::coroutine_handle<typename T::promise_type>::from_address( payload->coro );
+                auto coroHandle = std::coroutine_handle<>::from_address( payload->coro );
 
                 if ( !coroHandle ) {
                     log::error()( "bad coro handle!" );
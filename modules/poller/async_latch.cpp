@@ -0,0 +1,60 @@
+module;
+
+#include <atomic>
+#include <cstdint>
+
+export module poller:async_latch;
+
+import poller_std;
+
+import :reset_event;
+
+namespace poller {
+
+// Single-use countdown for coroutines: co_await latch suspends until
+// countDown() was called `initialCount` times in total.
+//
+//   auto latch = AsyncLatch{ requests.size() };
+//   for ( auto &r : requests ) { process( r, latch ); }  // each calls latch.countDown()
+//   co_await latch;
+export struct AsyncLatch final {
+public:
+    // Waiters are resumed on executor if given, otherwise inline by
+    // the thread making the last countDown().
+    explicit AsyncLatch( int64_t initialCount, pstd::Executor *executor = nullptr ) noexcept
+        : count_{ initialCount }
+        , event_{ initialCount <= 0, executor } {
+        /* noop */
+    }
+
+    AsyncLatch( const AsyncLatch & ) = delete;
+    AsyncLatch( AsyncLatch && ) = delete;
+    auto operator=( const AsyncLatch & ) -> AsyncLatch & = delete;
+    auto operator=( AsyncLatch && ) -> AsyncLatch & = delete;
+
+    ~AsyncLatch() = default;
+
+    [[nodiscard]]
+    auto isReady() const noexcept -> bool {
+        //
+        return event_.is_set();
+    }
+
+    auto countDown( int64_t n = 1 ) noexcept -> void {
+        // Release our writes to waiters, acquire writes of other counters.
+        if ( count_.fetch_sub( n, std::memory_order_acq_rel ) <= n ) {
+            event_.set();
+        }
+    }
+
+    auto operator co_await() const noexcept -> ResetEvent::Awaiter {
+        //
+        return event_.operator co_await();
+    }
+
+private:
+    std::atomic<int64_t> count_;
+    ResetEvent event_;
+};
+
+}  // namespace poller
@@ -0,0 +1,191 @@
+module;
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <utility>
+
+export module poller:async_mutex;
+
+import poller_std;
+
+import :resume;
+
+namespace poller {
+
+// Mutex for coroutines, waiting for the lock suspends the coroutine
+// instead of blocking the thread. Lock is handed over to waiters in FIFO
+// order. Based on Lewis Baker cppcoro async_mutex.
+//
+// Original code:
+// https://github.com/lewissbaker/cppcoro
+export struct AsyncMutex final {
+public:
+    // Next lock owner is resumed on executor if given, otherwise inline
+    // by the thread calling unlock().
+    explicit AsyncMutex( pstd::Executor *executor = nullptr ) noexcept
+        : executor_{ executor } {
+        /* noop */
+    }
+
+    AsyncMutex( const AsyncMutex & ) = delete;
+    AsyncMutex( AsyncMutex && ) = delete;
+    auto operator=( const AsyncMutex & ) -> AsyncMutex & = delete;
+    auto operator=( AsyncMutex && ) -> AsyncMutex & = delete;
+
+    ~AsyncMutex() = default;
+
+    struct LockAwaiter {
+        explicit LockAwaiter( AsyncMutex &mutex ) noexcept
+            : mutex_{ mutex } {
+            /* noop */
+        }
+
+        [[nodiscard]]
+        auto await_ready() const noexcept -> bool {
+            //
+            return mutex_.tryLock();
+        }
+
+        auto await_suspend( std::coroutine_handle<> awaitingCoroutine ) noexcept -> bool {
+            awaitingCoroutine_ = awaitingCoroutine;
+
+            auto oldState = mutex_.state_.load( std::memory_order_acquire );
+            while ( true ) {
+                if ( oldState == kNotLocked ) {
+                    if ( mutex_.state_.compare_exchange_weak(
+                           oldState, kLockedNoWaiters, std::memory_order_acquire, std::memory_order_relaxed ) ) {
+                        // Acquired lock, don't suspend.
+                        return false;
+                    }
+                } else {
+                    // Try to push this awaiter onto the front of the list.
+                    next_ = reinterpret_cast<LockAwaiter *>( oldState );
+                    if ( mutex_.state_.compare_exchange_weak(
+                           oldState, reinterpret_cast<uintptr_t>( this ), std::memory_order_release,
+                           std::memory_order_relaxed ) ) {
+                        // Queued, unlock() resumes us as the new owner.
+                        return true;
+                    }
+                }
+            }
+        }
+
+        auto await_resume() const noexcept -> void {
+            //
+        }
+
+    protected:
+        friend struct AsyncMutex;
+
+        AsyncMutex &mutex_;
+
+    private:
+        std::coroutine_handle<> awaitingCoroutine_;
+        LockAwaiter *next_{ nullptr };
+    };
+
+    // Releases the mutex when destroyed.
+    struct ScopedLock {
+        explicit ScopedLock( AsyncMutex &mutex ) noexcept
+            : mutex_{ &mutex } {
+            /* noop */
+        }
+
+        ScopedLock( ScopedLock &&other ) noexcept
+            : mutex_{ std::exchange( other.mutex_, nullptr ) } {
+            /* noop */
+        }
+
+        ScopedLock( const ScopedLock & ) = delete;
+        auto operator=( const ScopedLock & ) -> ScopedLock & = delete;
+        auto operator=( ScopedLock && ) -> ScopedLock & = delete;
+
+        ~ScopedLock() {
+            if ( mutex_ ) {
+                mutex_->unlock();
+            }
+        }
+
+    private:
+        AsyncMutex *mutex_;
+    };
+
+    struct ScopedLockAwaiter : LockAwaiter {
+        using LockAwaiter::LockAwaiter;
+
+        [[nodiscard]]
+        auto await_resume() const noexcept -> ScopedLock {
+            //
+            return ScopedLock{ mutex_ };
+        }
+    };
+
+    [[nodiscard]]
+    auto tryLock() noexcept -> bool {
+        auto oldState = kNotLocked;
+        return state_.compare_exchange_strong(
+          oldState, kLockedNoWaiters, std::memory_order_acquire, std::memory_order_relaxed );
+    }
+
+    // co_await mutex.lock(); ... mutex.unlock();
+    [[nodiscard]]
+    auto lock() noexcept -> LockAwaiter {
+        //
+        return LockAwaiter{ *this };
+    }
+
+    // auto guard = co_await mutex.scopedLock();
+    [[nodiscard]]
+    auto scopedLock() noexcept -> ScopedLockAwaiter {
+        //
+        return ScopedLockAwaiter{ *this };
+    }
+
+    // Must be called by current lock owner.
+    auto unlock() -> void {
+        auto *waitersHead = waiters_;
+        if ( waitersHead == nullptr ) {
+            auto oldState = kLockedNoWaiters;
+            if ( state_.compare_exchange_strong(
+                   oldState, kNotLocked, std::memory_order_release, std::memory_order_relaxed ) ) {
+                // Nobody waiting, lock released.
+                return;
+            }
+
+            // Some waiters were queued, take whole list and reverse it
+            // into FIFO order.
+            oldState = state_.exchange( kLockedNoWaiters, std::memory_order_acquire );
+
+            auto *next = reinterpret_cast<LockAwaiter *>( oldState );
+            do {
+                auto *temp = next->next_;
+                next->next_ = waitersHead;
+                waitersHead = next;
+                next = temp;
+            } while ( next != nullptr );
+        }
+
+        // Hand the lock over to the oldest waiter.
+        waiters_ = waitersHead->next_;
+
+        auto batch = ResumeBatch{ executor_ };
+        batch.add( waitersHead->awaitingCoroutine_ );
+    }
+
+private:
+    // - kNotLocked => unlocked.
+    // - kLockedNoWaiters => locked, no newly queued waiters.
+    // - otherwise => locked, head of LIFO list of newly queued LockAwaiter*.
+    static constexpr uintptr_t kNotLocked = 1;
+    static constexpr uintptr_t kLockedNoWaiters = 0;
+
+    std::atomic<uintptr_t> state_{ kNotLocked };
+
+    // FIFO list of waiters taken from state_, only touched by lock owner.
+    LockAwaiter *waiters_{ nullptr };
+
+    pstd::Executor *executor_;
+};
+
+}  // namespace poller
@@ -0,0 +1,268 @@
+module;
+
+#include <algorithm>
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+export module poller:async_semaphore;
+
+import poller_std;
+
+import :resume;
+
+namespace poller {
+
+// Counting semaphore for coroutines, acquire() suspends while no permits
+// are left. Meant for bounding concurrency:
+//
+//   auto permit = co_await limit.scopedAcquire();
+//   co_await requestAsync<void>( ... );
+//
+// Lock-free, state is a single word holding either the number of
+// available permits or the head of an intrusive list of waiters.
+export struct AsyncSemaphore final {
+public:
+    // Waiters are resumed on executor if given, otherwise inline by
+    // the thread calling release().
+    explicit AsyncSemaphore( uint64_t initialCount, pstd::Executor *executor = nullptr ) noexcept
+        : AsyncSemaphore( initialCount, std::numeric_limits<uint64_t>::max() >> 1, executor ) {
+        /* noop */
+    }
+
+    AsyncSemaphore( const AsyncSemaphore & ) = delete;
+    AsyncSemaphore( AsyncSemaphore && ) = delete;
+    auto operator=( const AsyncSemaphore & ) -> AsyncSemaphore & = delete;
+    auto operator=( AsyncSemaphore && ) -> AsyncSemaphore & = delete;
+
+    ~AsyncSemaphore() = default;
+
+    struct AcquireAwaiter {
+        explicit AcquireAwaiter( AsyncSemaphore &semaphore ) noexcept
+            : semaphore_{ semaphore } {
+            /* noop */
+        }
+
+        [[nodiscard]]
+        auto await_ready() const noexcept -> bool {
+            //
+            return semaphore_.tryAcquire();
+        }
+
+        auto await_suspend( std::coroutine_handle<> awaitingCoroutine ) noexcept -> bool {
+            awaitingCoroutine_ = awaitingCoroutine;
+
+            auto oldState = semaphore_.state_.load( std::memory_order_acquire );
+            while ( true ) {
+                if ( isCount( oldState ) ) {
+                    if ( semaphore_.state_.compare_exchange_weak(
+                           oldState, decremented( oldState ), std::memory_order_acquire,
+                           std::memory_order_relaxed ) ) {
+                        // Got a permit, don't suspend.
+                        return false;
+                    }
+                } else {
+                    next_ = reinterpret_cast<AcquireAwaiter *>( oldState );
+                    if ( semaphore_.state_.compare_exchange_weak(
+                           oldState, reinterpret_cast<uintptr_t>( this ), std::memory_order_release,
+                           std::memory_order_relaxed ) ) {
+                        // Queued, release() resumes us with a permit.
+                        return true;
+                    }
+                }
+            }
+        }
+
+        auto await_resume() const noexcept -> void {
+            //
+        }
+
+    protected:
+        friend struct AsyncSemaphore;
+
+        AsyncSemaphore &semaphore_;
+
+    private:
+        std::coroutine_handle<> awaitingCoroutine_;
+        AcquireAwaiter *next_{ nullptr };
+    };
+
+    // Returns the permit when destroyed.
+    struct Permit {
+        explicit Permit( AsyncSemaphore &semaphore ) noexcept
+            : semaphore_{ &semaphore } {
+            /* noop */
+        }
+
+        Permit( Permit &&other ) noexcept
+            : semaphore_{ std::exchange( other.semaphore_, nullptr ) } {
+            /* noop */
+        }
+
+        Permit( const Permit & ) = delete;
+        auto operator=( const Permit & ) -> Permit & = delete;
+        auto operator=( Permit && ) -> Permit & = delete;
+
+        ~Permit() {
+            if ( semaphore_ ) {
+                semaphore_->release();
+            }
+        }
+
+    private:
+        AsyncSemaphore *semaphore_;
+    };
+
+    struct ScopedAcquireAwaiter : AcquireAwaiter {
+        using AcquireAwaiter::AcquireAwaiter;
+
+        [[nodiscard]]
+        auto await_resume() const noexcept -> Permit {
+            //
+            return Permit{ semaphore_ };
+        }
+    };
+
+    [[nodiscard]]
+    auto tryAcquire() noexcept -> bool {
+        auto oldState = state_.load( std::memory_order_relaxed );
+        while ( isCount( oldState ) ) {
+            if ( state_.compare_exchange_weak(
+                   oldState, decremented( oldState ), std::memory_order_acquire, std::memory_order_relaxed ) ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // co_await semaphore.acquire(); ... semaphore.release();
+    [[nodiscard]]
+    auto acquire() noexcept -> AcquireAwaiter {
+        //
+        return AcquireAwaiter{ *this };
+    }
+
+    // auto permit = co_await semaphore.scopedAcquire();
+    [[nodiscard]]
+    auto scopedAcquire() noexcept -> ScopedAcquireAwaiter {
+        //
+        return ScopedAcquireAwaiter{ *this };
+    }
+
+    // Returns `count` permits, each goes straight to a waiter if any.
+    auto release( uint64_t count = 1 ) -> void {
+        auto batch = ResumeBatch{ executor_ };
+
+        // Waiters taken from state_, oldest first.
+        AcquireAwaiter *owned{ nullptr };
+
+        auto oldState = state_.load( std::memory_order_acquire );
+        while ( true ) {
+            while ( count && owned ) {
+                batch.add( owned->awaitingCoroutine_ );
+                owned = owned->next_;
+                --count;
+            }
+
+            if ( count ) {
+                if ( oldState != kEmpty && !isCount( oldState ) ) {
+                    // Take queued waiters.
+                    if ( state_.compare_exchange_weak(
+                           oldState, kEmpty, std::memory_order_acquire, std::memory_order_acquire ) ) {
+                        owned = reversed( reinterpret_cast<AcquireAwaiter *>( oldState ) );
+                        oldState = kEmpty;
+                    }
+                } else {
+                    // Nobody waits, store permits.
+                    const auto available = std::min( permits( oldState ) + count, maxCount_ );
+                    if ( state_.compare_exchange_weak(
+                           oldState, ( available << 1 ) | 1, std::memory_order_release,
+                           std::memory_order_acquire ) ) {
+                        return;
+                    }
+                }
+            } else if ( owned ) {
+                if ( isCount( oldState ) ) {
+                    // Permits were returned meanwhile, use them for our waiters.
+                    if ( state_.compare_exchange_weak(
+                           oldState, kEmpty, std::memory_order_acquire, std::memory_order_acquire ) ) {
+                        count = permits( oldState );
+                        oldState = kEmpty;
+                    }
+                } else {
+                    // Put the rest of waiters back. They may be woken after
+                    // waiters queued meanwhile, so order is not strictly FIFO
+                    // under contention.
+                    auto *head = reversed( owned );
+                    owned->next_ = reinterpret_cast<AcquireAwaiter *>( oldState );
+                    if ( state_.compare_exchange_weak(
+                           oldState, reinterpret_cast<uintptr_t>( head ), std::memory_order_release,
+                           std::memory_order_acquire ) ) {
+                        return;
+                    }
+                    owned->next_ = nullptr;
+                    owned = reversed( head );
+                }
+            } else {
+                return;
+            }
+        }
+    }
+
+    // Permits available right now, for diagnostics.
+    [[nodiscard]]
+    auto available() const noexcept -> uint64_t {
+        //
+        return permits( state_.load( std::memory_order_relaxed ) );
+    }
+
+private:
+    friend struct AsyncAutoResetEvent;
+
+    AsyncSemaphore( uint64_t initialCount, uint64_t maxCount, pstd::Executor *executor ) noexcept
+        : state_{ initialCount ? ( initialCount << 1 ) | 1 : kEmpty }
+        , maxCount_{ maxCount }
+        , executor_{ executor } {
+        /* noop */
+    }
+
+    static auto isCount( uintptr_t state ) noexcept -> bool {
+        //
+        return state & 1;
+    }
+
+    static auto permits( uintptr_t state ) noexcept -> uint64_t {
+        //
+        return isCount( state ) ? state >> 1 : 0;
+    }
+
+    static auto decremented( uintptr_t state ) noexcept -> uintptr_t {
+        //
+        return state == 3 ? kEmpty : state - 2;
+    }
+
+    static auto reversed( AcquireAwaiter *head ) noexcept -> AcquireAwaiter * {
+        AcquireAwaiter *result{ nullptr };
+        while ( head ) {
+            auto *next = head->next_;
+            head->next_ = result;
+            result = head;
+            head = next;
+        }
+        return result;
+    }
+
+    // - kEmpty => no permits, no waiters.
+    // - odd => ( permits << 1 ) | 1, no waiters.
+    // - otherwise => no permits, head of LIFO list of AcquireAwaiter*.
+    static constexpr uintptr_t kEmpty = 0;
+
+    std::atomic<uintptr_t> state_;
+    const uint64_t maxCount_;
+
+    pstd::Executor *executor_;
+};
+
+}  // namespace poller
@@ -0,0 +1,56 @@
+module;
+
+export module poller:auto_reset_event;
+
+import poller_std;
+
+import :async_semaphore;
+
+namespace poller {
+
+// Auto-reset event for coroutines: set() lets exactly one waiter through
+// and the event resets itself. Setting an already set event is a no-op.
+// Binary semaphore underneath, waiters share its lock-free list.
+export struct AsyncAutoResetEvent final {
+public:
+    // Waiter is resumed on executor if given, otherwise inline by the
+    // thread calling set().
+    explicit AsyncAutoResetEvent( bool initiallySet = false, pstd::Executor *executor = nullptr ) noexcept
+        : semaphore_{ initiallySet ? 1u : 0u, 1, executor } {
+        /* noop */
+    }
+
+    AsyncAutoResetEvent( const AsyncAutoResetEvent & ) = delete;
+    AsyncAutoResetEvent( AsyncAutoResetEvent && ) = delete;
+    auto operator=( const AsyncAutoResetEvent & ) -> AsyncAutoResetEvent & = delete;
+    auto operator=( AsyncAutoResetEvent && ) -> AsyncAutoResetEvent & = delete;
+
+    ~AsyncAutoResetEvent() = default;
+
+    [[nodiscard]]
+    auto isSet() const noexcept -> bool {
+        //
+        return semaphore_.available() != 0;
+    }
+
+    auto set() -> void {
+        //
+        semaphore_.release();
+    }
+
+    // Consumes set state if any, never suspends.
+    auto reset() noexcept -> void {
+        //
+        [[maybe_unused]] const auto consumed = semaphore_.tryAcquire();
+    }
+
+    auto operator co_await() noexcept -> AsyncSemaphore::AcquireAwaiter {
+        //
+        return semaphore_.acquire();
+    }
+
+private:
+    AsyncSemaphore semaphore_;
+};
+
+}  // namespace poller
@@ -0,0 +1,481 @@
+module;
+
+#include <atomic>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <utility>
+
+export module poller:channel;
+
+import poller_std;
+
+import :resume;
+
+namespace poller {
+
+// Bounded multi-producer multi-consumer channel for coroutine pipelines.
+// co_await send() suspends while the channel is full, co_await receive()
+// while it is empty, no thread is ever blocked.
+//
+//   auto parsed = Channel<Document>{ 1024 };
+//
+//   // producer
+//   for ( auto &body : bodies ) {
+//       if ( !co_await parsed.send( parse( body ) ) ) { break; }
+//   }
+//   parsed.close();
+//
+//   // consumer
+//   while ( auto doc = co_await parsed.receive() ) { store( *doc ); }
+//
+// Items go through a lock-free ring, send and receive touch nothing else
+// while the channel is neither full nor empty. Suspended senders and
+// receivers are kept in FIFO lists under a mutex, only taken when
+// somebody has to wait or be woken.
+//
+// A send that returned true is never lost: receivers see the end of the
+// stream only once the channel is closed, no send is half way into the
+// ring and the ring is empty.
+export template <typename T>
+    requires std::movable<T>
+struct Channel final {
+public:
+    // capacity is rounded up to a power of two, at least 2. Suspended
+    // senders and receivers are resumed on executor if given, otherwise
+    // inline by the thread that unblocked them.
+    explicit Channel( size_t capacity, pstd::Executor *executor = nullptr )
+        : ring_{ capacity }
+        , executor_{ executor } {
+        /* noop */
+    }
+
+    Channel( const Channel & ) = delete;
+    Channel( Channel && ) = delete;
+    auto operator=( const Channel & ) -> Channel & = delete;
+    auto operator=( Channel && ) -> Channel & = delete;
+
+    // Must not be destroyed while coroutines are suspended on it.
+    ~Channel() = default;
+
+    struct SendAwaiter {
+        SendAwaiter( Channel &channel, T &&value )
+            : channel_{ channel }
+            , value_{ std::move( value ) } {
+            /* noop */
+        }
+
+        [[nodiscard]]
+        auto await_ready() -> bool {
+            const auto status = channel_.offer( value_ );
+            accepted_ = status == Status::kSent;
+            return status != Status::kFull;
+        }
+
+        auto await_suspend( std::coroutine_handle<> awaitingCoroutine ) -> bool {
+            awaitingCoroutine_ = awaitingCoroutine;
+            return channel_.parkSender( this );
+        }
+
+        // false if the channel was closed, value is dropped then.
+        [[nodiscard]]
+        auto await_resume() const noexcept -> bool {
+            //
+            return accepted_;
+        }
+
+    private:
+        friend struct Channel;
+
+        Channel &channel_;
+        T value_;
+        bool accepted_{ false };
+
+        std::coroutine_handle<> awaitingCoroutine_;
+        SendAwaiter *next_{ nullptr };
+    };
+
+    // Where received items go: a single optional, so T needs no default
+    // constructor, or the front of a caller's span.
+    struct Target {
+        std::optional<T> *slot_{ nullptr };
+        T *out_{ nullptr };
+        size_t capacity_{ 0 };
+    };
+
+    struct ReceiverBase {
+    protected:
+        friend struct Channel;
+
+        explicit ReceiverBase( Channel &channel, Target target = {} ) noexcept
+            : channel_{ channel }
+            , target_{ target } {
+            /* noop */
+        }
+
+        auto ready() -> bool {
+            received_ = channel_.drain( target_ );
+            if ( received_ != 0 ) {
+                return true;
+            }
+            if ( channel_.isFinished() ) {
+                // Last sends may have landed since the drain above.
+                received_ = channel_.drain( target_ );
+                return true;
+            }
+            return false;
+        }
+
+        auto suspend( std::coroutine_handle<> awaitingCoroutine ) -> bool {
+            awaitingCoroutine_ = awaitingCoroutine;
+            return channel_.parkReceiver( this );
+        }
+
+        Channel &channel_;
+        Target target_;
+        size_t received_{ 0 };
+
+        std::coroutine_handle<> awaitingCoroutine_;
+        ReceiverBase *next_{ nullptr };
+    };
+
+    struct ReceiveAwaiter : ReceiverBase {
+        explicit ReceiveAwaiter( Channel &channel ) noexcept
+            : ReceiverBase{ channel } {
+            /* noop */
+        }
+
+        [[nodiscard]]
+        auto await_ready() -> bool {
+            // Awaiter has its final address only now.
+            this->target_.slot_ = &value_;
+            return this->ready();
+        }
+
+        auto await_suspend( std::coroutine_handle<> awaitingCoroutine ) -> bool {
+            //
+            return this->suspend( awaitingCoroutine );
+        }
+
+        // std::nullopt once the channel is closed and drained.
+        [[nodiscard]]
+        auto await_resume() -> std::optional<T> {
+            //
+            return std::move( value_ );
+        }
+
+    private:
+        std::optional<T> value_;
+    };
+
+    struct BatchReceiveAwaiter : ReceiverBase {
+        BatchReceiveAwaiter( Channel &channel, std::span<T> out ) noexcept
+            : ReceiverBase{ channel, Target{ nullptr, out.data(), out.size() } } {
+            /* noop */
+        }
+
+        [[nodiscard]]
+        auto await_ready() -> bool {
+            //
+            return this->target_.capacity_ == 0 || this->ready();
+        }
+
+        auto await_suspend( std::coroutine_handle<> awaitingCoroutine ) -> bool {
+            //
+            return this->suspend( awaitingCoroutine );
+        }
+
+        // Number of items written to the front of `out`, 0 once the
+        // channel is closed and drained.
+        [[nodiscard]]
+        auto await_resume() const noexcept -> size_t {
+            //
+            return this->received_;
+        }
+    };
+
+    // if ( !co_await channel.send( std::move( item ) ) ) { /* closed */ }
+    [[nodiscard]]
+    auto send( T value ) -> SendAwaiter {
+        //
+        return SendAwaiter{ *this, std::move( value ) };
+    }
+
+    // while ( auto item = co_await channel.receive() ) { ... }
+    [[nodiscard]]
+    auto receive() noexcept -> ReceiveAwaiter {
+        //
+        return ReceiveAwaiter{ *this };
+    }
+
+    // Waits for at least one item, then takes as many as are ready up
+    // to out.size() in one go.
+    //
+    //   auto batch = std::array<Row, 64>{};
+    //   while ( auto n = co_await channel.receiveBatch( batch ) ) { insert( std::span{ batch }.first( n ) ); }
+    [[nodiscard]]
+    auto receiveBatch( std::span<T> out ) noexcept -> BatchReceiveAwaiter {
+        //
+        return BatchReceiveAwaiter{ *this, out };
+    }
+
+    // Never suspends. On failure (full or closed) value is left untouched.
+    [[nodiscard]]
+    auto trySend( T &value ) -> bool {
+        //
+        return offer( value ) == Status::kSent;
+    }
+
+    // Never suspends.
+    [[nodiscard]]
+    auto tryReceive() -> std::optional<T> {
+        auto value = std::optional<T>{};
+        drain( Target{ &value } );
+        return value;
+    }
+
+    // Suspended senders resume with false, suspended receivers with no
+    // item. Items already in the channel can still be received. A send
+    // racing with close() either fails or delivers its item before any
+    // receiver sees the end of the stream.
+    auto close() -> void {
+        auto batch = ResumeBatch{ executor_ };
+        auto lock = std::lock_guard{ mutex_ };
+
+        if ( state_.fetch_or( kClosed, std::memory_order_acq_rel ) & kClosed ) {
+            return;
+        }
+
+        service( batch );
+
+        while ( auto *sender = popFront( sendersHead_, sendersTail_ ) ) {
+            sender->accepted_ = false;
+            waiters_.fetch_sub( 1, std::memory_order_relaxed );
+            batch.add( sender->awaitingCoroutine_ );
+        }
+
+        // Otherwise the last send in flight does it, see offer().
+        if ( isFinished() ) {
+            endReceivers( batch );
+        }
+    }
+
+    [[nodiscard]]
+    auto isClosed() const noexcept -> bool {
+        //
+        return ( state_.load( std::memory_order_acquire ) & kClosed ) != 0;
+    }
+
+    [[nodiscard]]
+    auto capacity() const noexcept -> size_t {
+        //
+        return ring_.capacity();
+    }
+
+private:
+    enum class Status : uint8_t { kSent, kFull, kClosed };
+
+    // state_ holds the closed flag and, above it, the number of sends
+    // between their closed check and their push.
+    static constexpr size_t kClosed = 1;
+    static constexpr size_t kSending = 2;
+
+    // A send announces itself before checking the flag, so close() either
+    // stops it or knows an item may still land in the ring.
+    auto offer( T &value ) -> Status {
+        if ( state_.fetch_add( kSending, std::memory_order_acq_rel ) & kClosed ) {
+            endSend();
+            return Status::kClosed;
+        }
+        const auto pushed = ring_.try_push( std::move( value ) );
+        if ( pushed ) {
+            wakeWaiters();
+        }
+        endSend();
+        return pushed ? Status::kSent : Status::kFull;
+    }
+
+    // Last send in flight after close() ends the stream close() had to
+    // leave open.
+    auto endSend() -> void {
+        if ( state_.fetch_sub( kSending, std::memory_order_acq_rel ) != ( kClosed | kSending ) ) {
+            return;
+        }
+        auto batch = ResumeBatch{ executor_ };
+        auto lock = std::lock_guard{ mutex_ };
+        service( batch );
+        endReceivers( batch );
+    }
+
+    // Closed and no send can put an item into the ring any more.
+    [[nodiscard]]
+    auto isFinished() const noexcept -> bool {
+        //
+        return state_.load( std::memory_order_acquire ) == kClosed;
+    }
+
+    // Receivers still suspended after service() found the ring empty, they
+    // resume with no item. Requires mutex_ held and isFinished().
+    auto endReceivers( ResumeBatch &batch ) -> void {
+        while ( auto *receiver = popFront( receiversHead_, receiversTail_ ) ) {
+            receiver->received_ = 0;
+            waiters_.fetch_sub( 1, std::memory_order_relaxed );
+            batch.add( receiver->awaitingCoroutine_ );
+        }
+    }
+
+    auto drain( const Target &target ) -> size_t {
+        const auto count = popInto( target );
+        if ( count != 0 ) {
+            wakeWaiters();
+        }
+        return count;
+    }
+
+    // Called after every successful push or pop. Pairs with the fence in
+    // park*(): either the parking side sees our ring update or we see it
+    // counted in waiters_.
+    auto wakeWaiters() -> void {
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        if ( waiters_.load( std::memory_order_relaxed ) == 0 ) {
+            return;
+        }
+
+        auto batch = ResumeBatch{ executor_ };
+        auto lock = std::lock_guard{ mutex_ };
+        service( batch );
+    }
+
+    auto parkSender( SendAwaiter *sender ) -> bool {
+        auto batch = ResumeBatch{ executor_ };
+        auto lock = std::lock_guard{ mutex_ };
+
+        waiters_.fetch_add( 1, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+
+        if ( isClosed() ) {
+            waiters_.fetch_sub( 1, std::memory_order_relaxed );
+            sender->accepted_ = false;
+            return false;
+        }
+
+        if ( ring_.try_push( std::move( sender->value_ ) ) ) {
+            waiters_.fetch_sub( 1, std::memory_order_relaxed );
+            sender->accepted_ = true;
+            service( batch );
+            return false;
+        }
+
+        pushBack( sendersHead_, sendersTail_, sender );
+        return true;
+    }
+
+    auto parkReceiver( ReceiverBase *receiver ) -> bool {
+        auto batch = ResumeBatch{ executor_ };
+        auto lock = std::lock_guard{ mutex_ };
+
+        waiters_.fetch_add( 1, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+
+        receiver->received_ = popInto( receiver->target_ );
+        if ( receiver->received_ != 0 ) {
+            waiters_.fetch_sub( 1, std::memory_order_relaxed );
+            service( batch );
+            return false;
+        }
+
+        // A send still in flight ends the stream itself once it is done.
+        if ( isFinished() ) {
+            waiters_.fetch_sub( 1, std::memory_order_relaxed );
+            return false;
+        }
+
+        pushBack( receiversHead_, receiversTail_, receiver );
+        return true;
+    }
+
+    // Moves values of suspended senders into the ring and items from the
+    // ring to suspended receivers until neither side can make progress.
+    // Requires mutex_ held.
+    auto service( ResumeBatch &batch ) -> void {
+        auto progress = true;
+        while ( progress ) {
+            progress = false;
+
+            while ( sendersHead_ && ring_.try_push( std::move( sendersHead_->value_ ) ) ) {
+                auto *sender = popFront( sendersHead_, sendersTail_ );
+                sender->accepted_ = true;
+                waiters_.fetch_sub( 1, std::memory_order_relaxed );
+                batch.add( sender->awaitingCoroutine_ );
+                progress = true;
+            }
+
+            while ( receiversHead_ ) {
+                const auto count = popInto( receiversHead_->target_ );
+                if ( count == 0 ) {
+                    break;
+                }
+                auto *receiver = popFront( receiversHead_, receiversTail_ );
+                receiver->received_ = count;
+                waiters_.fetch_sub( 1, std::memory_order_relaxed );
+                batch.add( receiver->awaitingCoroutine_ );
+                progress = true;
+            }
+        }
+    }
+
+    auto popInto( const Target &target ) -> size_t {
+        if ( target.slot_ ) {
+            return ring_.try_pop( *target.slot_ ) ? 1 : 0;
+        }
+        auto count = size_t{ 0 };
+        while ( count < target.capacity_ && ring_.try_pop( target.out_[count] ) ) {
+            ++count;
+        }
+        return count;
+    }
+
+    template <typename Waiter>
+    static auto pushBack( Waiter *&head, Waiter *&tail, Waiter *waiter ) noexcept -> void {
+        waiter->next_ = nullptr;
+        if ( tail ) {
+            tail->next_ = waiter;
+        } else {
+            head = waiter;
+        }
+        tail = waiter;
+    }
+
+    template <typename Waiter>
+    static auto popFront( Waiter *&head, Waiter *&tail ) noexcept -> Waiter * {
+        auto *waiter = head;
+        if ( waiter ) {
+            head = waiter->next_;
+            if ( !head ) {
+                tail = nullptr;
+            }
+        }
+        return waiter;
+    }
+
+    mpmc_lock_free_queue<T> ring_;
+
+    // Number of suspended senders and receivers, lets send and receive
+    // skip the mutex when nobody waits.
+    std::atomic<size_t> waiters_{ 0 };
+    std::atomic<size_t> state_{ 0 };
+
+    std::mutex mutex_;
+    SendAwaiter *sendersHead_{ nullptr };
+    SendAwaiter *sendersTail_{ nullptr };
+    ReceiverBase *receiversHead_{ nullptr };
+    ReceiverBase *receiversTail_{ nullptr };
+
+    pstd::Executor *executor_;
+};
+
+}  // namespace poller
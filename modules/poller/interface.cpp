@@ -9,4 +9,12 @@ export import :handle;
 export import :request;
 export import :write_func;
 export import :debug_func;
-export import :reset_event;
\ No newline at end of file
+export import :reset_event;
+export import :metrics;
+export import :resume;
+export import :async_mutex;
+export import :async_semaphore;
+export import :async_latch;
+export import :auto_reset_event;
+export import :channel;
+export import :task_scope;
\ No newline at end of file
@@ -0,0 +1,529 @@
+module;
+
+#include <atomic>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <curl/curl.h>
+
+export module poller:metrics;
+
+namespace poller {
+
+// Log-linear bucketing (HdrHistogram style). Values below kSubBuckets get
+// their own bucket, every following power of two range is split into
+// kSubBuckets linear sub-buckets, so relative error is under 1 / kSubBuckets.
+// Power of two values are always bucket lower bounds.
+constexpr uint32_t kSubBucketBits = 3;
+constexpr uint32_t kSubBuckets = 1u << kSubBucketBits;
+constexpr uint32_t kMaxExponent = 39;
+constexpr uint32_t kHistogramBuckets = ( kMaxExponent - kSubBucketBits + 1 ) * kSubBuckets + kSubBuckets;
+
+constexpr auto bucketIndex( uint64_t value ) noexcept -> uint32_t {
+    if ( value < kSubBuckets ) {
+        return static_cast<uint32_t>( value );
+    }
+
+    auto exponent = static_cast<uint32_t>( std::bit_width( value ) - 1 );
+    if ( exponent > kMaxExponent ) {
+        // Saturate, everything above ~12 days of microseconds lands in the last bucket.
+        return kHistogramBuckets - 1;
+    }
+
+    const auto sub = static_cast<uint32_t>( value >> ( exponent - kSubBucketBits ) ) & ( kSubBuckets - 1 );
+    return ( exponent - kSubBucketBits + 1 ) * kSubBuckets + sub;
+}
+
+constexpr auto bucketLowerBound( uint32_t index ) noexcept -> uint64_t {
+    if ( index < kSubBuckets ) {
+        return index;
+    }
+
+    const auto exponent = index / kSubBuckets + kSubBucketBits - 1;
+    const auto sub = index % kSubBuckets;
+    return static_cast<uint64_t>( kSubBuckets + sub ) << ( exponent - kSubBucketBits );
+}
+
+static_assert( bucketIndex( bucketLowerBound( 100 ) ) == 100 );
+static_assert( bucketIndex( uint64_t{ 1 } << 20 ) == bucketIndex( ( uint64_t{ 1 } << 20 ) + 1 ) );
+
+// Recorded values are bucketed closed on the upper side: value v goes
+// where v - 1 would, so bucket i holds bucketLowerBound( i ) + 1 up to
+// bucketLowerBound( i + 1 ). Every power of two is then the largest value
+// of its bucket and "at most 2^k" counts are exact, as Prometheus `le`
+// buckets need.
+constexpr auto bucketOf( uint64_t value ) noexcept -> uint32_t {
+    //
+    return bucketIndex( value != 0 ? value - 1 : 0 );
+}
+
+static_assert( bucketOf( uint64_t{ 1 } << 20 ) != bucketOf( ( uint64_t{ 1 } << 20 ) + 1 ) );
+static_assert( bucketOf( uint64_t{ 1 } << 20 ) == bucketOf( ( uint64_t{ 1 } << 20 ) - 1 ) );
+
+// Plain (single threaded) histogram, used for merged snapshots and
+// by benchmarks that want percentiles.
+export struct LatencyHistogram final {
+    auto record( uint64_t value, uint64_t times = 1 ) noexcept -> void {
+        counts_[bucketOf( value )] += times;
+        count_ += times;
+        sum_ += value * times;
+        max_ = std::max( max_, value );
+    }
+
+    auto merge( const LatencyHistogram &other ) noexcept -> void {
+        for ( uint32_t i = 0; i < kHistogramBuckets; ++i ) {
+            counts_[i] += other.counts_[i];
+        }
+        count_ += other.count_;
+        sum_ += other.sum_;
+        max_ = std::max( max_, other.max_ );
+    }
+
+    // Upper bound of the bucket where requested quantile falls, clamped by
+    // observed maximum.
+    [[nodiscard]]
+    auto quantile( double q ) const noexcept -> uint64_t {
+        if ( count_ == 0 ) {
+            return 0;
+        }
+
+        const auto rank = static_cast<uint64_t>( q * static_cast<double>( count_ - 1 ) ) + 1;
+        uint64_t seen{};
+        for ( uint32_t i = 0; i < kHistogramBuckets; ++i ) {
+            seen += counts_[i];
+            if ( seen >= rank ) {
+                const auto upper = i + 1 < kHistogramBuckets ? bucketLowerBound( i + 1 ) : max_;
+                return std::min( upper, max_ );
+            }
+        }
+
+        return max_;
+    }
+
+    // Number of recorded values less than or equal to given bound. Exact
+    // when bound is a power of two.
+    [[nodiscard]]
+    auto countAtMost( uint64_t bound ) const noexcept -> uint64_t {
+        uint64_t result{};
+        for ( uint32_t i = 0; i < kHistogramBuckets && bucketLowerBound( i ) < bound; ++i ) {
+            result += counts_[i];
+        }
+        return result;
+    }
+
+    [[nodiscard]]
+    auto mean() const noexcept -> double {
+        //
+        return count_ ? static_cast<double>( sum_ ) / static_cast<double>( count_ ) : 0.0;
+    }
+
+    [[nodiscard]]
+    auto count() const noexcept -> uint64_t {
+        //
+        return count_;
+    }
+
+    [[nodiscard]]
+    auto sum() const noexcept -> uint64_t {
+        //
+        return sum_;
+    }
+
+    [[nodiscard]]
+    auto max() const noexcept -> uint64_t {
+        //
+        return max_;
+    }
+
+private:
+    friend struct AtomicHistogram;
+
+    std::array<uint64_t, kHistogramBuckets> counts_{};
+    uint64_t count_{};
+    uint64_t sum_{};
+    uint64_t max_{};
+};
+
+// Every shard counter has exactly one writer (the owning thread), so a
+// relaxed load/store pair is enough and avoids a locked RMW on the request
+// path. Readers on other threads only ever see torn-free, slightly stale
+// values.
+inline auto bump( std::atomic<uint64_t> &counter, uint64_t n = 1 ) noexcept -> void {
+    counter.store( counter.load( std::memory_order_relaxed ) + n, std::memory_order_relaxed );
+}
+
+// Single writer histogram, readable from any thread.
+struct AtomicHistogram final {
+    auto record( uint64_t value ) noexcept -> void {
+        bump( counts_[bucketOf( value )] );
+        bump( count_ );
+        bump( sum_, value );
+        if ( value > max_.load( std::memory_order_relaxed ) ) {
+            max_.store( value, std::memory_order_relaxed );
+        }
+    }
+
+    auto mergeInto( LatencyHistogram &out ) const noexcept -> void {
+        for ( uint32_t i = 0; i < kHistogramBuckets; ++i ) {
+            out.counts_[i] += counts_[i].load( std::memory_order_relaxed );
+        }
+        out.count_ += count_.load( std::memory_order_relaxed );
+        out.sum_ += sum_.load( std::memory_order_relaxed );
+        out.max_ = std::max( out.max_, max_.load( std::memory_order_relaxed ) );
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, kHistogramBuckets> counts_{};
+    std::atomic<uint64_t> count_{};
+    std::atomic<uint64_t> sum_{};
+    std::atomic<uint64_t> max_{};
+};
+
+// 1xx..5xx plus everything else (no HTTP status, e.g. non-HTTP protocols).
+constexpr size_t kStatusClasses = 6;
+constexpr size_t kCurlCodes = static_cast<size_t>( CURL_LAST );
+
+constexpr auto statusClass( long status ) noexcept -> size_t {
+    //
+    return ( status >= 100 && status < 600 ) ? static_cast<size_t>( status / 100 ) - 1 : kStatusClasses - 1;
+}
+
+struct HostCounters final {
+    std::atomic<uint64_t> submitted{};
+    std::array<std::atomic<uint64_t>, kStatusClasses> completed{};
+    std::array<std::atomic<uint64_t>, kCurlCodes> failed{};
+    std::atomic<uint64_t> bytesReceived{};
+    std::atomic<uint64_t> bytesSent{};
+    AtomicHistogram latency{};
+};
+
+// Merged view of all shards for one host.
+export struct HostMetrics final {
+    std::string host;
+    uint64_t submitted{};
+    uint64_t inFlight{};
+    std::array<uint64_t, kStatusClasses> completed{};
+    std::array<uint64_t, kCurlCodes> failed{};
+    uint64_t bytesReceived{};
+    uint64_t bytesSent{};
+    // Microseconds.
+    LatencyHistogram latency{};
+};
+
+// Lock-free metrics registry. Every thread that records into the registry
+// gets its own shard, shards are merged only when somebody reads them,
+// so the request path never contends on a shared cache line.
+export struct Metrics final {
+public:
+    // Maximum number of distinct hosts, the rest is accounted as "other".
+    static constexpr uint32_t kMaxHosts = 128;
+    static constexpr uint32_t kOtherHost = kMaxHosts;
+
+    Metrics() = default;
+
+    Metrics( const Metrics &other ) = delete;
+    Metrics( Metrics &&other ) = delete;
+    auto operator=( const Metrics &other ) -> Metrics & = delete;
+    auto operator=( Metrics &&other ) -> Metrics & = delete;
+
+    ~Metrics() {
+        auto *shard = shards_.load( std::memory_order_acquire );
+        while ( shard ) {
+            auto *next = shard->next;
+            for ( auto &host : shard->hosts ) {
+                delete host.load( std::memory_order_relaxed );
+            }
+            delete shard;
+            shard = next;
+        }
+
+        for ( auto &label : labels_ ) {
+            delete label.load( std::memory_order_relaxed );
+        }
+    }
+
+    // Interns host name and returns its label id. First sight of the host
+    // allocates, subsequent lookups are a hash and a string compare.
+    auto hostId( std::string_view host ) -> uint32_t {
+        const auto hash = std::hash<std::string_view>{}( host );
+
+        for ( uint32_t probe = 0; probe < kMaxHosts; ++probe ) {
+            const auto index = static_cast<uint32_t>( hash + probe ) & ( kMaxHosts - 1 );
+            auto *label = labels_[index].load( std::memory_order_acquire );
+
+            if ( !label ) {
+                auto *fresh = new HostLabel{ hash, std::string{ host } };
+                if ( labels_[index].compare_exchange_strong(
+                       label, fresh, std::memory_order_acq_rel, std::memory_order_acquire ) ) {
+                    return index;
+                }
+                // Lost the race, inspect the winner.
+                delete fresh;
+            }
+
+            if ( label->hash == hash && label->name == host ) {
+                return index;
+            }
+        }
+
+        return kOtherHost;
+    }
+
+    auto onSubmit( uint32_t host ) -> void {
+        //
+        bump( counters( host ).submitted );
+    }
+
+    // Record finished transfer. Latency in microseconds.
+    auto onComplete( uint32_t host, CURLcode result, long status, uint64_t latency, uint64_t bytesReceived,
+                     uint64_t bytesSent ) -> void {
+        auto &c = counters( host );
+
+        if ( result == CURLE_OK ) {
+            bump( c.completed[statusClass( status )] );
+        } else {
+            bump( c.failed[static_cast<size_t>( result ) < kCurlCodes ? static_cast<size_t>( result ) : 0] );
+        }
+
+        bump( c.bytesReceived, bytesReceived );
+        bump( c.bytesSent, bytesSent );
+        c.latency.record( latency );
+    }
+
+    // Merge all shards, one entry per host that has seen any traffic.
+    [[nodiscard]]
+    auto snapshot() const -> std::vector<HostMetrics> {
+        auto result = std::vector<HostMetrics>{};
+        auto index = std::array<int, kMaxHosts + 1>{};
+        index.fill( -1 );
+
+        for ( auto *shard = shards_.load( std::memory_order_acquire ); shard; shard = shard->next ) {
+            for ( uint32_t host = 0; host <= kMaxHosts; ++host ) {
+                const auto *c = shard->hosts[host].load( std::memory_order_acquire );
+                if ( !c ) {
+                    continue;
+                }
+
+                if ( index[host] < 0 ) {
+                    index[host] = static_cast<int>( result.size() );
+                    result.emplace_back().host = hostName( host );
+                }
+
+                auto &m = result[index[host]];
+                m.submitted += c->submitted.load( std::memory_order_relaxed );
+                for ( size_t i = 0; i < kStatusClasses; ++i ) {
+                    m.completed[i] += c->completed[i].load( std::memory_order_relaxed );
+                }
+                for ( size_t i = 0; i < kCurlCodes; ++i ) {
+                    m.failed[i] += c->failed[i].load( std::memory_order_relaxed );
+                }
+                m.bytesReceived += c->bytesReceived.load( std::memory_order_relaxed );
+                m.bytesSent += c->bytesSent.load( std::memory_order_relaxed );
+                c->latency.mergeInto( m.latency );
+            }
+        }
+
+        for ( auto &m : result ) {
+            // Shards are read at slightly different moments, never report
+            // negative in-flight value.
+            const auto finished = m.latency.count();
+            m.inFlight = m.submitted > finished ? m.submitted - finished : 0;
+        }
+
+        return result;
+    }
+
+    // Prometheus text exposition format (version 0.0.4).
+    [[nodiscard]]
+    auto prometheus() const -> std::string {
+        auto hosts = snapshot();
+        for ( auto &m : hosts ) {
+            m.host = escapeLabel( m.host );
+        }
+        auto out = std::string{};
+        auto it = std::back_inserter( out );
+
+        const auto header = [&it]( std::string_view name, std::string_view type, std::string_view help ) -> void {
+            std::format_to( it, "# HELP {} {}\n# TYPE {} {}\n", name, help, name, type );
+        };
+
+        header( "poller_requests_submitted_total", "counter", "Requests handed to curl." );
+        for ( const auto &m : hosts ) {
+            std::format_to( it, "poller_requests_submitted_total{{host=\"{}\"}} {}\n", m.host, m.submitted );
+        }
+
+        header( "poller_requests_in_flight", "gauge", "Requests submitted but not finished yet." );
+        for ( const auto &m : hosts ) {
+            std::format_to( it, "poller_requests_in_flight{{host=\"{}\"}} {}\n", m.host, m.inFlight );
+        }
+
+        header( "poller_requests_completed_total", "counter", "Finished transfers by HTTP status class." );
+        for ( const auto &m : hosts ) {
+            for ( size_t i = 0; i < kStatusClasses; ++i ) {
+                if ( m.completed[i] ) {
+                    std::format_to(
+                      it, "poller_requests_completed_total{{host=\"{}\",class=\"{}\"}} {}\n", m.host,
+                      i + 1 < kStatusClasses ? std::format( "{}xx", i + 1 ) : std::string{ "other" }, m.completed[i] );
+                }
+            }
+        }
+
+        header( "poller_requests_failed_total", "counter", "Failed transfers by CURLcode." );
+        for ( const auto &m : hosts ) {
+            for ( size_t i = 0; i < kCurlCodes; ++i ) {
+                if ( m.failed[i] ) {
+                    std::format_to(
+                      it, "poller_requests_failed_total{{host=\"{}\",code=\"{}\",error=\"{}\"}} {}\n", m.host, i,
+                      escapeLabel( curl_easy_strerror( static_cast<CURLcode>( i ) ) ), m.failed[i] );
+                }
+            }
+        }
+
+        header( "poller_received_bytes_total", "counter", "Response body bytes." );
+        for ( const auto &m : hosts ) {
+            std::format_to( it, "poller_received_bytes_total{{host=\"{}\"}} {}\n", m.host, m.bytesReceived );
+        }
+
+        header( "poller_sent_bytes_total", "counter", "Request body bytes." );
+        for ( const auto &m : hosts ) {
+            std::format_to( it, "poller_sent_bytes_total{{host=\"{}\"}} {}\n", m.host, m.bytesSent );
+        }
+
+        // Export power of two bucket bounds only: 64us .. ~67s. They are
+        // exact bucket boundaries of the log-linear histogram, so cumulative
+        // counts are exact too.
+        header( "poller_request_duration_seconds", "histogram", "Time from submit to completion." );
+        for ( const auto &m : hosts ) {
+            for ( uint32_t exp = 6; exp <= 26; ++exp ) {
+                const auto bound = uint64_t{ 1 } << exp;
+                std::format_to(
+                  it, "poller_request_duration_seconds_bucket{{host=\"{}\",le=\"{}\"}} {}\n", m.host,
+                  static_cast<double>( bound ) / 1e6, m.latency.countAtMost( bound ) );
+            }
+            std::format_to(
+              it, "poller_request_duration_seconds_bucket{{host=\"{}\",le=\"+Inf\"}} {}\n", m.host,
+              m.latency.count() );
+            std::format_to(
+              it, "poller_request_duration_seconds_sum{{host=\"{}\"}} {}\n", m.host,
+              static_cast<double>( m.latency.sum() ) / 1e6 );
+            std::format_to(
+              it, "poller_request_duration_seconds_count{{host=\"{}\"}} {}\n", m.host, m.latency.count() );
+        }
+
+        return out;
+    }
+
+private:
+    // Label values are quoted, backslash, quote and newline get escaped.
+    static auto escapeLabel( std::string_view value ) -> std::string {
+        auto result = std::string{};
+        result.reserve( value.size() );
+        for ( const auto c : value ) {
+            switch ( c ) {
+                case '\\': {
+                    result += "\\\\";
+                    break;
+                }
+                case '"': {
+                    result += "\\\"";
+                    break;
+                }
+                case '\n': {
+                    result += "\\n";
+                    break;
+                }
+                default: {
+                    result += c;
+                }
+            }
+        }
+        return result;
+    }
+
+    struct HostLabel final {
+        size_t hash;
+        std::string name;
+    };
+
+    struct Shard final {
+        std::thread::id owner;
+        Shard *next{ nullptr };
+        std::array<std::atomic<HostCounters *>, kMaxHosts + 1> hosts{};
+    };
+
+    [[nodiscard]]
+    auto hostName( uint32_t host ) const -> std::string {
+        if ( host == kOtherHost ) {
+            return "other";
+        }
+
+        const auto *label = labels_[host].load( std::memory_order_acquire );
+        return label ? label->name : std::string{};
+    }
+
+    // Calling thread shard. One entry thread local cache keeps the common
+    // case (one registry per process) at a single compare.
+    auto local() -> Shard & {
+        struct Cache {
+            uint64_t registry{};
+            Shard *shard{};
+        };
+        static thread_local Cache cache{};
+
+        if ( cache.registry == id_ ) {
+            return *cache.shard;
+        }
+
+        const auto self = std::this_thread::get_id();
+        auto *shard = shards_.load( std::memory_order_acquire );
+        while ( shard && shard->owner != self ) {
+            shard = shard->next;
+        }
+
+        if ( !shard ) {
+            shard = new Shard{};
+            shard->owner = self;
+            shard->next = shards_.load( std::memory_order_relaxed );
+            while ( !shards_.compare_exchange_weak(
+              shard->next, shard, std::memory_order_release, std::memory_order_relaxed ) ) {
+            }
+        }
+
+        cache = { id_, shard };
+        return *shard;
+    }
+
+    auto counters( uint32_t host ) -> HostCounters & {
+        auto &slot = local().hosts[host];
+        auto *c = slot.load( std::memory_order_relaxed );
+        if ( !c ) {
+            // Only the owner thread ever stores into its shard.
+            c = new HostCounters{};
+            slot.store( c, std::memory_order_release );
+        }
+        return *c;
+    }
+
+    static auto nextId() noexcept -> uint64_t {
+        static std::atomic<uint64_t> counter{ 0 };
+        return counter.fetch_add( 1, std::memory_order_relaxed ) + 1;
+    }
+
+private:
+    // Unique per registry instance, never reused, so stale thread local
+    // caches can't point into a destroyed registry with the same address.
+    const uint64_t id_{ nextId() };
+
+    std::array<std::atomic<HostLabel *>, kMaxHosts> labels_{};
+    std::atomic<Shard *> shards_{ nullptr };
+};
+
+}  // namespace poller
@@ -2,7 +2,13 @@
 module;
 
 #include <string>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
 #include <functional>
+#include <memory>
+
+#include <curl/curl.h>
 
 export module poller:payload;
 
@@ -12,10 +18,30 @@ namespace poller {
 
 export using CallbackFn = std::function<void( Result result )>;
 
+struct SlistDeleter {
+    auto operator()( curl_slist *list ) const noexcept -> void {
+        //
+        curl_slist_free_all( list );
+    }
+};
+
+export using SlistPtr = std::unique_ptr<curl_slist, SlistDeleter>;
+
 export struct Payload {
     CallbackFn callback;
     std::string data;
     std::string headers;
+
+    // Metrics host label and submit time.
+    uint32_t host{};
+    std::chrono::steady_clock::time_point started{};
+
+    // Coroutine waiting for this transfer, resumed by Poller executor
+    // after callback has stored the result.
+    std::coroutine_handle<> coro{};
+
+    // CURLOPT_HTTPHEADER list, curl reads it until the transfer is done.
+    SlistPtr headerList{};
 };
 
 }  // namespace poller
\ No newline at end of file
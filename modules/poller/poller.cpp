@@ -2,9 +2,12 @@ module;
 
 #include <string>
 #include <print>
+#include <chrono>
 #include <coroutine>
 #include <memory>
+#include <mutex>
 #include <type_traits>
+#include <vector>
 
 #include <curl/curl.h>
 
@@ -18,6 +21,7 @@ import :write_func;
 import :task;
 import :payload;
 import :result;
+import :metrics;
 
 namespace poller {
 
@@ -26,10 +30,14 @@ export template <typename T, typename U>
 struct RequestAwaitable;
 
 #define POLLER_USERAGNET_STRING "poller/0.1"
+#define LONELEY_THREAD 1
 
 export struct Poller {
 public:
-    Poller() {
+    // Curl worker thread is pinned to the first CPU of `placement`, keep it
+    // apart from compute pools with pstd::isolateIo().
+    explicit Poller( const pstd::Placement &placement = {} )
+        : worker_{ LONELEY_THREAD, placement } {
         // Curl global init.
         {
             const auto res = curl_global_init( CURL_GLOBAL_DEFAULT );
@@ -46,6 +54,12 @@ public:
         }
     }
 
+    // Request coroutines continue on executor instead of curl thread.
+    explicit Poller( pstd::Executor &executor, const pstd::Placement &placement = {} )
+        : Poller( placement ) {
+        executor_ = &executor;
+    }
+
     Poller( const Poller &other ) = delete;
     Poller( Poller &&other ) = delete;
     auto operator=( const Poller &other ) -> Poller & = delete;
@@ -59,27 +73,44 @@ public:
         curl_global_cleanup();
     }
 
-    template <TaskParameter T>
+    template <typename T>
     auto requestAsync( const HttpRequest &request ) -> RequestAwaitable<HttpRequest, Task<T>> = delete;
 
-    template <TaskParameter T>
+    template <typename T>
     auto requestAsyncBlocking( const HttpRequest &request ) -> RequestAwaitable<HttpRequest, BlockingTask<T>> = delete;
 
-    template <TaskParameter T>
+    template <typename T>
     auto requestAsync( HttpRequest &&request ) -> RequestAwaitable<HttpRequest, Task<T>>;
 
-    template <TaskParameter T>
+    template <typename T>
     auto requestAsyncBlocking( HttpRequest &&request ) -> RequestAwaitable<HttpRequest, BlockingTask<T>>;
 
     virtual auto run() -> void = 0;
 
+    [[nodiscard]]
+    auto metrics() const -> const Metrics & {
+        //
+        return metrics_;
+    }
+
+    // Current metrics in Prometheus text exposition format.
+    [[nodiscard]]
+    auto dumpMetrics() const -> std::string {
+        //
+        return metrics_.prometheus();
+    }
+
 private:
     auto submit() -> void {
         worker_.submit( [this]() -> void {
             int msgsLeft{ 0 };
             int stillRunning{ 0 };
+            auto ready = std::vector<std::coroutine_handle<>>{};
 
             do {
+                // Attach handles queued by performRequest().
+                attachPending();
+
                 // Curl perform.
                 {
                     const auto res = curl_multi_perform( multiHandle_, &stillRunning );
@@ -104,6 +135,9 @@ private:
                     }
                 }
 
+                // Coroutines of transfers finished in this round.
+                ready.clear();
+
                 CURLMsg *msg{};
                 do {
                     msg = curl_multi_info_read( multiHandle_, &msgsLeft );
@@ -131,28 +165,68 @@ private:
                             rpPtr.reset( reinterpret_cast<Payload *>( privatePtr ) );
                         }
 
+                        // Account transfer before user callback, it may take a while.
+                        {
+                            curl_off_t received{};
+                            curl_off_t sent{};
+                            curl_easy_getinfo( handle, CURLINFO_SIZE_DOWNLOAD_T, &received );
+                            curl_easy_getinfo( handle, CURLINFO_SIZE_UPLOAD_T, &sent );
+
+                            const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - rpPtr->started );
+
+                            metrics_.onComplete(
+                              rpPtr->host, msg->data.result, code, static_cast<uint64_t>( latency.count() ),
+                              static_cast<uint64_t>( received ), static_cast<uint64_t>( sent ) );
+                        }
+
                         rpPtr->callback( { code, std::move( rpPtr->data ), std::move( rpPtr->headers ) } );
+                        if ( rpPtr->coro ) {
+                            ready.push_back( rpPtr->coro );
+                        }
 
                         curl_multi_remove_handle( multiHandle_, handle );
                         curl_easy_cleanup( handle );
                     }
                 } while ( msg );
+
+                if ( !ready.empty() ) {
+                    executor_->execute( ready );
+                }
             } while ( stillRunning );
         } );
     }
 
+    // Multi handle must only be used from the worker thread, so handles
+    // coming from other threads are queued and attached here.
+    auto attachPending() -> void {
+        auto handles = std::vector<CURL *>{};
+        {
+            std::lock_guard _{ pendingLock_ };
+            handles.swap( pending_ );
+        }
+
+        for ( auto *handle : handles ) {
+            curl_multi_add_handle( multiHandle_, handle );
+        }
+    }
+
     // Wait until all submitted tasks finish.
     auto wait() const -> void {
         //
         worker_.wait();
     }
 
-    auto performRequest( const HttpRequest &request, CallbackFn cb ) -> void = delete;
+    auto performRequest( const HttpRequest &request, CallbackFn cb, std::coroutine_handle<> coro = {} )
+      -> void = delete;
 
-    auto performRequest( HttpRequest &&request, CallbackFn cb ) -> void {
+    auto performRequest( HttpRequest &&request, CallbackFn cb, std::coroutine_handle<> coro = {} ) -> void {
         if ( request.isValid() ) {
+            const auto host = metrics_.hostId( urlHost( request.url() ) );
+
             // Allocate Requset data. Delete after curl perform actions.
-            auto rp = new Payload{ std::move( cb ), {}, {} };
+            auto rp = new Payload{
+              std::move( cb ), {}, {}, host, std::chrono::steady_clock::now(), coro, SlistPtr{ request.releaseHeaders() } };
 
             // It is used to set the User-Agent: header field in the
             // HTTP request sent to the remote server.
@@ -186,19 +260,16 @@ private:
             //
             // request.handle().setopt<CURLOPT_HEADER>( 1l );
 
-            // Is this thrad safe to add easy handle to multi
-            // when multi handle performing loop cuntinues???
-            //
-            // "You can add more easy handles to a multi handle at any
-            // point, even if other transfers are already running"
-            //
-            // Daniel Stenberg (narkive.com):
-            // "It is thread-safe, but you can only use the single multi handle in one thread
-            // at a time, not simultanouesly."
-            curl_multi_add_handle( multiHandle_, request );
+            metrics_.onSubmit( host );
 
-            // Clean request allocated data (headers slist pointer etc.)
-            request.clean();
+            // "It is thread-safe, but you can only use the single multi handle in one thread
+            // at a time, not simultanouesly." (Daniel Stenberg). Hand the easy
+            // handle to the worker thread and break it out of curl_multi_poll().
+            {
+                std::lock_guard _{ pendingLock_ };
+                pending_.push_back( request );
+            }
+            curl_multi_wakeup( multiHandle_ );
 
             // Submit new job to working thread queue.
             submit();
@@ -208,13 +279,23 @@ private:
     }
 
 private:
-#define LONELEY_THREAD 1
     // curl multi worker thread.
-    pstd::ThreadPool worker_{ LONELEY_THREAD };
+    pstd::ThreadPool worker_;
 
     // Main curl handle
     CURLM *multiHandle_;
 
+    // Where request coroutines are resumed, curl thread by default.
+    pstd::InlineExecutor inlineExecutor_;
+    pstd::Executor *executor_{ &inlineExecutor_ };
+
+    // Easy handles waiting to be attached by the worker thread.
+    std::vector<CURL *> pending_;
+    std::mutex pendingLock_;
+
+    // Request counters and latency histograms.
+    Metrics metrics_;
+
     template <typename T, typename U>
         requires std::is_base_of_v<T, poller::HttpRequest>
     friend struct RequestAwaitable;
@@ -236,11 +317,10 @@ struct RequestAwaitable final {
         return false;
     }
 
-    auto await_suspend( std::coroutine_handle<typename task_type::promise_type> handle ) noexcept -> void {
-        client_.performRequest( std::move( request_ ), [handle, this]( Result res ) -> void {
-            result_ = std::move( res );
-            handle.resume();
-        } );
+    auto await_suspend( std::coroutine_handle<> handle ) noexcept -> void {
+        // Poller resumes handle on its executor once result is stored.
+        client_.performRequest(
+          std::move( request_ ), [this]( Result res ) -> void { result_ = std::move( res ); }, handle );
     }
 
     [[nodiscard]]
@@ -255,13 +335,13 @@ private:
     Result result_;
 };
 
-template <TaskParameter T>
+template <typename T>
 auto Poller::requestAsync( HttpRequest &&request ) -> RequestAwaitable<HttpRequest, Task<T>> {
     //
     return { *this, std::move( request ) };
 }
 
-template <TaskParameter T>
+template <typename T>
 auto Poller::requestAsyncBlocking( HttpRequest &&request ) -> RequestAwaitable<HttpRequest, BlockingTask<T>> {
     //
     return { *this, std::move( request ) };
@@ -1,9 +1,11 @@
 module;
 
 #include <string>
+#include <string_view>
 #include <numeric>
 #include <span>
 #include <format>
+#include <utility>
 
 #include <curl/curl.h>
 
@@ -40,6 +42,28 @@ auto formattedFields(
     return result;
 }
 
+// Authority part of url without userinfo and port, e.g.
+// "https://user@example.com:8080/path" -> "example.com".
+auto urlHost( std::string_view url ) -> std::string_view {
+    if ( const auto scheme = url.find( "://" ); scheme != std::string_view::npos ) {
+        url.remove_prefix( scheme + 3 );
+    }
+
+    url = url.substr( 0, url.find_first_of( "/?#" ) );
+
+    if ( const auto at = url.rfind( '@' ); at != std::string_view::npos ) {
+        url.remove_prefix( at + 1 );
+    }
+
+    if ( url.starts_with( '[' ) ) {
+        // IPv6 literal, whole authority if the bracket is never closed.
+        const auto close = url.find( ']' );
+        return close == std::string_view::npos ? url : url.substr( 0, close + 1 );
+    }
+
+    return url.substr( 0, url.find( ':' ) );
+}
+
 export struct HttpRequest {
     HttpRequest() = default;
 
@@ -49,6 +73,7 @@ export struct HttpRequest {
     HttpRequest( HttpRequest&& other ) noexcept {
         this->handle_ = std::move( other.handle_ );
         this->headers_ = other.headers_;
+        this->url_ = std::move( other.url_ );
         other.headers_ = nullptr;
     }
 
@@ -56,6 +81,7 @@ export struct HttpRequest {
         if ( this != &other ) {
             this->handle_ = std::move( other.handle_ );
             this->headers_ = other.headers_;
+            this->url_ = std::move( other.url_ );
             other.headers_ = nullptr;
         }
         return *this;
@@ -65,9 +91,15 @@ export struct HttpRequest {
 
     auto setUrl( const std::string& value ) -> HttpRequest& {
         handle_.setopt<CURLOPT_URL>( value );
+        url_ = value;
         return ( *this );
     }
 
+    auto url() const -> const std::string& {
+        //
+        return url_;
+    }
+
     auto setHeader( const std::string& name, const std::string& value )
         -> HttpRequest& {
         const auto headerString = std::format( "{}: {}", name, value );
@@ -132,13 +164,22 @@ export struct HttpRequest {
     }
 
     auto clean() -> void {
-        //
         curl_slist_free_all( headers_ );
+        headers_ = nullptr;
+    }
+
+    // Hands the header list over to the caller, who keeps it alive for
+    // as long as curl may use the handle.
+    [[nodiscard]]
+    auto releaseHeaders() -> curl_slist* {
+        //
+        return std::exchange( headers_, nullptr );
     }
 
 protected:
     Handle handle_;
     curl_slist* headers_{ nullptr };
+    std::string url_;
 };
 
 export struct HttpRequestGet final : HttpRequest {
@@ -5,6 +5,10 @@ module;
 
 export module poller:reset_event;
 
+import poller_std;
+
+import :resume;
+
 namespace poller {
 
 // Based on Lewis Baker cppcoro async_manual_reset_event example.
@@ -18,8 +22,11 @@ namespace poller {
 // https://github.com/lewissbaker/cppcoro
 export struct ResetEvent final {
 public:
-    explicit ResetEvent( bool initiallySet = false ) noexcept
-        : m_state( initiallySet ? this : nullptr ) {
+    // Waiters are resumed on executor if given, otherwise inline by
+    // the thread calling set().
+    explicit ResetEvent( bool initiallySet = false, pstd::Executor* executor = nullptr ) noexcept
+        : m_state( initiallySet ? this : nullptr )
+        , executor_( executor ) {
         /* noop*/
     }
 
@@ -102,12 +109,17 @@ public:
             // Wasn't already in 'set' state.
             // Treat old value as head of a linked-list of waiters
             // which we have now acquired and need to resume.
+            //
+            // Waiters are resumed as a batch after the list is walked, inline
+            // resumption nested in another set() is deferred to the outermost
+            // one instead of recursing.
+            auto batch = ResumeBatch{ executor_ };
             auto* waiters = static_cast<Awaiter*>( oldValue );
             while ( waiters != nullptr ) {
                 // Read m_next before resuming the coroutine as resuming
                 // the coroutine will likely destroy the awaiter object.
                 auto* next = waiters->next_;
-                waiters->awaitingCoroutine_.resume();
+                batch.add( waiters->awaitingCoroutine_ );
                 waiters = next;
             }
         }
@@ -125,6 +137,8 @@ private:
     // - 'this' => set state
     // - otherwise => not set, head of linked list of awaiter*.
     mutable std::atomic<void*> m_state;
+
+    pstd::Executor* executor_;
 };
 
 }  // namespace poller
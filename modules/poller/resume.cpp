@@ -0,0 +1,82 @@
+module;
+
+#include <coroutine>
+#include <cstddef>
+#include <span>
+#include <utility>
+#include <vector>
+
+export module poller:resume;
+
+import poller_std;
+
+namespace poller {
+
+// Handles collected by synchronization primitives, thread-local so
+// collecting waiters never allocates in steady state.
+thread_local std::vector<std::coroutine_handle<>> batchHandles_{};
+
+// Inline resumptions of this thread. Waking a waiter that signals another
+// primitive only appends here, the outermost ResumeBatch drains the queue,
+// so long wake chains run as a loop instead of nested resume() calls.
+thread_local std::vector<std::coroutine_handle<>> deferredHandles_{};
+thread_local bool draining_{ false };
+
+// Collects waiters released by a primitive and resumes them when the
+// batch goes out of scope, on executor when given, inline otherwise.
+// Primitives must not touch their own state after the batch is flushed.
+struct ResumeBatch final {
+    explicit ResumeBatch( pstd::Executor *executor ) noexcept
+        : executor_{ executor }
+        , first_{ executor ? batchHandles_.size() : 0 } {}
+
+    ResumeBatch( const ResumeBatch & ) = delete;
+    ResumeBatch( ResumeBatch && ) = delete;
+    auto operator=( const ResumeBatch & ) -> ResumeBatch & = delete;
+    auto operator=( ResumeBatch && ) -> ResumeBatch & = delete;
+
+    ~ResumeBatch() {
+        //
+        flush();
+    }
+
+    auto add( std::coroutine_handle<> handle ) -> void {
+        if ( executor_ ) {
+            batchHandles_.push_back( handle );
+        } else {
+            deferredHandles_.push_back( handle );
+        }
+    }
+
+private:
+    auto flush() -> void {
+        if ( executor_ ) {
+            if ( batchHandles_.size() != first_ ) {
+                // Executor may resume inline and start nested batches, keep
+                // them off the buffer we are reading from.
+                auto handles = std::exchange( batchHandles_, {} );
+                executor_->execute( std::span{ handles }.subspan( first_ ) );
+                handles.resize( first_ );
+                batchHandles_ = std::move( handles );
+            }
+            return;
+        }
+
+        if ( draining_ ) {
+            return;
+        }
+
+        draining_ = true;
+        // Queue may grow while we iterate.
+        for ( size_t i = 0; i < deferredHandles_.size(); ++i ) {
+            deferredHandles_[i].resume();
+        }
+        deferredHandles_.clear();
+        draining_ = false;
+    }
+
+    pstd::Executor *executor_;
+    size_t first_;
+};
+
+}  // namespace poller
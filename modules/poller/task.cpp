@@ -1,96 +1,227 @@
 
 module;
 
+#include <atomic>
 #include <coroutine>
+#include <cstdint>
 #include <exception>
 #include <type_traits>
 #include <concepts>
 #include <functional>
-#include <mutex>
+#include <optional>
 #include <print>
 #include <chrono>
-#include <thread>
 
 export module poller:task;
 
+import poller_std;
+
 import :result;
 
 using namespace std::chrono_literals;
 
 namespace poller {
 
-export template <typename T>
-concept TaskParameter =
-  std::is_same_v<T, void> || std::is_same_v<T, std::string> || std::is_same_v<T, std::pair<int, std::string>>;
+// Ownership handshake between Task object, awaiting coroutine and the
+// coroutine itself. Whoever comes second is responsible for the frame:
+// final_suspend resumes awaiting coroutine or destroys detached frame,
+// Task destroys already completed frame. A suspended awaiter still reads
+// the result from the frame, so if the Task is dropped under it
+// (kAwaitedDetached) the awaiter destroys the frame once it has resumed.
+enum class TaskState : uint8_t {
+    kRunning,
+    kAwaited,
+    kDetached,
+    kAwaitedDetached,
+    kCompleted,
+};
 
-export template <TaskParameter T>
-struct Task {
-    using value_type = T;
+// Frames come from pooled allocator, one coroutine per request adds up.
+template <typename PromiseType>
+struct TaskPromiseBase : pstd::PooledFrame {
+public:
+    struct FinalAwaiter final {
+        [[nodiscard]]
+        auto await_ready() const noexcept -> bool {
+            //
+            return false;
+        }
 
-    struct promise_type;
-    using handle_type = std::coroutine_handle<promise_type>;
+        // Symmetric transfer, awaiting coroutine is resumed as a tail call
+        // so long co_await chains don't grow the stack.
+        auto await_suspend( std::coroutine_handle<PromiseType> handle ) const noexcept -> std::coroutine_handle<> {
+            auto &promise = handle.promise();
+
+            // An awaited state is left for the awaiter to settle when it
+            // resumes, see TaskAwaiter::settle().
+            auto current = promise.state_.load( std::memory_order_acquire );
+            while ( current == TaskState::kRunning
+                    && !promise.state_.compare_exchange_weak(
+                      current, TaskState::kCompleted, std::memory_order_acq_rel, std::memory_order_acquire ) ) {
+            }
 
-    struct promise_type {
-    public:
-        struct ThenableAwaiter final {
-            // Indicating that an await expression always suspends.
-            [[nodiscard]]
-            auto await_ready() const noexcept -> bool {
-                //
+            switch ( current ) {
+                case TaskState::kAwaited:
+                case TaskState::kAwaitedDetached: {
+                    return promise.continuation_;
+                }
+                case TaskState::kDetached: {
+                    promise.onDetached();
+                    handle.destroy();
+                    return std::noop_coroutine();
+                }
+                default: {
+                    // Owner still holds the Task, result stays in the frame.
+                    return std::noop_coroutine();
+                }
+            }
+        }
+
+        auto await_resume() const noexcept -> void {
+            //
+        }
+    };
+
+    auto initial_suspend() noexcept -> std::suspend_never {
+        //
+        return {};
+    }
+
+    auto final_suspend() noexcept -> FinalAwaiter {
+        //
+        return {};
+    }
+
+    auto unhandled_exception() -> void {
+        //
+        exception_ = std::current_exception();
+    }
+
+    // Task gives up the frame. Returns true if the coroutine already
+    // completed and the caller has to destroy the frame, otherwise
+    // final_suspend or the suspended awaiter does it.
+    auto detachOwner() noexcept -> bool {
+        auto current = state_.load( std::memory_order_acquire );
+        while ( current != TaskState::kCompleted ) {
+            const auto next = current == TaskState::kAwaited ? TaskState::kAwaitedDetached : TaskState::kDetached;
+            if ( state_.compare_exchange_weak( current, next, std::memory_order_acq_rel, std::memory_order_acquire ) ) {
                 return false;
             }
+        }
+        return true;
+    }
 
-            auto await_suspend( handle_type handle ) const noexcept -> bool {
-                // If returns true then the coroutine is SUSPENDED, and control
-                // flow returns to the caller of the coroutine.
-                //
-                // If returns false then the coroutine is NOT SUSPENDED after
-                // all, and execution immediately resumes within the same coroutine.
-                return !handle.promise().needToSuspend_;
-            };
+public:
+    std::atomic<TaskState> state_{ TaskState::kRunning };
+    std::coroutine_handle<> continuation_{ nullptr };
 
-            auto await_resume() const noexcept -> void {
-                //
-            };
-        };
+    std::exception_ptr exception_{ nullptr };
+};
+
+// Awaiting another Task suspends the caller until the task reaches
+// final_suspend, no allocation involved: continuation handle is stored
+// in the awaited promise.
+template <typename PromiseType>
+struct TaskAwaiter {
+    using handle_type = std::coroutine_handle<PromiseType>;
 
+    [[nodiscard]]
+    auto await_ready() const noexcept -> bool {
+        //
+        return handle_.promise().state_.load( std::memory_order_acquire ) == TaskState::kCompleted;
+    }
+
+    auto await_suspend( std::coroutine_handle<> awaiting ) const noexcept -> bool {
+        auto &promise = handle_.promise();
+        promise.continuation_ = awaiting;
+
+        // If task completed in between then resume awaiting coroutine
+        // immediately.
+        auto expected = TaskState::kRunning;
+        return promise.state_.compare_exchange_strong(
+          expected, TaskState::kAwaited, std::memory_order_acq_rel, std::memory_order_acquire );
+    }
+
+    // Destroys the frame when it goes out of scope, after the result has
+    // been moved out.
+    struct FrameGuard final {
+        ~FrameGuard() {
+            if ( handle_ ) {
+                handle_.destroy();
+            }
+        }
+
+        handle_type handle_;
+    };
+
+    // Called first thing in await_resume. Completes the handshake for a
+    // suspended awaiter and takes over the frame if the Task was dropped
+    // while it waited.
+    [[nodiscard]]
+    auto settle() const noexcept -> FrameGuard {
+        const auto previous = handle_.promise().state_.exchange( TaskState::kCompleted, std::memory_order_acq_rel );
+        return FrameGuard{ previous == TaskState::kAwaitedDetached ? handle_ : nullptr };
+    }
+
+    auto rethrowIfFailed() const -> void {
+        if ( handle_.promise().exception_ ) {
+            std::rethrow_exception( handle_.promise().exception_ );
+        }
+    }
+
+    handle_type handle_;
+};
+
+export template <typename T>
+struct Task {
+    using value_type = T;
+
+    struct promise_type;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    struct promise_type : TaskPromiseBase<promise_type> {
+    public:
         auto get_return_object() -> Task {
             //
             return handle_type::from_promise( *this );
         };
 
-        auto initial_suspend() noexcept -> std::suspend_never {
+        auto return_value( value_type &&value ) -> void {
             //
-            return {};
-        }
-
-        auto final_suspend() noexcept -> ThenableAwaiter {
-            if ( thenCb_ ) {
-                // If we reach final suspend point and callback was passed
-                // then call it and signal to not suspend the coroutine
-                thenCb_( payload_ );
-                needToSuspend_ = false;
-            }
-
-            return {};
+            payload_.emplace( std::move( value ) );
         }
 
-        auto return_value( value_type value ) -> void {
+        auto return_value( const value_type &value ) -> void
+            requires std::copy_constructible<value_type>
+        {
             //
-            payload_ = std::move( value );
+            payload_.emplace( value );
         }
 
-        auto unhandled_exception() -> void {
-            //
-            exception_ = std::current_exception();
+        // Called once coroutine finished and nobody owns the Task anymore.
+        auto onDetached() -> void {
+            if ( payload_ ) {
+                if ( thenCb_ ) {
+                    thenCb_( std::move( *payload_ ) );
+                }
+            } else if ( errorCb_ ) {
+                errorCb_( this->exception_ );
+            }
         }
 
     public:
-        value_type payload_;
-        bool needToSuspend_{ true };
+        // Empty until co_return, stays empty if coroutine threw.
+        std::optional<value_type> payload_{};
         std::function<void( value_type )> thenCb_{};
+        std::function<void( std::exception_ptr )> errorCb_{};
+    };
 
-        std::exception_ptr exception_{ nullptr };
+    struct Awaiter final : TaskAwaiter<promise_type> {
+        auto await_resume() const -> value_type {
+            const auto guard = this->settle();
+            this->rethrowIfFailed();
+            return std::move( *this->handle_.promise().payload_ );
+        }
     };
 
     Task( handle_type h )
@@ -103,9 +234,7 @@ struct Task {
 
     auto operator=( Task &&other ) noexcept -> Task & {
         if ( std::addressof( other ) != this ) {
-            if ( handle_ ) {
-                handle_.destroy();
-            }
+            detach();
 
             handle_ = other.handle_;
             other.handle_ = nullptr;
@@ -118,17 +247,28 @@ struct Task {
     Task( const Task & ) = delete;
     auto operator=( const Task & ) -> Task & = delete;
 
-    ~Task() = default;
+    ~Task() {
+        //
+        detach();
+    }
 
+    // Give up ownership, coroutine frame destroys itself when
+    // coroutine reaches final suspend point. A coroutine suspended in
+    // co_await on this Task still gets the result, then() callbacks are
+    // not called in that case.
     auto detach() noexcept -> void {
         if ( empty() ) {
             return;
         }
 
-        if ( handle_ ) {
+        auto &promise = handle_.promise();
+        if ( promise.detachOwner() ) {
+            // Already completed, frame is ours.
+            promise.onDetached();
             handle_.destroy();
-            handle_ = nullptr;
         }
+
+        handle_ = nullptr;
     }
 
     [[nodiscard]]
@@ -142,19 +282,19 @@ struct Task {
         return !empty();
     }
 
-    auto then( std::function<void( value_type )> cb ) -> void {
-        if ( !handle_.done() ) {
-            // If coroutine not in final suspend point then pass
-            // callback to promise for later call when coroutine
-            // reaches final suspend.
-            handle_.promise().thenCb_ = std::move( cb );
-        } else {
-            // Else if coroutine already reach final suspend then payload_
-            // always ready, we can call callback from here and destroy
-            // coroutine frame.
-            cb( handle_.promise().payload_ );
-            detach();
-        }
+    auto operator co_await() const noexcept -> Awaiter {
+        //
+        return Awaiter{ { handle_ } };
+    }
+
+    // Call cb with result when coroutine reaches final suspend point,
+    // or right here if it already did. Task gives up ownership. If the
+    // coroutine threw, onError gets the exception instead, without it
+    // the exception is dropped.
+    auto then( std::function<void( value_type )> cb, std::function<void( std::exception_ptr )> onError = {} ) -> void {
+        handle_.promise().thenCb_ = std::move( cb );
+        handle_.promise().errorCb_ = std::move( onError );
+        detach();
     }
 
 private:
@@ -168,46 +308,158 @@ struct Task<void> {
     struct promise_type;
     using handle_type = std::coroutine_handle<promise_type>;
 
-    struct promise_type {
+    struct promise_type : TaskPromiseBase<promise_type> {
     public:
         auto get_return_object() -> Task {
             //
-            return {};
+            return handle_type::from_promise( *this );
         };
 
-        auto initial_suspend() noexcept {
-            //
-            return std::suspend_never{};
+        auto return_void() -> void { /* noop */ }
+
+        auto onDetached() -> void { /* noop */ }
+    };
+
+    struct Awaiter final : TaskAwaiter<promise_type> {
+        auto await_resume() const -> void {
+            const auto guard = this->settle();
+            this->rethrowIfFailed();
         }
+    };
 
-        auto final_suspend() noexcept {
-            //
-            return std::suspend_never{};
+    Task( handle_type h )
+        : handle_( h ) { /* noop */ }
+
+    Task( Task &&t ) noexcept
+        : handle_( t.handle_ ) {
+        t.handle_ = nullptr;
+    }
+
+    auto operator=( Task &&other ) noexcept -> Task & {
+        if ( std::addressof( other ) != this ) {
+            detach();
+
+            handle_ = other.handle_;
+            other.handle_ = nullptr;
         }
 
-        auto return_void() -> void { /* noop */ }
+        return *this;
+    }
 
-        auto unhandled_exception() -> void {
-            //
-            exception_ = std::current_exception();
+    // Move only.
+    Task( const Task & ) = delete;
+    auto operator=( const Task & ) -> Task & = delete;
+
+    // Fire-and-forget call sites just drop the Task, coroutine keeps
+    // running and cleans up after itself.
+    ~Task() {
+        //
+        detach();
+    }
+
+    auto detach() noexcept -> void {
+        if ( empty() ) {
+            return;
         }
 
-    public:
-        std::exception_ptr exception_{ nullptr };
-    };
+        if ( handle_.promise().detachOwner() ) {
+            handle_.destroy();
+        }
+
+        handle_ = nullptr;
+    }
+
+    [[nodiscard]]
+    auto empty() const noexcept -> bool {
+        //
+        return handle_ == nullptr;
+    }
+
+    explicit operator bool() const noexcept {
+        //
+        return !empty();
+    }
+
+    auto operator co_await() const noexcept -> Awaiter {
+        //
+        return Awaiter{ { handle_ } };
+    }
+
+private:
+    handle_type handle_{ nullptr };
 };
 
+// BlockingTask promise state, single futex word.
+constexpr uint32_t kBlockingRunning = 0;
+constexpr uint32_t kBlockingReady = 1;
+constexpr uint32_t kBlockingParked = 2;
+constexpr uint32_t kBlockingDetached = 3;
+// Completion is waking the parked owner, which must not free the frame
+// before the wake call is done with the word.
+constexpr uint32_t kBlockingWaking = 4;
+
+// Polls before parking, most bridged requests are already done or about
+// to finish when get() is called.
+constexpr int kBlockingSpinCount = 128;
+
 // Task class with get() method, block caller thread and
 // and return value when ready.
-export template <TaskParameter T>
+export template <typename T>
 struct BlockingTask {
     using value_type = T;
 
     struct promise_type;
     using handle_type = std::coroutine_handle<promise_type>;
 
-    struct promise_type {
+    struct promise_type : pstd::PooledFrame {
     public:
+        struct FinalAwaiter final {
+            [[nodiscard]]
+            auto await_ready() const noexcept -> bool {
+                //
+                return false;
+            }
+
+            // Coroutine is suspended here, so owner may destroy the frame
+            // as soon as it observes ready state. A parked owner is woken
+            // before the state turns ready, so the wake never touches a
+            // freed word.
+            auto await_suspend( handle_type handle ) const noexcept -> void {
+                auto &state = handle.promise().state_;
+                auto current = state.load( std::memory_order_acquire );
+                while ( true ) {
+                    switch ( current ) {
+                        case kBlockingParked: {
+                            if ( !state.compare_exchange_weak(
+                                   current, kBlockingWaking, std::memory_order_acq_rel, std::memory_order_acquire ) ) {
+                                continue;
+                            }
+                            pstd::futexWake( state );
+                            // Owner may have given up waiting and detached meanwhile.
+                            if ( state.exchange( kBlockingReady, std::memory_order_acq_rel ) == kBlockingDetached ) {
+                                handle.destroy();
+                            }
+                            return;
+                        }
+                        case kBlockingDetached: {
+                            handle.destroy();
+                            return;
+                        }
+                        default: {
+                            if ( state.compare_exchange_weak(
+                                   current, kBlockingReady, std::memory_order_acq_rel, std::memory_order_acquire ) ) {
+                                return;
+                            }
+                        }
+                    }
+                }
+            }
+
+            auto await_resume() const noexcept -> void {
+                //
+            }
+        };
+
         auto get_return_object() -> BlockingTask {
             //
             return handle_type::from_promise( *this );
@@ -218,19 +470,21 @@ struct BlockingTask {
             return {};
         }
 
-        auto final_suspend() noexcept -> std::suspend_always {
-            {
-                std::lock_guard<std::mutex> _{ m_ };
-                ready_ = true;
-            }
-            cv_.notify_one();
-
+        auto final_suspend() noexcept -> FinalAwaiter {
+            //
             return {};
         }
 
-        auto return_value( value_type value ) -> void {
+        auto return_value( value_type &&value ) -> void {
+            //
+            payload_.emplace( std::move( value ) );
+        }
+
+        auto return_value( const value_type &value ) -> void
+            requires std::copy_constructible<value_type>
+        {
             //
-            payload_ = std::move( value );
+            payload_.emplace( value );
         }
 
         auto unhandled_exception() -> void {
@@ -239,11 +493,8 @@ struct BlockingTask {
         }
 
     public:
-        value_type payload_;
-
-        std::condition_variable cv_;
-        std::mutex m_;
-        bool ready_{};
+        std::optional<value_type> payload_{};
+        std::atomic<uint32_t> state_{ kBlockingRunning };
 
         std::exception_ptr exception_{ nullptr };
     };
@@ -258,9 +509,7 @@ struct BlockingTask {
 
     auto operator=( BlockingTask &&other ) noexcept -> BlockingTask & {
         if ( std::addressof( other ) != this ) {
-            if ( handle_ ) {
-                handle_.destroy();
-            }
+            detach();
 
             handle_ = other.handle_;
             other.handle_ = nullptr;
@@ -278,15 +527,17 @@ struct BlockingTask {
         detach();
     }
 
+    // Give up result, still running coroutine destroys itself on
+    // completion.
     auto detach() noexcept -> void {
         if ( empty() ) {
             return;
         }
 
-        if ( handle_ ) {
+        if ( handle_.promise().state_.exchange( kBlockingDetached, std::memory_order_acq_rel ) == kBlockingReady ) {
             handle_.destroy();
-            handle_ = nullptr;
         }
+        handle_ = nullptr;
     }
 
     [[nodiscard]]
@@ -300,24 +551,81 @@ struct BlockingTask {
         return !empty();
     }
 
+    [[nodiscard]]
+    auto ready() const noexcept -> bool {
+        //
+        return handle_.promise().state_.load( std::memory_order_acquire ) == kBlockingReady;
+    }
+
+    // Block caller thread until coroutine reaches final suspend point.
     [[nodiscard]]
     auto get() -> value_type {
-        if ( !handle_.done() ) {
-            // Block caller thread until coroutine reach final_suspend()
-            std::unique_lock<std::mutex> lk{ handle_.promise().m_ };
-            handle_.promise().cv_.wait( lk, [this]() -> bool {
-                //
-                return handle_.promise().ready_;
-            } );
+        wait( std::chrono::nanoseconds::max() );
+        return take();
+    }
+
+    // Same as get(), empty result if coroutine is not finished within
+    // timeout. Task stays valid then and may be waited again.
+    template <typename Rep, typename Period>
+    [[nodiscard]]
+    auto getFor( std::chrono::duration<Rep, Period> timeout ) -> std::optional<value_type> {
+        if ( !wait( std::chrono::duration_cast<std::chrono::nanoseconds>( timeout ) ) ) {
+            return std::nullopt;
+        }
+        return take();
+    }
+
+private:
+    auto wait( std::chrono::nanoseconds timeout ) -> bool {
+        auto &state = handle_.promise().state_;
+
+        for ( int i = 0; i < kBlockingSpinCount; ++i ) {
+            if ( state.load( std::memory_order_acquire ) == kBlockingReady ) {
+                return true;
+            }
+            pstd::cpuRelax();
         }
 
-        auto &&payload = std::move( handle_.promise().payload_ );
+        const auto infinite = timeout == std::chrono::nanoseconds::max();
+        const auto deadline = infinite ? std::chrono::steady_clock::time_point::max()
+                                       : std::chrono::steady_clock::now() + timeout;
+
+        auto expected = kBlockingRunning;
+        state.compare_exchange_strong( expected, kBlockingParked, std::memory_order_acq_rel, std::memory_order_acquire );
+
+        while ( true ) {
+            const auto current = state.load( std::memory_order_acquire );
+            if ( current == kBlockingReady ) {
+                break;
+            }
+            if ( current == kBlockingWaking ) {
+                // Completion is leaving futexWake(), ready in a moment.
+                pstd::cpuRelax();
+                continue;
+            }
+            const auto left = infinite ? std::chrono::nanoseconds::max()
+                                       : std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                           deadline - std::chrono::steady_clock::now() );
+            if ( !pstd::futexWait( state, kBlockingParked, left ) ) {
+                return state.load( std::memory_order_acquire ) == kBlockingReady;
+            }
+        }
+
+        return true;
+    }
+
+    auto take() -> value_type {
+        if ( auto exception = handle_.promise().exception_ ) {
+            detach();
+            std::rethrow_exception( exception );
+        }
+
+        auto payload = std::move( *handle_.promise().payload_ );
         detach();
 
         return payload;
     }
 
-private:
     handle_type handle_{ nullptr };
 };
 
@@ -0,0 +1,282 @@
+module;
+
+#include <atomic>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <stop_token>
+#include <utility>
+
+export module poller:task_scope;
+
+import poller_std;
+
+namespace poller {
+
+// Owns a group of child coroutines and joins them. Children start in
+// spawn order with at most `maxConcurrency` running at once, the first
+// child that throws cancels the rest and its exception is rethrown from
+// join().
+//
+//   auto scope = TaskScope{ 8 };
+//   for ( const auto &url : urls ) {
+//       scope.spawn( [&, url]() -> Task<void> { store( co_await client.get( url ) ); } );
+//   }
+//   co_await scope.join();
+//
+// Spawned callable is kept in the child frame until the child finishes,
+// so capturing lambdas are safe. It must return something co_await-able,
+// e.g. Task<void>; callables taking std::stop_token get the scope token
+// and may check it to stop early. Child frames come from the pooled
+// frame allocator.
+export struct TaskScope final {
+public:
+    static constexpr size_t kUnlimited = std::numeric_limits<size_t>::max();
+
+    explicit TaskScope( size_t maxConcurrency = kUnlimited ) noexcept
+        : maxConcurrency_{ maxConcurrency == 0 ? 1 : maxConcurrency } {
+        /* noop */
+    }
+
+    TaskScope( const TaskScope & ) = delete;
+    TaskScope( TaskScope && ) = delete;
+    auto operator=( const TaskScope & ) -> TaskScope & = delete;
+    auto operator=( TaskScope && ) -> TaskScope & = delete;
+
+    // Cancels children not started yet and blocks until running ones
+    // finish, frames never outlive the scope. Prefer co_await join().
+    ~TaskScope() {
+        cancel();
+
+        auto live = live_.load( std::memory_order_acquire );
+        while ( live != 0 ) {
+            pstd::futexWait( live_, live );
+            live = live_.load( std::memory_order_acquire );
+        }
+
+        // Last child may still be waking us and leaving the mutex.
+        auto lock = std::lock_guard{ mutex_ };
+    }
+
+    struct JoinAwaiter {
+        [[nodiscard]]
+        auto await_ready() const noexcept -> bool {
+            // Checked under the mutex in await_suspend, last child may
+            // still be leaving it.
+            return false;
+        }
+
+        auto await_suspend( std::coroutine_handle<> awaitingCoroutine ) -> bool {
+            auto lock = std::lock_guard{ scope_.mutex_ };
+            if ( scope_.live_.load( std::memory_order_relaxed ) == 0 ) {
+                return false;
+            }
+            scope_.joiner_ = awaitingCoroutine;
+            return true;
+        }
+
+        // Rethrows exception of the first failed child.
+        auto await_resume() const -> void {
+            if ( scope_.exception_ ) {
+                std::rethrow_exception( scope_.exception_ );
+            }
+        }
+
+        TaskScope &scope_;
+    };
+
+    // Starts child now if below concurrency limit, queues it otherwise.
+    // Ignored once the scope is cancelled.
+    template <typename Fn>
+        requires std::invocable<Fn &> || std::invocable<Fn &, std::stop_token>
+    auto spawn( Fn fn ) -> void {
+        auto child = std::coroutine_handle<>{ runChild( *this, std::move( fn ) ).handle_ };
+
+        {
+            auto lock = std::lock_guard{ mutex_ };
+            if ( stopSource_.stop_requested() ) {
+                child.destroy();
+                return;
+            }
+
+            live_.fetch_add( 1, std::memory_order_relaxed );
+            if ( running_ >= maxConcurrency_ ) {
+                pending_.push_back( child );
+                return;
+            }
+            ++running_;
+        }
+
+        child.resume();
+    }
+
+    // Parent continues once every spawned child finished.
+    [[nodiscard]]
+    auto join() noexcept -> JoinAwaiter {
+        //
+        return JoinAwaiter{ *this };
+    }
+
+    // Drops queued children and signals running ones via stop token.
+    auto cancel() -> void {
+        auto lock = std::lock_guard{ mutex_ };
+        cancelLocked();
+    }
+
+    [[nodiscard]]
+    auto stopToken() const noexcept -> std::stop_token {
+        //
+        return stopSource_.get_token();
+    }
+
+    // Children spawned and not finished yet, running or queued.
+    [[nodiscard]]
+    auto size() const noexcept -> size_t {
+        //
+        return live_.load( std::memory_order_relaxed );
+    }
+
+private:
+    // Lazily started wrapper around spawned callable, reports completion
+    // to the scope and destroys itself.
+    struct Child {
+        struct promise_type : pstd::PooledFrame {
+            template <typename... Args>
+            explicit promise_type( TaskScope &scope, Args &... ) noexcept
+                : scope_{ &scope } {
+                /* noop */
+            }
+
+            struct FinalAwaiter final {
+                [[nodiscard]]
+                auto await_ready() const noexcept -> bool {
+                    //
+                    return false;
+                }
+
+                // Transfers to next queued child or to the joining parent.
+                auto await_suspend( std::coroutine_handle<promise_type> handle ) const noexcept
+                  -> std::coroutine_handle<> {
+                    auto *scope = handle.promise().scope_;
+                    handle.destroy();
+                    return scope->onChildDone();
+                }
+
+                auto await_resume() const noexcept -> void {
+                    //
+                }
+            };
+
+            auto get_return_object() -> Child {
+                //
+                return Child{ std::coroutine_handle<promise_type>::from_promise( *this ) };
+            }
+
+            auto initial_suspend() noexcept -> std::suspend_always {
+                //
+                return {};
+            }
+
+            auto final_suspend() noexcept -> FinalAwaiter {
+                //
+                return {};
+            }
+
+            auto return_void() -> void { /* noop */ }
+
+            auto unhandled_exception() -> void {
+                //
+                scope_->fail( std::current_exception() );
+            }
+
+            TaskScope *scope_;
+        };
+
+        std::coroutine_handle<promise_type> handle_;
+    };
+
+    template <typename Fn>
+    static auto runChild( TaskScope &scope, Fn fn ) -> Child {
+        if ( scope.stopSource_.stop_requested() ) {
+            co_return;
+        }
+
+        if constexpr ( std::invocable<Fn &, std::stop_token> ) {
+            co_await std::invoke( fn, scope.stopToken() );
+        } else {
+            co_await std::invoke( fn );
+        }
+    }
+
+    auto fail( std::exception_ptr exception ) -> void {
+        auto lock = std::lock_guard{ mutex_ };
+        if ( !exception_ ) {
+            exception_ = std::move( exception );
+        }
+        cancelLocked();
+    }
+
+    auto cancelLocked() -> void {
+        stopSource_.request_stop();
+
+        // Queued children never started, their frames only hold the
+        // callable.
+        for ( auto child : pending_ ) {
+            child.destroy();
+        }
+        live_.fetch_sub( static_cast<uint32_t>( pending_.size() ), std::memory_order_release );
+        pending_.clear();
+
+        // Under the mutex, see onChildDone().
+        if ( live_.load( std::memory_order_relaxed ) == 0 ) {
+            pstd::futexWake( live_, std::numeric_limits<int>::max() );
+        }
+    }
+
+    // Called from the final suspend point of every child. Nothing touches
+    // the scope after the mutex is released: the destructor takes the
+    // mutex once it observes no live children, so the wake below, done
+    // while holding it, never runs on a freed word.
+    auto onChildDone() noexcept -> std::coroutine_handle<> {
+        auto next = std::coroutine_handle<>{ std::noop_coroutine() };
+
+        {
+            auto lock = std::lock_guard{ mutex_ };
+            --running_;
+
+            if ( !pending_.empty() ) {
+                next = pending_.front();
+                pending_.pop_front();
+                ++running_;
+            } else if ( running_ == 0 && joiner_ ) {
+                next = std::exchange( joiner_, nullptr );
+            }
+
+            if ( live_.fetch_sub( 1, std::memory_order_release ) == 1 ) {
+                pstd::futexWake( live_, std::numeric_limits<int>::max() );
+            }
+        }
+
+        return next;
+    }
+
+    const size_t maxConcurrency_;
+
+    std::mutex mutex_;
+    std::deque<std::coroutine_handle<>> pending_{};
+    size_t running_{ 0 };
+    std::coroutine_handle<> joiner_{ nullptr };
+    std::exception_ptr exception_{ nullptr };
+    std::stop_source stopSource_{};
+
+    // Spawned and not finished children, futex word for the destructor.
+    std::atomic<uint32_t> live_{ 0 };
+};
+
+}  // namespace poller
@@ -0,0 +1,312 @@
+module;
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined( __linux__ )
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+export module poller_std:affinity;
+
+namespace poller::pstd {
+
+/**
+ * \brief Online CPUs of this process grouped by NUMA node.
+ *
+ * Read once from /sys/devices/system/node and intersected with the
+ * process affinity mask, so taskset and cgroup cpusets are respected.
+ * Machines without NUMA information look like a single node.
+ */
+export struct CpuTopology final {
+public:
+    [[nodiscard]]
+    static auto get() -> const CpuTopology & {
+        static const auto topology = CpuTopology{};
+        return topology;
+    }
+
+    [[nodiscard]]
+    auto nodes() const noexcept -> const std::vector<std::vector<unsigned>> & {
+        //
+        return nodes_;
+    }
+
+    [[nodiscard]]
+    auto cpuCount() const noexcept -> size_t {
+        //
+        return nodeOf_.size();
+    }
+
+    // Node of given CPU, 0 for CPUs the process may not run on.
+    [[nodiscard]]
+    auto nodeOf( unsigned cpu ) const noexcept -> unsigned {
+        const auto it = std::ranges::lower_bound( nodeOf_, cpu, {}, &std::pair<unsigned, unsigned>::first );
+        return it != nodeOf_.end() && it->first == cpu ? it->second : 0;
+    }
+
+private:
+    CpuTopology() {
+        const auto allowed = allowedCpus();
+
+        for ( unsigned node = 0;; ++node ) {
+            auto file = std::ifstream{ "/sys/devices/system/node/node" + std::to_string( node ) + "/cpulist" };
+            if ( !file ) {
+                break;
+            }
+            auto list = std::string{};
+            std::getline( file, list );
+
+            auto cpus = std::vector<unsigned>{};
+            for ( const auto cpu : parseCpuList( list ) ) {
+                if ( std::ranges::binary_search( allowed, cpu ) ) {
+                    cpus.push_back( cpu );
+                }
+            }
+            // Memory-only nodes and nodes outside our cpuset.
+            if ( !cpus.empty() ) {
+                nodes_.push_back( std::move( cpus ) );
+            }
+        }
+
+        if ( nodes_.empty() ) {
+            nodes_.push_back( allowed );
+        }
+
+        for ( unsigned node = 0; node != nodes_.size(); ++node ) {
+            for ( const auto cpu : nodes_[node] ) {
+                nodeOf_.emplace_back( cpu, node );
+            }
+        }
+        std::ranges::sort( nodeOf_ );
+    }
+
+    // "0-3,8,10-11" -> 0 1 2 3 8 10 11
+    static auto parseCpuList( const std::string &list ) -> std::vector<unsigned> {
+        auto cpus = std::vector<unsigned>{};
+        size_t pos = 0;
+        while ( pos < list.size() ) {
+            auto end = list.find( ',', pos );
+            if ( end == std::string::npos ) {
+                end = list.size();
+            }
+            const auto range = list.substr( pos, end - pos );
+            const auto dash = range.find( '-' );
+            try {
+                const auto first = static_cast<unsigned>( std::stoul( range.substr( 0, dash ) ) );
+                const auto last =
+                  dash == std::string::npos ? first : static_cast<unsigned>( std::stoul( range.substr( dash + 1 ) ) );
+                for ( auto cpu = first; cpu <= last; ++cpu ) {
+                    cpus.push_back( cpu );
+                }
+            } catch ( ... ) {
+                // Malformed entry, skip it.
+            }
+            pos = end + 1;
+        }
+        return cpus;
+    }
+
+    static auto allowedCpus() -> std::vector<unsigned> {
+        auto cpus = std::vector<unsigned>{};
+#if defined( __linux__ )
+        cpu_set_t set;
+        CPU_ZERO( &set );
+        if ( sched_getaffinity( 0, sizeof( set ), &set ) == 0 ) {
+            for ( unsigned cpu = 0; cpu != CPU_SETSIZE; ++cpu ) {
+                if ( CPU_ISSET( cpu, &set ) ) {
+                    cpus.push_back( cpu );
+                }
+            }
+        }
+#endif
+        if ( cpus.empty() ) {
+            const auto count = std::max( std::thread::hardware_concurrency(), 1u );
+            for ( unsigned cpu = 0; cpu != count; ++cpu ) {
+                cpus.push_back( cpu );
+            }
+        }
+        return cpus;
+    }
+
+private:
+    std::vector<std::vector<unsigned>> nodes_{};
+    // Sorted by CPU.
+    std::vector<std::pair<unsigned, unsigned>> nodeOf_{};
+};
+
+/**
+ * \brief Where threads of a pool or a loop go.
+ *
+ * Resolved to an ordered CPU list, thread `i` is pinned to entry
+ * `i % size`. Empty list leaves threads to the kernel scheduler.
+ *
+ *   ThreadPool pool{ 16, Placement::scatter() };
+ *
+ *   auto split = isolateIo( 2 );
+ *   io::Scheduler loop{ split.io_.at( 0 ) };
+ *   Poller poller{ split.io_.at( 1 ) };
+ *   ThreadPool compute{ 14, split.compute_ };
+ */
+export struct Placement final {
+public:
+    Placement() = default;
+
+    // Leave threads unpinned.
+    [[nodiscard]]
+    static auto none() -> Placement {
+        //
+        return {};
+    }
+
+    // Exactly these CPUs, in this order.
+    [[nodiscard]]
+    static auto cores( std::vector<unsigned> cpus ) -> Placement {
+        //
+        return Placement{ std::move( cpus ) };
+    }
+
+    // Fill node 0 first, then node 1 and so on. Keeps a small pool on one
+    // socket, sharing its last level cache and memory controller.
+    [[nodiscard]]
+    static auto compact( const std::vector<unsigned> &exclude = {} ) -> Placement {
+        auto cpus = std::vector<unsigned>{};
+        for ( const auto &node : CpuTopology::get().nodes() ) {
+            for ( const auto cpu : node ) {
+                if ( std::ranges::find( exclude, cpu ) == exclude.end() ) {
+                    cpus.push_back( cpu );
+                }
+            }
+        }
+        return Placement{ std::move( cpus ) };
+    }
+
+    // Round-robin over nodes, spreads memory bandwidth of a wide pool.
+    [[nodiscard]]
+    static auto scatter( const std::vector<unsigned> &exclude = {} ) -> Placement {
+        auto nodes = std::vector<std::vector<unsigned>>{};
+        for ( const auto &node : CpuTopology::get().nodes() ) {
+            auto &cpus = nodes.emplace_back();
+            for ( const auto cpu : node ) {
+                if ( std::ranges::find( exclude, cpu ) == exclude.end() ) {
+                    cpus.push_back( cpu );
+                }
+            }
+        }
+
+        auto cpus = std::vector<unsigned>{};
+        for ( size_t i = 0;; ++i ) {
+            auto added = false;
+            for ( const auto &node : nodes ) {
+                if ( i < node.size() ) {
+                    cpus.push_back( node[i] );
+                    added = true;
+                }
+            }
+            if ( !added ) {
+                break;
+            }
+        }
+        return Placement{ std::move( cpus ) };
+    }
+
+    // CPU for the i-th thread, nullopt if it should stay unpinned.
+    [[nodiscard]]
+    auto cpuFor( size_t i ) const noexcept -> std::optional<unsigned> {
+        if ( cpus_.empty() ) {
+            return std::nullopt;
+        }
+        return cpus_[i % cpus_.size()];
+    }
+
+    // Placement of the i-th thread alone, for single thread owners.
+    [[nodiscard]]
+    auto at( size_t i ) const -> Placement {
+        if ( cpus_.empty() ) {
+            return {};
+        }
+        return cores( { cpus_[i % cpus_.size()] } );
+    }
+
+    [[nodiscard]]
+    auto cpus() const noexcept -> const std::vector<unsigned> & {
+        //
+        return cpus_;
+    }
+
+private:
+    explicit Placement( std::vector<unsigned> cpus )
+        : cpus_{ std::move( cpus ) } {
+        /* noop */
+    }
+
+    std::vector<unsigned> cpus_{};
+};
+
+export enum class Spread : uint8_t {
+    kCompact,
+    kScatter,
+};
+
+export struct IsolatedPlacement final {
+    // One CPU per I/O thread, event loops and curl worker.
+    Placement io_;
+    // Everything else, for compute pools.
+    Placement compute_;
+};
+
+/**
+ * \brief Splits CPUs between I/O threads and compute workers.
+ *
+ * I/O threads get the last `ioThreads` CPUs of node 0, away from CPU 0
+ * which usually takes housekeeping and interrupts. Compute workers never
+ * share a CPU with them, so a busy pool doesn't delay socket readiness
+ * processing. Falls back to no isolation when there are not enough CPUs.
+ */
+export inline auto isolateIo( unsigned ioThreads, Spread spread = Spread::kCompact ) -> IsolatedPlacement {
+    const auto spreadExcept = [spread]( const std::vector<unsigned> &exclude ) -> Placement {
+        return spread == Spread::kScatter ? Placement::scatter( exclude ) : Placement::compact( exclude );
+    };
+
+    const auto &first = CpuTopology::get().nodes().front();
+    if ( ioThreads == 0 || CpuTopology::get().cpuCount() <= ioThreads ) {
+        return { {}, spreadExcept( {} ) };
+    }
+
+    auto io = std::vector<unsigned>{};
+    for ( auto it = first.rbegin(); it != first.rend() && io.size() != ioThreads; ++it ) {
+        io.push_back( *it );
+    }
+    std::ranges::reverse( io );
+
+    return { Placement::cores( io ), spreadExcept( io ) };
+}
+
+/**
+ * \brief Pins the calling thread to one CPU.
+ *
+ * \return `false` if the platform or the process cpuset doesn't allow it,
+ * the thread then keeps running wherever the kernel puts it.
+ */
+export inline auto pinCurrentThread( unsigned cpu ) -> bool {
+#if defined( __linux__ )
+    if ( cpu >= CPU_SETSIZE ) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO( &set );
+    CPU_SET( cpu, &set );
+    return pthread_setaffinity_np( pthread_self(), sizeof( set ), &set ) == 0;
+#else
+    return false;
+#endif
+}
+
+}  // namespace poller::pstd
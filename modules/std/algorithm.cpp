@@ -0,0 +1,387 @@
+module;
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+export module poller_std:algorithm;
+
+import :threadpool;
+
+namespace poller::pstd {
+
+// Pieces a range is cut into per participating thread up front. A piece
+// that gets stolen may be cut kStolenSplits more times, so uneven work
+// is split finer only where somebody is actually idle.
+constexpr size_t kPiecesPerThread = 4;
+constexpr unsigned kStolenSplits = 2;
+// Halvings allowed with an explicit grain, more than any range has.
+constexpr unsigned kUnlimitedSplits = 64;
+
+// Below these sizes sorting and merging are not worth a task.
+constexpr size_t kSortCutoff = 2048;
+constexpr size_t kMergeCutoff = 4096;
+
+/**
+ * \brief Tasks of one parallel call and their first exception.
+ *
+ * Spawned tasks go through `ThreadPool::submit`, `join()` has the caller
+ * run pool tasks via `ThreadPool::wait(predicate)` until all of them
+ * finished, so a worker calling it never blocks its own pool. Once a task
+ * throws, tasks not started yet are skipped and the exception is rethrown
+ * from `join()`.
+ */
+class ForkJoin final {
+public:
+    explicit ForkJoin( ThreadPool &pool ) noexcept
+        : pool_{ pool } {
+        /* noop */
+    }
+
+    ForkJoin( const ForkJoin & ) = delete;
+    ForkJoin( ForkJoin && ) = delete;
+    auto operator=( const ForkJoin & ) -> ForkJoin & = delete;
+    auto operator=( ForkJoin && ) -> ForkJoin & = delete;
+
+    template <typename Fn>
+    auto spawn( Fn fn ) -> void {
+        pending_.fetch_add( 1, std::memory_order_relaxed );
+        pool_.submit( [this, fn = std::move( fn )]() mutable -> void {
+            run( fn );
+            // Caller may return and destroy us right after this.
+            pending_.fetch_sub( 1, std::memory_order_release );
+        } );
+    }
+
+    template <typename Fn>
+    auto run( Fn &fn ) noexcept -> void {
+        if ( failed_.load( std::memory_order_relaxed ) ) {
+            return;
+        }
+        try {
+            fn();
+        } catch ( ... ) {
+            fail( std::current_exception() );
+        }
+    }
+
+    auto join() -> void {
+        pool_.wait( [this]() -> bool { return pending_.load( std::memory_order_acquire ) == 0; } );
+        if ( exception_ ) {
+            std::rethrow_exception( exception_ );
+        }
+    }
+
+    [[nodiscard]]
+    auto pool() const noexcept -> ThreadPool & {
+        //
+        return pool_;
+    }
+
+private:
+    auto fail( std::exception_ptr exception ) -> void {
+        auto lock = std::lock_guard{ mutex_ };
+        if ( !exception_ ) {
+            exception_ = std::move( exception );
+        }
+        failed_.store( true, std::memory_order_relaxed );
+    }
+
+    ThreadPool &pool_;
+    std::atomic<size_t> pending_{ 0 };
+    std::atomic<bool> failed_{ false };
+    std::mutex mutex_;
+    std::exception_ptr exception_{ nullptr };
+};
+
+/**
+ * \brief Recursive halving of [0, size) down to leaves.
+ *
+ * Each piece keeps its left half and spawns the right one, so the owner
+ * works through its own deque depth first while thieves take the biggest
+ * remaining halves from the top. With a zero grain the number of halvings
+ * is budgeted instead: enough for kPiecesPerThread pieces per thread, plus
+ * kStolenSplits for every piece that ran on a thread other than the one
+ * that spawned it.
+ */
+template <typename Leaf>
+class RangeSplitter final {
+public:
+    RangeSplitter( ThreadPool &pool, Leaf &leaf, const size_t grain ) noexcept
+        : join_{ pool }
+        , leaf_{ leaf }
+        , grain_{ grain == 0 ? 1 : grain }
+        , splits_{ grain == 0 ? static_cast<unsigned>( std::bit_width( kPiecesPerThread * ( pool.size() + 1 ) - 1 ) )
+                              : kUnlimitedSplits } {
+        /* noop */
+    }
+
+    auto operator()( const size_t size ) -> void {
+        auto root = [this, size]() -> void { split( 0, size, splits_, std::this_thread::get_id() ); };
+        join_.run( root );
+        join_.join();
+    }
+
+private:
+    auto split( const size_t begin, size_t end, unsigned splits, const std::thread::id owner ) -> void {
+        const auto self = std::this_thread::get_id();
+        if ( self != owner ) {
+            splits = std::min( splits + kStolenSplits, kUnlimitedSplits );
+        }
+        while ( end - begin > grain_ && splits != 0 ) {
+            const auto mid = begin + ( end - begin ) / 2;
+            --splits;
+            join_.spawn( [this, mid, end, splits, self]() -> void { split( mid, end, splits, self ); } );
+            end = mid;
+        }
+        leaf_( begin, end );
+    }
+
+    ForkJoin join_;
+    Leaf &leaf_;
+    const size_t grain_;
+    const unsigned splits_;
+};
+
+template <typename Leaf>
+auto splitRange( ThreadPool &pool, const size_t size, const size_t grain, Leaf &&leaf ) -> void {
+    if ( size == 0 ) {
+        return;
+    }
+    if ( pool.size() == 0 || size <= std::max<size_t>( grain, 1 ) ) {
+        leaf( 0, size );
+        return;
+    }
+    RangeSplitter{ pool, leaf, grain }( size );
+}
+
+/**
+ * \brief Runs both callables, `b` possibly on another thread, and returns
+ * when both finished. Rethrows the exception of either.
+ */
+export template <typename A, typename B>
+    requires std::invocable<A &> && std::invocable<B &>
+auto parallelInvoke( ThreadPool &pool, A &&a, B &&b ) -> void {
+    auto join = ForkJoin{ pool };
+    join.spawn( [&b]() -> void { std::invoke( b ); } );
+    join.run( a );
+    join.join();
+}
+
+/**
+ * \brief Calls `body` for every index of [first, last).
+ *
+ * Body takes either one index or a subrange `( begin, end )`, the latter
+ * lets it hoist per-chunk setup out of the loop:
+ *
+ *   parallelFor( pool, size_t{ 0 }, responses.size(), [&]( size_t i ) -> void {
+ *       parsed[i] = parse( responses[i] );
+ *   } );
+ *
+ * Grain is the smallest subrange worth a task. Zero, the default, adapts
+ * it to the load: the range is cut into a few pieces per thread and only
+ * pieces that idle threads steal are cut further. The calling thread runs
+ * pool tasks until the loop is done, see `ThreadPool::wait(predicate)`.
+ */
+export template <std::integral Index, typename Body>
+    requires std::invocable<Body &, Index, Index> || std::invocable<Body &, Index>
+auto parallelFor( ThreadPool &pool, const Index first, const Index last, Body &&body, const size_t grain = 0 )
+  -> void {
+    if ( last <= first ) {
+        return;
+    }
+    const auto size = static_cast<size_t>( last - first );
+    splitRange( pool, size, grain, [&]( const size_t begin, const size_t end ) -> void {
+        if constexpr ( std::invocable<Body &, Index, Index> ) {
+            std::invoke( body, static_cast<Index>( first + static_cast<Index>( begin ) ),
+                         static_cast<Index>( first + static_cast<Index>( end ) ) );
+        } else {
+            for ( auto i = begin; i != end; ++i ) {
+                std::invoke( body, static_cast<Index>( first + static_cast<Index>( i ) ) );
+            }
+        }
+    } );
+}
+
+/**
+ * \brief `std::reduce` on the pool.
+ *
+ * Like `std::reduce`, `op` must be associative and commutative: partial
+ * results are combined in whatever order pieces finish, so floating point
+ * sums may differ in the last bits from run to run.
+ */
+export template <std::random_access_iterator It, typename T, typename Op = std::plus<>>
+auto parallelReduce( ThreadPool &pool, const It first, const It last, T init, Op op = {}, const size_t grain = 0 )
+  -> T {
+    auto mutex = std::mutex{};
+    auto total = std::optional<T>{};
+    splitRange( pool, static_cast<size_t>( last - first ), grain, [&]( const size_t begin, const size_t end ) -> void {
+        auto partial = std::reduce( first + begin + 1, first + end, T( first[begin] ), op );
+
+        auto lock = std::lock_guard{ mutex };
+        total = total ? std::invoke( op, std::move( *total ), std::move( partial ) ) : std::move( partial );
+    } );
+    return total ? std::invoke( op, std::move( init ), std::move( *total ) ) : init;
+}
+
+/**
+ * \brief `std::transform` on the pool, `out` may be `first`.
+ *
+ * \return Iterator past the last written element.
+ */
+export template <std::random_access_iterator It, std::random_access_iterator Out, typename Op>
+    requires std::invocable<Op &, std::iter_reference_t<It>>
+auto parallelTransform( ThreadPool &pool, const It first, const It last, const Out out, Op op, const size_t grain = 0 )
+  -> Out {
+    const auto size = static_cast<size_t>( last - first );
+    splitRange( pool, size, grain, [&]( const size_t begin, const size_t end ) -> void {
+        for ( auto i = begin; i != end; ++i ) {
+            out[i] = std::invoke( op, first[i] );
+        }
+    } );
+    return out + size;
+}
+
+/**
+ * \brief `std::inclusive_scan` on the pool, `out` may be `first`.
+ *
+ * Two passes over blocks, a few per thread: block totals in parallel, a
+ * serial scan of the totals, then every block scanned from its carry in
+ * parallel. Does about twice the work of the serial scan, so it only pays
+ * off with several threads. `op` must be associative.
+ *
+ * \return Iterator past the last written element.
+ */
+export template <std::random_access_iterator It, std::random_access_iterator Out, typename Op = std::plus<>>
+auto parallelScan( ThreadPool &pool, const It first, const It last, const Out out, Op op = {} ) -> Out {
+    using value_type = std::iter_value_t<It>;
+
+    const auto size = static_cast<size_t>( last - first );
+    const auto blocks = std::min( size / kMergeCutoff, kPiecesPerThread * ( pool.size() + 1 ) );
+    if ( pool.size() == 0 || blocks < 2 ) {
+        return std::inclusive_scan( first, last, out, op );
+    }
+    const auto block = ( size + blocks - 1 ) / blocks;
+
+    // Last block's total is never needed.
+    auto carries = std::vector<std::optional<value_type>>( blocks );
+    parallelFor(
+      pool, size_t{ 0 }, blocks - 1,
+      [&]( const size_t k ) -> void {
+          const auto begin = k * block;
+          carries[k + 1] = std::accumulate( first + begin + 1, first + begin + block, value_type( first[begin] ), op );
+      },
+      1 );
+    for ( size_t k = 2; k < blocks; ++k ) {
+        carries[k] = std::invoke( op, std::move( *carries[k - 1] ), std::move( *carries[k] ) );
+    }
+
+    parallelFor(
+      pool, size_t{ 0 }, blocks,
+      [&]( const size_t k ) -> void {
+          const auto begin = std::min( k * block, size );
+          const auto end = std::min( begin + block, size );
+          if ( k == 0 ) {
+              std::inclusive_scan( first + begin, first + end, out + begin, op );
+          } else {
+              std::inclusive_scan( first + begin, first + end, out + begin, op, std::move( *carries[k] ) );
+          }
+      },
+      1 );
+    return out + size;
+}
+
+// Merges sorted [a, aEnd) and [b, bEnd) into out by splitting around the
+// middle element of the longer run, the halves merge independently.
+template <typename It, typename Out, typename Compare>
+auto parallelMerge( ThreadPool &pool, It a, It aEnd, It b, It bEnd, Out out, Compare &comp ) -> void {
+    const auto sizeA = static_cast<size_t>( aEnd - a );
+    const auto sizeB = static_cast<size_t>( bEnd - b );
+    if ( sizeA + sizeB <= kMergeCutoff ) {
+        std::merge( std::make_move_iterator( a ), std::make_move_iterator( aEnd ), std::make_move_iterator( b ),
+                    std::make_move_iterator( bEnd ), out, comp );
+        return;
+    }
+
+    // Equal elements of the first run stay in front of the second's.
+    It pivot;
+    It splitA;
+    It splitB;
+    if ( sizeA >= sizeB ) {
+        pivot = a + sizeA / 2;
+        splitA = pivot;
+        splitB = std::lower_bound( b, bEnd, *pivot, comp );
+    } else {
+        pivot = b + sizeB / 2;
+        splitA = std::upper_bound( a, aEnd, *pivot, comp );
+        splitB = pivot;
+    }
+    const auto at = out + ( splitA - a ) + ( splitB - b );
+    *at = std::move( *pivot );
+
+    const auto restA = sizeA >= sizeB ? splitA + 1 : splitA;
+    const auto restB = sizeA >= sizeB ? splitB : splitB + 1;
+    parallelInvoke(
+      pool, [&]() -> void { parallelMerge( pool, a, splitA, b, splitB, out, comp ); },
+      [&]() -> void { parallelMerge( pool, restA, aEnd, restB, bEnd, at + 1, comp ); } );
+}
+
+// Sorts n elements at `first`, result ends up in `buffer` if `intoBuffer`.
+// Halves sort into the other array so every merge level moves data once.
+template <typename It, typename Buffer, typename Compare>
+auto mergeSort( ThreadPool &pool, It first, Buffer buffer, const size_t size, const bool intoBuffer, Compare &comp )
+  -> void {
+    if ( size <= kSortCutoff ) {
+        std::sort( first, first + size, comp );
+        if ( intoBuffer ) {
+            std::move( first, first + size, buffer );
+        }
+        return;
+    }
+
+    const auto half = size / 2;
+    parallelInvoke(
+      pool, [&]() -> void { mergeSort( pool, first, buffer, half, !intoBuffer, comp ); },
+      [&]() -> void { mergeSort( pool, first + half, buffer + half, size - half, !intoBuffer, comp ); } );
+
+    if ( intoBuffer ) {
+        parallelMerge( pool, first, first + half, first + half, first + size, buffer, comp );
+    } else {
+        parallelMerge( pool, buffer, buffer + half, buffer + half, buffer + size, first, comp );
+    }
+}
+
+/**
+ * \brief Parallel merge sort.
+ *
+ * Halves are sorted in parallel and merged with a parallel merge, small
+ * runs go to `std::sort`, so like it the sort is not stable. Needs a
+ * buffer of the same size, elements must be default constructible and
+ * movable.
+ */
+export template <std::random_access_iterator It, typename Compare = std::less<>>
+    requires std::sortable<It, Compare>
+auto parallelSort( ThreadPool &pool, const It first, const It last, Compare comp = {} ) -> void {
+    const auto size = static_cast<size_t>( last - first );
+    if ( pool.size() == 0 || size <= kSortCutoff ) {
+        std::sort( first, last, comp );
+        return;
+    }
+
+    auto buffer = std::vector<std::iter_value_t<It>>( size );
+    mergeSort( pool, first, buffer.begin(), size, false, comp );
+}
+
+}  // namespace poller::pstd
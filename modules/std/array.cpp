@@ -34,8 +34,12 @@ public:
         return buffer_[index & mask_].load( std::memory_order_relaxed );
     }
 
-    [[nodiscard]] Array *Resize( const size_t bottom, const size_t top ) {
-        auto *array = new Array{ 2 * capacity_ };
+    [[nodiscard]] Array *Resize( const size_t bottom, const size_t top ) { return Resize( bottom, top, 2 * capacity_ ); }
+
+    // Copy of live items [top, bottom) into an array of given capacity,
+    // which must be a power of two larger than bottom - top.
+    [[nodiscard]] Array *Resize( const size_t bottom, const size_t top, const int capacity ) {
+        auto *array = new Array{ capacity };
         for ( auto i = top; i != bottom; ++i ) {
             array->Put( i, Get( i ) );
         }
@@ -0,0 +1,19 @@
+module;
+
+#include <cstddef>
+#include <new>
+
+export module poller_std:cacheline;
+
+namespace poller {
+
+// Alignment that keeps data written by different threads on separate
+// cache lines. Not every standard library provides the interference
+// size constants, 64 bytes fits x86-64 and most ARM cores.
+#ifdef __cpp_lib_hardware_interference_size
+constexpr size_t kCacheLine = std::hardware_destructive_interference_size;
+#else
+constexpr size_t kCacheLine = 64;
+#endif
+
+}  // namespace poller
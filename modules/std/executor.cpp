@@ -0,0 +1,67 @@
+module;
+
+#include <coroutine>
+#include <span>
+
+export module poller_std:executor;
+
+import :threadpool;
+
+namespace poller::pstd {
+
+/**
+ * \brief Decides where suspended coroutines continue.
+ *
+ * Producers of completions (Poller curl thread, event loops) collect
+ * ready coroutine handles and pass them in batches, one call per
+ * processing round.
+ */
+export struct Executor {
+    Executor() = default;
+
+    Executor( const Executor & ) = delete;
+    Executor( Executor && ) = delete;
+    auto operator=( const Executor & ) -> Executor & = delete;
+    auto operator=( Executor && ) -> Executor & = delete;
+
+    virtual ~Executor() = default;
+
+    virtual auto execute( std::span<const std::coroutine_handle<>> handles ) -> void = 0;
+};
+
+/**
+ * \brief Resumes coroutines right on the calling thread.
+ */
+export struct InlineExecutor final : Executor {
+    auto execute( std::span<const std::coroutine_handle<>> handles ) -> void override {
+        for ( const auto handle : handles ) {
+            handle.resume();
+        }
+    }
+};
+
+/**
+ * \brief Resumes coroutines on a `ThreadPool`, one task per coroutine.
+ *
+ * A batch is queued in one go and wakes the pool once, its continuations
+ * still run in parallel on as many workers as are idle.
+ *
+ * With `Priority::kHigh` completions overtake bulk work queued in the
+ * same pool instead of waiting behind it.
+ */
+export struct ThreadPoolExecutor final : Executor {
+    explicit ThreadPoolExecutor( ThreadPool &pool, Priority priority = Priority::kNormal )
+        : pool_{ pool }
+        , priority_{ priority } {}
+
+    auto execute( std::span<const std::coroutine_handle<>> handles ) -> void override {
+        //
+        pool_.resume( handles, priority_ );
+    }
+
+private:
+    ThreadPool &pool_;
+    Priority priority_;
+};
+
+}  // namespace poller::pstd
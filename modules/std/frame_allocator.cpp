@@ -0,0 +1,371 @@
+module;
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+export module poller_std:frame_allocator;
+
+import :cacheline;
+
+namespace poller::pstd {
+
+/**
+ * \brief Counters of the coroutine frame allocator, summed over all
+ * threads that ever allocated or released a frame.
+ */
+export struct FrameAllocatorStats {
+    // Frames handed out, including oversized ones.
+    uint64_t allocations{};
+    uint64_t deallocations{};
+    // Allocations served from a thread-local free list.
+    uint64_t reused{};
+    // Frames released on a thread other than the one that allocated them.
+    uint64_t remote_deallocations{};
+    // Frames too large for any size class, served by global operator new.
+    uint64_t oversized{};
+};
+
+// Size classes 64, 128, ..., 4096 bytes including the block header.
+constexpr size_t kMinClassShift = 6;
+constexpr size_t kClassesCount = 7;
+constexpr uint32_t kOversized = ~uint32_t{ 0 };
+
+// Per thread and class, small classes keep more blocks: ThreadPool closure
+// nodes come in bursts of thousands, frames of the biggest class rarely do.
+constexpr size_t kMaxCachedBytes = 256 * 1024;
+
+constexpr auto classSize( const size_t size_class ) -> size_t {
+    //
+    return size_t{ 1 } << ( kMinClassShift + size_class );
+}
+
+constexpr auto maxCachedBlocks( const size_t size_class ) -> size_t {
+    //
+    return kMaxCachedBytes / classSize( size_class );
+}
+
+constexpr auto sizeClassOf( const size_t total ) -> size_t {
+    if ( total <= classSize( 0 ) ) {
+        return 0;
+    }
+    return std::bit_width( total - 1 ) - kMinClassShift;
+}
+
+static_assert( sizeClassOf( 64 ) == 0 );
+static_assert( sizeClassOf( 65 ) == 1 );
+static_assert( sizeClassOf( 4096 ) == kClassesCount - 1 );
+static_assert( sizeClassOf( 4097 ) == kClassesCount );
+
+struct ThreadCache;
+
+// Every block starts with a header naming the thread cache it belongs to,
+// so it can be returned there from any thread. Header size keeps frames
+// aligned to default new alignment.
+struct alignas( __STDCPP_DEFAULT_NEW_ALIGNMENT__ ) BlockHeader {
+    ThreadCache *owner;
+    uint32_t size_class;
+};
+
+constexpr size_t kHeaderSize = sizeof( BlockHeader );
+
+// Free block, link overlaps the former frame.
+struct Block {
+    BlockHeader header;
+    Block *next;
+};
+
+// Only owner thread writes, stats() reads concurrently.
+auto bump( std::atomic<uint64_t> &counter ) -> void {
+    //
+    counter.store( counter.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+}
+
+auto rawAllocate( const size_t total ) -> BlockHeader * {
+    //
+    return static_cast<BlockHeader *>( ::operator new( total ) );
+}
+
+auto rawDeallocate( BlockHeader *header ) -> void {
+    //
+    ::operator delete( header );
+}
+
+struct ThreadCache {
+    auto allocate( const size_t size_class ) -> BlockHeader * {
+        auto *block = free_[size_class];
+        if ( !block ) {
+            drainRemote();
+            block = free_[size_class];
+        }
+
+        BlockHeader *header;
+        if ( block ) {
+            free_[size_class] = block->next;
+            --free_count_[size_class];
+            header = &block->header;
+            bump( reused_ );
+        } else {
+            header = rawAllocate( classSize( size_class ) );
+        }
+
+        header->owner = this;
+        header->size_class = static_cast<uint32_t>( size_class );
+        ++outstanding_;
+        bump( allocations_ );
+
+        return header;
+    }
+
+    auto deallocateLocal( BlockHeader *header ) -> void {
+        --outstanding_;
+        bump( deallocations_ );
+        cache( header );
+    }
+
+    // Called on a foreign thread, hands the block back to its owner.
+    auto deallocateRemote( BlockHeader *header ) -> void {
+        auto *block = reinterpret_cast<Block *>( header );
+        auto *head = remote_.load( std::memory_order_relaxed );
+        do {
+            if ( head == closed() ) {
+                // Owner thread has exited, last block out frees the cache.
+                rawDeallocate( header );
+                if ( orphaned_remaining_.fetch_sub( 1, std::memory_order_acq_rel ) == 1 ) {
+                    delete this;
+                }
+                return;
+            }
+            block->next = head;
+        } while (
+          !remote_.compare_exchange_weak( head, block, std::memory_order_release, std::memory_order_relaxed ) );
+    }
+
+    // Owner thread exit. Free lists go back to the global heap, blocks
+    // still in use elsewhere keep the cache alive until they come back.
+    auto close() -> void {
+        auto *block = remote_.exchange( closed(), std::memory_order_acq_rel );
+        while ( block ) {
+            auto *next = block->next;
+            --outstanding_;
+            rawDeallocate( &block->header );
+            block = next;
+        }
+
+        for ( size_t i = 0; i != kClassesCount; ++i ) {
+            while ( auto *free = free_[i] ) {
+                free_[i] = free->next;
+                rawDeallocate( &free->header );
+            }
+        }
+
+        // Cache may be deleted by a remote release right after fetch_add,
+        // don't read members past it.
+        const auto outstanding = outstanding_;
+        if ( orphaned_remaining_.fetch_add( outstanding, std::memory_order_acq_rel ) + outstanding == 0 ) {
+            delete this;
+        }
+    }
+
+    auto collect( FrameAllocatorStats &stats ) const -> void {
+        stats.allocations += allocations_.load( std::memory_order_relaxed );
+        stats.deallocations += deallocations_.load( std::memory_order_relaxed );
+        stats.reused += reused_.load( std::memory_order_relaxed );
+        stats.remote_deallocations += remote_deallocations_.load( std::memory_order_relaxed );
+        stats.oversized += oversized_.load( std::memory_order_relaxed );
+    }
+
+    std::atomic<uint64_t> allocations_{ 0 };
+    std::atomic<uint64_t> deallocations_{ 0 };
+    std::atomic<uint64_t> reused_{ 0 };
+    std::atomic<uint64_t> remote_deallocations_{ 0 };
+    std::atomic<uint64_t> oversized_{ 0 };
+
+private:
+    static auto closed() -> Block * {
+        //
+        return reinterpret_cast<Block *>( uintptr_t{ 1 } );
+    }
+
+    auto cache( BlockHeader *header ) -> void {
+        const auto size_class = header->size_class;
+        if ( free_count_[size_class] == maxCachedBlocks( size_class ) ) {
+            rawDeallocate( header );
+            return;
+        }
+
+        auto *block = reinterpret_cast<Block *>( header );
+        block->next = free_[size_class];
+        free_[size_class] = block;
+        ++free_count_[size_class];
+    }
+
+    auto drainRemote() -> void {
+        auto *block = remote_.exchange( nullptr, std::memory_order_acquire );
+        while ( block ) {
+            auto *next = block->next;
+            --outstanding_;
+            cache( &block->header );
+            block = next;
+        }
+    }
+
+    Block *free_[kClassesCount]{};
+    size_t free_count_[kClassesCount]{};
+
+    // Blocks allocated here and not yet returned, owner thread only.
+    int64_t outstanding_{};
+
+    // Blocks returned by other threads; closed() once owner has exited.
+    alignas( kCacheLine ) std::atomic<Block *> remote_{ nullptr };
+    std::atomic<int64_t> orphaned_remaining_{ 0 };
+};
+
+// Live caches for stats(), counters of exited threads are folded into retired_.
+struct Registry {
+    auto add( ThreadCache *cache ) -> void {
+        std::lock_guard _{ lock_ };
+        caches_.push_back( cache );
+    }
+
+    auto remove( ThreadCache *cache ) -> void {
+        std::lock_guard _{ lock_ };
+        cache->collect( retired_ );
+        std::erase( caches_, cache );
+    }
+
+    auto stats() -> FrameAllocatorStats {
+        std::lock_guard _{ lock_ };
+        auto result = retired_;
+        for ( const auto *cache : caches_ ) {
+            cache->collect( result );
+        }
+        return result;
+    }
+
+private:
+    std::mutex lock_;
+    std::vector<ThreadCache *> caches_;
+    FrameAllocatorStats retired_{};
+};
+
+auto registry() -> Registry & {
+    static Registry instance{};
+    return instance;
+}
+
+// Trivially destructible, stays valid while other thread_local
+// destructors run after the cache was closed.
+thread_local ThreadCache *current_{ nullptr };
+thread_local bool exited_{ false };
+
+struct LocalCache {
+    LocalCache() {
+        current_ = new ThreadCache{};
+        registry().add( current_ );
+    }
+
+    ~LocalCache() {
+        auto *cache = std::exchange( current_, nullptr );
+        exited_ = true;
+        registry().remove( cache );
+        cache->close();
+    }
+};
+
+auto localCache() -> ThreadCache * {
+    if ( current_ ) [[likely]] {
+        return current_;
+    }
+    if ( exited_ ) {
+        return nullptr;
+    }
+    static thread_local LocalCache local{};
+    return current_;
+}
+
+/**
+ * \brief Size-class allocator for coroutine frames.
+ *
+ * Each thread keeps free lists of recently released frames per size class,
+ * allocation and release on the same thread touch no shared state. A frame
+ * released on another thread goes back to its owner through a lock-free
+ * list and is reused by the owner on its next allocation miss. Frames
+ * larger than the biggest size class go straight to global operator new.
+ */
+export struct FrameAllocator {
+    static constexpr size_t kMaxPooledSize = classSize( kClassesCount - 1 ) - kHeaderSize;
+
+    [[nodiscard]]
+    static auto allocate( const size_t size ) -> void * {
+        auto *cache = localCache();
+        const auto size_class = sizeClassOf( size + kHeaderSize );
+
+        if ( size_class >= kClassesCount || !cache ) [[unlikely]] {
+            auto *header = rawAllocate( size + kHeaderSize );
+            header->owner = nullptr;
+            header->size_class = kOversized;
+            if ( cache ) {
+                bump( cache->allocations_ );
+                bump( cache->oversized_ );
+            }
+            return reinterpret_cast<std::byte *>( header ) + kHeaderSize;
+        }
+
+        return reinterpret_cast<std::byte *>( cache->allocate( size_class ) ) + kHeaderSize;
+    }
+
+    static auto deallocate( void *ptr ) noexcept -> void {
+        auto *header = reinterpret_cast<BlockHeader *>( static_cast<std::byte *>( ptr ) - kHeaderSize );
+        auto *owner = header->owner;
+        auto *cache = localCache();
+
+        if ( owner == cache && owner ) [[likely]] {
+            owner->deallocateLocal( header );
+            return;
+        }
+
+        if ( cache ) {
+            bump( cache->deallocations_ );
+        }
+
+        if ( !owner ) {
+            rawDeallocate( header );
+            return;
+        }
+
+        if ( cache ) {
+            bump( cache->remote_deallocations_ );
+        }
+        owner->deallocateRemote( header );
+    }
+
+    [[nodiscard]]
+    static auto stats() -> FrameAllocatorStats {
+        //
+        return registry().stats();
+    }
+};
+
+/**
+ * \brief Base for coroutine promise types, routes frame allocation through
+ * `FrameAllocator`.
+ */
+export struct PooledFrame {
+    static auto operator new( const size_t size ) -> void * {
+        //
+        return FrameAllocator::allocate( size );
+    }
+
+    static auto operator delete( void *ptr, size_t ) noexcept -> void {
+        //
+        FrameAllocator::deallocate( ptr );
+    }
+};
+
+}  // namespace poller::pstd
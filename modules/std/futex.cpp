@@ -0,0 +1,89 @@
+module;
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined( __linux__ )
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#endif
+
+export module poller_std:futex;
+
+namespace poller::pstd {
+
+// Spin-wait hint, lets sibling hyperthread run while we poll.
+export inline auto cpuRelax() noexcept -> void {
+#if defined( __x86_64__ ) || defined( __i386__ )
+    __builtin_ia32_pause();
+#elif defined( __aarch64__ )
+    asm volatile( "yield" );
+#endif
+}
+
+/**
+ * \brief Parks the calling thread while `word` equals `expected`.
+ *
+ * Thin wrapper over Linux futex, other platforms fall back to
+ * `std::atomic::wait` (no timeout) or sleep polling (with timeout).
+ * Spurious wakeups are possible, callers re-check their condition.
+ *
+ * \return `false` if timeout expired.
+ */
+export inline auto futexWait(
+  std::atomic<uint32_t> &word, uint32_t expected, std::chrono::nanoseconds timeout = std::chrono::nanoseconds::max() )
+  -> bool {
+#if defined( __linux__ )
+    auto ts = timespec{};
+    auto *tsPtr = static_cast<timespec *>( nullptr );
+    if ( timeout != std::chrono::nanoseconds::max() ) {
+        if ( timeout <= std::chrono::nanoseconds::zero() ) {
+            return false;
+        }
+        ts.tv_sec = static_cast<time_t>( timeout.count() / 1'000'000'000 );
+        ts.tv_nsec = static_cast<long>( timeout.count() % 1'000'000'000 );
+        tsPtr = &ts;
+    }
+
+    const auto res = syscall(
+      SYS_futex, reinterpret_cast<uint32_t *>( &word ), FUTEX_WAIT_PRIVATE, expected, tsPtr, nullptr, 0 );
+
+    return res == 0 || errno != ETIMEDOUT;
+#else
+    if ( timeout == std::chrono::nanoseconds::max() ) {
+        word.wait( expected, std::memory_order_acquire );
+        return true;
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while ( word.load( std::memory_order_acquire ) == expected ) {
+        if ( std::chrono::steady_clock::now() >= deadline ) {
+            return false;
+        }
+        std::this_thread::sleep_for( std::chrono::microseconds{ 50 } );
+    }
+    return true;
+#endif
+}
+
+// Wake up to `count` threads parked on `word`. Callers must keep the word
+// alive until this returns: the futex syscall only uses the address as a
+// key, but the atomic notify fallback dereferences it.
+export inline auto futexWake( std::atomic<uint32_t> &word, int count = 1 ) -> void {
+#if defined( __linux__ )
+    syscall( SYS_futex, reinterpret_cast<uint32_t *>( &word ), FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0 );
+#else
+    if ( count == 1 ) {
+        word.notify_one();
+    } else {
+        word.notify_all();
+    }
+#endif
+}
+
+}  // namespace poller::pstd
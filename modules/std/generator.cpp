@@ -0,0 +1,268 @@
+module;
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+export module poller_std:generator;
+
+import :frame_allocator;
+
+namespace poller::pstd {
+
+export template <typename T>
+struct AsyncGenerator;
+
+/**
+ * \brief Promise of `AsyncGenerator`, frame is pooled and nothing is
+ * allocated per element.
+ *
+ * Yielded value is not copied: promise stores its address and the
+ * producer stays suspended inside the `co_yield` full-expression until
+ * the consumer asks for the next one, so temporaries are still alive
+ * while consumer looks at them.
+ */
+template <typename T>
+struct AsyncGeneratorPromise final : PooledFrame {
+public:
+    using value_type = std::remove_reference_t<T>;
+    using pointer_type = std::add_pointer_t<value_type>;
+
+    // Hands control back to the consumer, no stack growth on either side.
+    struct YieldAwaiter final {
+        [[nodiscard]]
+        auto await_ready() const noexcept -> bool {
+            //
+            return false;
+        }
+
+        auto await_suspend( std::coroutine_handle<AsyncGeneratorPromise> handle ) const noexcept
+          -> std::coroutine_handle<> {
+            //
+            return handle.promise().consumer_;
+        }
+
+        auto await_resume() const noexcept -> void {
+            //
+        }
+    };
+
+    auto get_return_object() noexcept -> AsyncGenerator<T>;
+
+    // Lazy, producer runs only when consumer awaits the first element.
+    auto initial_suspend() const noexcept -> std::suspend_always {
+        //
+        return {};
+    }
+
+    auto final_suspend() noexcept -> YieldAwaiter {
+        current_ = nullptr;
+        return {};
+    }
+
+    auto yield_value( value_type &value ) noexcept -> YieldAwaiter {
+        current_ = std::addressof( value );
+        return {};
+    }
+
+    auto yield_value( value_type &&value ) noexcept -> YieldAwaiter {
+        current_ = std::addressof( value );
+        return {};
+    }
+
+    auto return_void() noexcept -> void {
+        //
+    }
+
+    auto unhandled_exception() noexcept -> void {
+        //
+        exception_ = std::current_exception();
+    }
+
+    auto rethrowIfFailed() const -> void {
+        if ( exception_ ) {
+            std::rethrow_exception( exception_ );
+        }
+    }
+
+public:
+    std::coroutine_handle<> consumer_{ nullptr };
+    pointer_type current_{ nullptr };
+    std::exception_ptr exception_{ nullptr };
+};
+
+/**
+ * \brief Coroutine producing a sequence of values over time.
+ *
+ * Producer body may `co_await` anything (poller requests, io timers,
+ * channels) and `co_yield` each element. Consumer is any coroutine,
+ * `poller::Task`, `io::Task` or another generator:
+ *
+ *   auto lines( Scheduler &loop, std::string path ) -> AsyncGenerator<std::string> {
+ *       while ( ... ) {
+ *           co_await loop.watchFile( path );
+ *           co_yield readNewLine( path );
+ *       }
+ *   }
+ *
+ *   for ( auto it = co_await gen.begin(); it != gen.end(); co_await ++it ) {
+ *       process( *it );
+ *   }
+ *
+ * or, without iterators:
+ *
+ *   while ( auto *line = co_await gen.next() ) { process( *line ); }
+ *
+ * Generator owns the frame, destroying it mid-sequence is fine while the
+ * producer is suspended at co_yield. Single consumer, only one element
+ * request may be in flight.
+ */
+export template <typename T>
+struct AsyncGenerator final {
+public:
+    using promise_type = AsyncGeneratorPromise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+    using value_type = typename promise_type::value_type;
+    using pointer_type = typename promise_type::pointer_type;
+
+    // Resumes producer until it yields next element or finishes.
+    struct NextAwaiter {
+        [[nodiscard]]
+        auto await_ready() const noexcept -> bool {
+            //
+            return !handle_ || handle_.done();
+        }
+
+        auto await_suspend( std::coroutine_handle<> consumer ) const noexcept -> std::coroutine_handle<> {
+            handle_.promise().consumer_ = consumer;
+            return handle_;
+        }
+
+        // nullptr once sequence is over, rethrows producer exception.
+        auto await_resume() const -> pointer_type {
+            if ( !handle_ ) {
+                return nullptr;
+            }
+            handle_.promise().rethrowIfFailed();
+            return handle_.promise().current_;
+        }
+
+        handle_type handle_;
+    };
+
+    struct Iterator final {
+        using iterator_category = std::input_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+        using value_type = AsyncGenerator::value_type;
+        using reference = value_type &;
+        using pointer = pointer_type;
+
+        struct IncrementAwaiter final : NextAwaiter {
+            auto await_resume() const -> Iterator & {
+                iterator_.current_ = NextAwaiter::await_resume();
+                return iterator_;
+            }
+
+            Iterator &iterator_;
+        };
+
+        // co_await ++it;
+        auto operator++() noexcept -> IncrementAwaiter {
+            //
+            return IncrementAwaiter{ { handle_ }, *this };
+        }
+
+        [[nodiscard]]
+        auto operator*() const noexcept -> reference {
+            //
+            return *current_;
+        }
+
+        [[nodiscard]]
+        auto operator->() const noexcept -> pointer {
+            //
+            return current_;
+        }
+
+        [[nodiscard]]
+        auto operator==( std::default_sentinel_t ) const noexcept -> bool {
+            //
+            return current_ == nullptr;
+        }
+
+        handle_type handle_{ nullptr };
+        pointer_type current_{ nullptr };
+    };
+
+    struct BeginAwaiter final : NextAwaiter {
+        auto await_resume() const -> Iterator {
+            //
+            return Iterator{ this->handle_, NextAwaiter::await_resume() };
+        }
+    };
+
+    AsyncGenerator() noexcept = default;
+
+    explicit AsyncGenerator( handle_type handle ) noexcept
+        : handle_{ handle } {
+        /* noop */
+    }
+
+    AsyncGenerator( AsyncGenerator &&other ) noexcept
+        : handle_{ std::exchange( other.handle_, nullptr ) } {
+        /* noop */
+    }
+
+    auto operator=( AsyncGenerator &&other ) noexcept -> AsyncGenerator & {
+        if ( std::addressof( other ) != this ) {
+            if ( handle_ ) {
+                handle_.destroy();
+            }
+            handle_ = std::exchange( other.handle_, nullptr );
+        }
+        return *this;
+    }
+
+    AsyncGenerator( const AsyncGenerator & ) = delete;
+    auto operator=( const AsyncGenerator & ) -> AsyncGenerator & = delete;
+
+    ~AsyncGenerator() {
+        if ( handle_ ) {
+            handle_.destroy();
+        }
+    }
+
+    // auto *value = co_await gen.next();
+    [[nodiscard]]
+    auto next() noexcept -> NextAwaiter {
+        //
+        return NextAwaiter{ handle_ };
+    }
+
+    // auto it = co_await gen.begin();
+    [[nodiscard]]
+    auto begin() noexcept -> BeginAwaiter {
+        //
+        return BeginAwaiter{ { handle_ } };
+    }
+
+    [[nodiscard]]
+    auto end() const noexcept -> std::default_sentinel_t {
+        //
+        return std::default_sentinel;
+    }
+
+private:
+    handle_type handle_{ nullptr };
+};
+
+template <typename T>
+auto AsyncGeneratorPromise<T>::get_return_object() noexcept -> AsyncGenerator<T> {
+    //
+    return AsyncGenerator<T>{ std::coroutine_handle<AsyncGeneratorPromise>::from_promise( *this ) };
+}
+
+}  // namespace poller::pstd
@@ -0,0 +1,445 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+export module poller_std:profiler;
+
+import :cacheline;
+
+namespace poller::pstd {
+
+/**
+ * \brief Whether `ThreadPool` records its scheduling events.
+ *
+ * Set by configuring with `-DPOLLER_THREADPOOL_PROFILING=ON`. When off the
+ * pool holds an empty `NullProfiler` and every hook sits behind
+ * `if constexpr`, not even a clock read is left in the task path.
+ */
+#ifdef POLLER_THREADPOOL_PROFILING
+export inline constexpr bool kThreadPoolProfiling = true;
+#else
+export inline constexpr bool kThreadPoolProfiling = false;
+#endif
+
+// Events kept per queue, older ones are overwritten. 32 bytes each.
+constexpr size_t kProfileRingCapacity = 1 << 14;
+
+// Queue depth buckets of the summary: 0, 1, 2-3, 4-7, ... and the last
+// one takes everything deeper.
+constexpr size_t kDepthBuckets = 16;
+
+export enum class ProfileEventKind : uint8_t {
+    // Worker ran a task, depth_ is its own deque size at start.
+    kTask,
+    // Worker took work from victim_, depth_ is how many items it got.
+    kSteal,
+    // Worker had nothing to run, spinning or parked.
+    kIdle,
+};
+
+export struct ProfileEvent final {
+    ProfileEventKind kind_;
+    // Queue index, 0 stands for every non-worker thread.
+    unsigned worker_;
+    unsigned victim_;
+    unsigned depth_;
+    // Nanoseconds since the pool was created, equal for steals.
+    uint64_t begin_;
+    uint64_t end_;
+};
+
+/**
+ * \brief Fixed size event log of one queue.
+ *
+ * Writers never wait: an event claims the next slot and overwrites the
+ * oldest one. Every slot is a small seqlock, a reader running next to
+ * the workers skips slots being rewritten instead of reading them torn.
+ * Queue 0 is shared by all non-worker threads, the claim is a fetch_add
+ * so they don't lose events either.
+ */
+class ProfileRing final {
+public:
+    ProfileRing()
+        : slots_( kProfileRingCapacity ) {
+        /* noop */
+    }
+
+    ProfileRing( const ProfileRing & ) = delete;
+    ProfileRing( ProfileRing && ) = delete;
+    auto operator=( const ProfileRing & ) -> ProfileRing & = delete;
+    auto operator=( ProfileRing && ) -> ProfileRing & = delete;
+
+    auto record( const ProfileEvent &event ) noexcept -> void {
+        const auto index = head_.fetch_add( 1, std::memory_order_relaxed );
+        auto &slot = slots_[index & ( kProfileRingCapacity - 1 )];
+
+        slot.sequence_.store( 0, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_release );
+        slot.begin_.store( event.begin_, std::memory_order_relaxed );
+        slot.end_.store( event.end_, std::memory_order_relaxed );
+        slot.packed_.store( pack( event ), std::memory_order_relaxed );
+        slot.sequence_.store( index + 1, std::memory_order_release );
+    }
+
+    // Appends events still in the ring, oldest first.
+    auto collect( const unsigned worker, std::vector<ProfileEvent> &events ) const -> void {
+        const auto head = head_.load( std::memory_order_acquire );
+        for ( auto index = first( head ); index != head; ++index ) {
+            const auto &slot = slots_[index & ( kProfileRingCapacity - 1 )];
+
+            const auto sequence = slot.sequence_.load( std::memory_order_acquire );
+            const auto begin = slot.begin_.load( std::memory_order_relaxed );
+            const auto end = slot.end_.load( std::memory_order_relaxed );
+            const auto packed = slot.packed_.load( std::memory_order_relaxed );
+            std::atomic_thread_fence( std::memory_order_acquire );
+            if ( sequence != index + 1 || slot.sequence_.load( std::memory_order_relaxed ) != sequence ) {
+                // Not written yet or overwritten while we looked.
+                continue;
+            }
+
+            events.push_back( ProfileEvent{
+              .kind_ = static_cast<ProfileEventKind>( packed & 0xff ),
+              .worker_ = worker,
+              .victim_ = static_cast<unsigned>( ( packed >> 8 ) & 0xffffff ),
+              .depth_ = static_cast<unsigned>( packed >> 32 ),
+              .begin_ = begin,
+              .end_ = end,
+            } );
+        }
+    }
+
+    // Events lost to wrap-around so far.
+    [[nodiscard]]
+    auto dropped() const noexcept -> uint64_t {
+        //
+        return first( head_.load( std::memory_order_relaxed ) );
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence_{ 0 };
+        std::atomic<uint64_t> begin_{ 0 };
+        std::atomic<uint64_t> end_{ 0 };
+        std::atomic<uint64_t> packed_{ 0 };
+    };
+
+    static auto first( const uint64_t head ) noexcept -> uint64_t {
+        //
+        return head > kProfileRingCapacity ? head - kProfileRingCapacity : 0;
+    }
+
+    static auto pack( const ProfileEvent &event ) noexcept -> uint64_t {
+        return static_cast<uint64_t>( event.kind_ ) | static_cast<uint64_t>( event.victim_ & 0xffffff ) << 8 |
+               static_cast<uint64_t>( event.depth_ ) << 32;
+    }
+
+    std::vector<Slot> slots_;
+    alignas( kCacheLine ) std::atomic<uint64_t> head_{ 0 };
+};
+
+/**
+ * \brief Aggregated view of the recorded events.
+ *
+ * Covers only what is still in the rings, `dropped_` tells how much of the
+ * history is gone. Nested tasks, e.g. a worker helping inside
+ * `GraphRun::wait()`, are counted once towards busy time.
+ */
+export struct ProfileSummary final {
+    struct Worker {
+        uint64_t tasks_{ 0 };
+        uint64_t steals_{ 0 };
+        // Nanoseconds.
+        uint64_t busy_{ 0 };
+        uint64_t idle_{ 0 };
+        // busy_ over span_.
+        double utilization_{ 0.0 };
+    };
+
+    // Index is the queue index, 0 are non-worker threads.
+    std::vector<Worker> workers_{};
+    // Nanoseconds from the first to the last retained event.
+    uint64_t span_{ 0 };
+    uint64_t tasks_{ 0 };
+    uint64_t steals_{ 0 };
+    // Steals per executed task.
+    double steal_ratio_{ 0.0 };
+    // Own deque depth seen by each task when it started, see kDepthBuckets.
+    std::array<uint64_t, kDepthBuckets> depth_{};
+    uint64_t dropped_{ 0 };
+
+    [[nodiscard]]
+    auto toString() const -> std::string {
+        auto out = std::string{};
+        auto it = std::back_inserter( out );
+
+        std::format_to(
+          it, "span {:.3f} ms, {} tasks, {} steals, steal ratio {:.3f}, {} events dropped\n", span_ / 1e6, tasks_,
+          steals_, steal_ratio_, dropped_ );
+
+        std::format_to( it, "{:>6} {:>10} {:>8} {:>10} {:>10} {:>6}\n", "worker", "tasks", "steals", "busy ms",
+                        "idle ms", "util" );
+        for ( size_t i = 0; i != workers_.size(); ++i ) {
+            const auto &w = workers_[i];
+            std::format_to( it, "{:>6} {:>10} {:>8} {:>10.3f} {:>10.3f} {:>5.1f}%\n", i, w.tasks_, w.steals_,
+                            w.busy_ / 1e6, w.idle_ / 1e6, w.utilization_ * 100.0 );
+        }
+
+        std::format_to( it, "queue depth at task start\n" );
+        for ( size_t k = 0; k != depth_.size(); ++k ) {
+            if ( depth_[k] == 0 ) {
+                continue;
+            }
+            if ( k < 2 ) {
+                std::format_to( it, "{:>13} {}\n", k, depth_[k] );
+            } else if ( k + 1 == depth_.size() ) {
+                std::format_to( it, "{:>12}+ {}\n", 1u << ( k - 1 ), depth_[k] );
+            } else {
+                std::format_to( it, "{:>6}-{:<6} {}\n", 1u << ( k - 1 ), ( 1u << k ) - 1, depth_[k] );
+            }
+        }
+        return out;
+    }
+};
+
+/**
+ * \brief Per-queue event rings of a `ThreadPool`.
+ *
+ *   ThreadPool pool{ 8 };
+ *   ...
+ *   std::ofstream{ "pool.json" } << pool.profiler().chromeTrace();
+ *   std::print( "{}", pool.profiler().summary().toString() );
+ *
+ * Trace opens in chrome://tracing or ui.perfetto.dev, one track per queue.
+ * Reading is safe while the pool runs, a quiet pool gives an exact picture.
+ */
+export class ThreadPoolProfiler final {
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    explicit ThreadPoolProfiler( const unsigned queues )
+        : rings_( queues )
+        , start_{ clock_type::now() } {
+        /* noop */
+    }
+
+    ThreadPoolProfiler( const ThreadPoolProfiler & ) = delete;
+    ThreadPoolProfiler( ThreadPoolProfiler && ) = delete;
+    auto operator=( const ThreadPoolProfiler & ) -> ThreadPoolProfiler & = delete;
+    auto operator=( ThreadPoolProfiler && ) -> ThreadPoolProfiler & = delete;
+
+    [[nodiscard]]
+    auto now() const noexcept -> uint64_t {
+        //
+        return static_cast<uint64_t>( std::chrono::nanoseconds{ clock_type::now() - start_ }.count() );
+    }
+
+    auto task( const unsigned worker, const uint64_t begin, const uint64_t end, const unsigned depth ) noexcept
+      -> void {
+        //
+        rings_[worker].record( { ProfileEventKind::kTask, worker, 0, depth, begin, end } );
+    }
+
+    auto steal( const unsigned worker, const unsigned victim, const unsigned count, const uint64_t at ) noexcept
+      -> void {
+        //
+        rings_[worker].record( { ProfileEventKind::kSteal, worker, victim, count, at, at } );
+    }
+
+    auto idle( const unsigned worker, const uint64_t begin, const uint64_t end ) noexcept -> void {
+        //
+        rings_[worker].record( { ProfileEventKind::kIdle, worker, 0, 0, begin, end } );
+    }
+
+    // Retained events of all queues ordered by start time.
+    [[nodiscard]]
+    auto events() const -> std::vector<ProfileEvent> {
+        auto events = std::vector<ProfileEvent>{};
+        for ( unsigned i = 0; i != rings_.size(); ++i ) {
+            rings_[i].collect( i, events );
+        }
+        std::ranges::stable_sort( events, {}, &ProfileEvent::begin_ );
+        return events;
+    }
+
+    [[nodiscard]]
+    auto dropped() const noexcept -> uint64_t {
+        uint64_t dropped = 0;
+        for ( const auto &ring : rings_ ) {
+            dropped += ring.dropped();
+        }
+        return dropped;
+    }
+
+    // Chrome trace event format, tasks and idle intervals are complete
+    // ("X") events, steals are instant ("i") ones.
+    [[nodiscard]]
+    auto chromeTrace() const -> std::string {
+        auto out = std::string{ R"({"displayTimeUnit":"ns","traceEvents":[)" };
+        auto it = std::back_inserter( out );
+
+        for ( unsigned i = 0; i != rings_.size(); ++i ) {
+            std::format_to(
+              it, R"({}{{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"{}"}}}})", i == 0 ? "" : ",",
+              i, i == 0 ? std::string{ "external" } : std::format( "worker {}", i ) );
+        }
+
+        for ( const auto &event : events() ) {
+            switch ( event.kind_ ) {
+                case ProfileEventKind::kTask: {
+                    std::format_to(
+                      it,
+                      R"(,{{"name":"task","cat":"task","ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f},"args":{{"depth":{}}}}})",
+                      event.worker_, event.begin_ / 1e3, ( event.end_ - event.begin_ ) / 1e3, event.depth_ );
+                    break;
+                }
+                case ProfileEventKind::kSteal: {
+                    std::format_to(
+                      it,
+                      R"(,{{"name":"steal","cat":"steal","ph":"i","s":"t","pid":1,"tid":{},"ts":{:.3f},"args":{{"victim":{},"count":{}}}}})",
+                      event.worker_, event.begin_ / 1e3, event.victim_, event.depth_ );
+                    break;
+                }
+                case ProfileEventKind::kIdle: {
+                    std::format_to(
+                      it, R"(,{{"name":"idle","cat":"idle","ph":"X","pid":1,"tid":{},"ts":{:.3f},"dur":{:.3f}}})",
+                      event.worker_, event.begin_ / 1e3, ( event.end_ - event.begin_ ) / 1e3 );
+                    break;
+                }
+            }
+        }
+
+        out += "]}";
+        return out;
+    }
+
+    [[nodiscard]]
+    auto summary() const -> ProfileSummary {
+        auto summary = ProfileSummary{};
+        summary.workers_.resize( rings_.size() );
+        summary.dropped_ = dropped();
+
+        const auto events = this->events();
+        if ( events.empty() ) {
+            return summary;
+        }
+
+        auto first = events.front().begin_;
+        auto last = first;
+        // Busy time is the union of task intervals, events are sorted by
+        // start so a task nested in another one ends before its parent.
+        auto busyUntil = std::vector<uint64_t>( rings_.size(), 0 );
+        for ( const auto &event : events ) {
+            auto &worker = summary.workers_[event.worker_];
+            last = std::max( last, event.end_ );
+            switch ( event.kind_ ) {
+                case ProfileEventKind::kTask: {
+                    ++worker.tasks_;
+                    auto &until = busyUntil[event.worker_];
+                    if ( event.end_ > until ) {
+                        worker.busy_ += event.end_ - std::max( event.begin_, until );
+                        until = event.end_;
+                    }
+                    const auto bucket = std::min<size_t>( std::bit_width( event.depth_ ), kDepthBuckets - 1 );
+                    ++summary.depth_[bucket];
+                    break;
+                }
+                case ProfileEventKind::kSteal: {
+                    ++worker.steals_;
+                    break;
+                }
+                case ProfileEventKind::kIdle: {
+                    worker.idle_ += event.end_ - event.begin_;
+                    break;
+                }
+            }
+        }
+
+        summary.span_ = last - first;
+        for ( auto &worker : summary.workers_ ) {
+            summary.tasks_ += worker.tasks_;
+            summary.steals_ += worker.steals_;
+            if ( summary.span_ != 0 ) {
+                worker.utilization_ = static_cast<double>( worker.busy_ ) / static_cast<double>( summary.span_ );
+            }
+        }
+        if ( summary.tasks_ != 0 ) {
+            summary.steal_ratio_ = static_cast<double>( summary.steals_ ) / static_cast<double>( summary.tasks_ );
+        }
+        return summary;
+    }
+
+private:
+    std::vector<ProfileRing> rings_;
+    const clock_type::time_point start_;
+};
+
+/**
+ * \brief Stand-in for `ThreadPoolProfiler` in builds without profiling.
+ *
+ * Empty, so with [[no_unique_address]] it takes no room in the pool,
+ * and the queries return empty results.
+ */
+export class NullProfiler final {
+public:
+    explicit NullProfiler( const unsigned ) noexcept {
+        /* noop */
+    }
+
+    [[nodiscard]]
+    auto now() const noexcept -> uint64_t {
+        //
+        return 0;
+    }
+
+    auto task( const unsigned, const uint64_t, const uint64_t, const unsigned ) noexcept -> void {
+        //
+    }
+
+    auto steal( const unsigned, const unsigned, const unsigned, const uint64_t ) noexcept -> void {
+        //
+    }
+
+    auto idle( const unsigned, const uint64_t, const uint64_t ) noexcept -> void {
+        //
+    }
+
+    [[nodiscard]]
+    auto events() const -> std::vector<ProfileEvent> {
+        //
+        return {};
+    }
+
+    [[nodiscard]]
+    auto dropped() const noexcept -> uint64_t {
+        //
+        return 0;
+    }
+
+    [[nodiscard]]
+    auto chromeTrace() const -> std::string {
+        //
+        return R"({"displayTimeUnit":"ns","traceEvents":[]})";
+    }
+
+    [[nodiscard]]
+    auto summary() const -> ProfileSummary {
+        //
+        return {};
+    }
+};
+
+export using ThreadPoolProfilerType = std::conditional_t<kThreadPoolProfiling, ThreadPoolProfiler, NullProfiler>;
+
+}  // namespace poller::pstd
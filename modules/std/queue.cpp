@@ -1,58 +1,359 @@
 
 module;
 
+#include <algorithm>
 #include <atomic>
+#include <bit>
 #include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
 #include <vector>
 #include <thread>
 #include <semaphore>
+#include <utility>
 
 export module poller_std:queue;
 
+import :cacheline;
+import :futex;
+
 namespace poller {
 
+// Polls before a blocking call parks on its futex word.
+constexpr unsigned kQueueSpins = 64;
+
+// Bounded single-producer single-consumer ring.
+//
+// Indices run freely and are masked on access, so all `capacity` slots
+// are usable. Each side owns a cache line with its index and the last
+// seen index of the other side, and reloads the shared one only when the
+// cached value says the ring is full or empty, so in steady state a push
+// or pop touches no line the other thread writes.
+//
+// push_blocking() and pop_blocking() park on a futex when the ring is
+// full or empty and wake the other side's blocking call. A thread parked
+// in one of them is woken only by the blocking calls of the other side,
+// plain push and pop skip the fence that takes.
 export template <typename T>
 struct spsc_lock_free_queue {
 public:
     // capacity must be power of two to avoid using modulo operator
     // when calculating the index
     explicit spsc_lock_free_queue( size_t capacity )
-        : capacity_( capacity )
-        , buffer_( capacity ) {
-        //assert((capacity & (capacity - 1)) == 0 && "capacity must be a
-        //power of 2");
+        : mask_( capacity - 1 )
+        , slots_( std::make_unique<slot[]>( capacity ) ) {
+        assert( capacity != 0 && ( capacity & ( capacity - 1 ) ) == 0 && "capacity must be a power of 2" );
     }
 
     spsc_lock_free_queue( const spsc_lock_free_queue & ) = delete;
     spsc_lock_free_queue &operator=( const spsc_lock_free_queue & ) = delete;
 
-    auto push( const T &item ) -> bool {
-        std::size_t next_tail = ( tail_ + 1 ) & ( capacity_ - 1 );
-        std::size_t tail = tail_.load( std::memory_order_relaxed );
-        if ( next_tail != head_.load( std::memory_order_acquire ) ) {
-            buffer_[tail] = item;
-            tail_.store( next_tail, std::memory_order_release );
-            return true;
+    ~spsc_lock_free_queue() {
+        const auto tail = tail_.load( std::memory_order_relaxed );
+        for ( auto pos = head_.load( std::memory_order_relaxed ); pos != tail; ++pos ) {
+            std::destroy_at( slots_[pos & mask_].item() );
+        }
+    }
+
+    // Constructs item in place, arguments are left untouched on failure.
+    template <typename... Args>
+    auto try_emplace( Args &&...args ) -> bool {
+        const auto tail = tail_.load( std::memory_order_relaxed );
+        if ( tail - head_cache_ > mask_ ) {
+            head_cache_ = head_.load( std::memory_order_acquire );
+            if ( tail - head_cache_ > mask_ ) {
+                return false;
+            }
         }
-        return false;
+        std::construct_at( slots_[tail & mask_].item(), std::forward<Args>( args )... );
+        tail_.store( tail + 1, std::memory_order_release );
+        return true;
+    }
+
+    auto push( const T &item ) -> bool {
+        //
+        return try_emplace( item );
+    }
+
+    auto push( T &&item ) -> bool {
+        //
+        return try_emplace( std::move( item ) );
     }
 
     auto pop( T &item ) -> bool {
-        std::size_t head = head_.load( std::memory_order_relaxed );
-        if ( head == tail_.load( std::memory_order_acquire ) ) {
-            return false;
+        const auto head = head_.load( std::memory_order_relaxed );
+        if ( head == tail_cache_ ) {
+            tail_cache_ = tail_.load( std::memory_order_acquire );
+            if ( head == tail_cache_ ) {
+                return false;
+            }
         }
-        item = buffer_[head];
-        head_.store( ( head + 1 ) & ( capacity_ - 1 ), std::memory_order_release );
+        auto *slot = slots_[head & mask_].item();
+        item = std::move( *slot );
+        std::destroy_at( slot );
+        head_.store( head + 1, std::memory_order_release );
         return true;
     }
 
+    // Pushes up to `count` items from `first` with one index update.
+    // \return Number of items pushed, 0 when the ring is full.
+    template <std::input_iterator It>
+    auto push_n( It first, size_t count ) -> size_t {
+        const auto tail = tail_.load( std::memory_order_relaxed );
+        if ( capacity() - ( tail - head_cache_ ) < count ) {
+            head_cache_ = head_.load( std::memory_order_acquire );
+        }
+        const auto n = std::min( count, capacity() - ( tail - head_cache_ ) );
+        size_t i = 0;
+        try {
+            for ( ; i != n; ++i, ++first ) {
+                std::construct_at( slots_[( tail + i ) & mask_].item(), *first );
+            }
+        } catch ( ... ) {
+            // Items constructed so far stay queued.
+            tail_.store( tail + i, std::memory_order_release );
+            throw;
+        }
+        if ( n != 0 ) {
+            tail_.store( tail + n, std::memory_order_release );
+        }
+        return n;
+    }
+
+    // Pops up to `count` items into `out` with one index update.
+    // \return Number of items popped, 0 when the ring is empty.
+    template <std::output_iterator<T> It>
+    auto pop_n( It out, size_t count ) -> size_t {
+        const auto head = head_.load( std::memory_order_relaxed );
+        if ( tail_cache_ - head < count ) {
+            tail_cache_ = tail_.load( std::memory_order_acquire );
+        }
+        const auto n = std::min( count, tail_cache_ - head );
+        for ( size_t i = 0; i != n; ++i, ++out ) {
+            auto *slot = slots_[( head + i ) & mask_].item();
+            *out = std::move( *slot );
+            std::destroy_at( slot );
+        }
+        if ( n != 0 ) {
+            head_.store( head + n, std::memory_order_release );
+        }
+        return n;
+    }
+
+    // Waits while the ring is full.
+    template <typename U>
+    auto push_blocking( U &&item ) -> void {
+        block( producer_waits_, [&]() -> bool { return try_emplace( std::forward<U>( item ) ); } );
+        wake( consumer_waits_ );
+    }
+
+    // Waits while the ring is empty.
+    auto pop_blocking( T &item ) -> void {
+        block( consumer_waits_, [&]() -> bool { return pop( item ); } );
+        wake( producer_waits_ );
+    }
+
+    [[nodiscard]]
+    auto capacity() const noexcept -> size_t {
+        //
+        return mask_ + 1;
+    }
+
+    // Approximate, exact only when nobody pushes or pops concurrently.
+    [[nodiscard]]
+    auto size_approx() const noexcept -> size_t {
+        const auto head = head_.load( std::memory_order_relaxed );
+        const auto tail = tail_.load( std::memory_order_relaxed );
+        return tail > head ? tail - head : 0;
+    }
+
 private:
-    const std::size_t capacity_;
-    std::vector<T> buffer_;
-    std::atomic<std::size_t> head_{ 0 };
-    std::atomic<std::size_t> tail_{ 0 };
+    struct slot {
+        alignas( T ) std::byte storage_[sizeof( T )];
+
+        auto item() noexcept -> T * {
+            //
+            return std::launder( reinterpret_cast<T *>( storage_ ) );
+        }
+    };
+
+    // Parks on `flag` until `attempt` succeeds. The fence pairs with the
+    // one in wake(): either the other side sees the flag raised or this
+    // side sees its last update.
+    template <typename Attempt>
+    static auto block( std::atomic<uint32_t> &flag, Attempt attempt ) -> void {
+        for ( unsigned spin = 0; !attempt(); ++spin ) {
+            if ( spin < kQueueSpins ) {
+                pstd::cpuRelax();
+                continue;
+            }
+            flag.store( 1, std::memory_order_relaxed );
+            std::atomic_thread_fence( std::memory_order_seq_cst );
+            if ( attempt() ) {
+                flag.store( 0, std::memory_order_relaxed );
+                return;
+            }
+            pstd::futexWait( flag, 1 );
+        }
+    }
+
+    static auto wake( std::atomic<uint32_t> &flag ) -> void {
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        if ( flag.load( std::memory_order_relaxed ) != 0 && flag.exchange( 0, std::memory_order_relaxed ) != 0 ) {
+            pstd::futexWake( flag );
+        }
+    }
+
+    const size_t mask_;
+    std::unique_ptr<slot[]> slots_;
+
+    // Producer side.
+    alignas( kCacheLine ) std::atomic<size_t> tail_{ 0 };
+    size_t head_cache_{ 0 };
+
+    // Consumer side.
+    alignas( kCacheLine ) std::atomic<size_t> head_{ 0 };
+    size_t tail_cache_{ 0 };
+
+    // Raised by a blocking call about to park.
+    alignas( kCacheLine ) std::atomic<uint32_t> producer_waits_{ 0 };
+    alignas( kCacheLine ) std::atomic<uint32_t> consumer_waits_{ 0 };
+};
+
+// Bounded multi-producer multi-consumer queue, Dmitry Vyukov design.
+// Every cell carries a sequence number telling producers and consumers
+// whose turn it is, so a push or pop is a single CAS on the shared
+// position plus uncontended cell access. Never blocks, try_* fail when
+// the queue is full or empty.
+//
+// Original code:
+// https://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+export template <typename T>
+struct mpmc_lock_free_queue {
+public:
+    // capacity is rounded up to power of two
+    explicit mpmc_lock_free_queue( size_t capacity )
+        : mask_( std::bit_ceil( std::max<size_t>( capacity, 2 ) ) - 1 )
+        , cells_( std::make_unique<cell[]>( mask_ + 1 ) ) {
+        for ( size_t i = 0; i <= mask_; ++i ) {
+            cells_[i].sequence_.store( i, std::memory_order_relaxed );
+        }
+    }
+
+    mpmc_lock_free_queue( const mpmc_lock_free_queue & ) = delete;
+    mpmc_lock_free_queue &operator=( const mpmc_lock_free_queue & ) = delete;
+
+    ~mpmc_lock_free_queue() {
+        const auto tail = enqueue_pos_.load( std::memory_order_relaxed );
+        for ( auto pos = dequeue_pos_.load( std::memory_order_relaxed ); pos != tail; ++pos ) {
+            std::destroy_at( cells_[pos & mask_].item() );
+        }
+    }
+
+    template <typename... Args>
+    auto try_emplace( Args &&...args ) -> bool {
+        auto pos = enqueue_pos_.load( std::memory_order_relaxed );
+        while ( true ) {
+            auto &c = cells_[pos & mask_];
+            const auto seq = c.sequence_.load( std::memory_order_acquire );
+            const auto diff = static_cast<std::ptrdiff_t>( seq ) - static_cast<std::ptrdiff_t>( pos );
+            if ( diff == 0 ) {
+                if ( enqueue_pos_.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) {
+                    std::construct_at( c.item(), std::forward<Args>( args )... );
+                    c.sequence_.store( pos + 1, std::memory_order_release );
+                    return true;
+                }
+            } else if ( diff < 0 ) {
+                // Cell still holds an item from the previous lap.
+                return false;
+            } else {
+                pos = enqueue_pos_.load( std::memory_order_relaxed );
+            }
+        }
+    }
+
+    auto try_push( const T &item ) -> bool {
+        //
+        return try_emplace( item );
+    }
+
+    auto try_push( T &&item ) -> bool {
+        //
+        return try_emplace( std::move( item ) );
+    }
+
+    auto try_pop( T &item ) -> bool {
+        //
+        return try_take( [&item]( T &&value ) -> void { item = std::move( value ); } );
+    }
+
+    // Constructs the item in `item`, for types that are not default
+    // constructible.
+    auto try_pop( std::optional<T> &item ) -> bool {
+        //
+        return try_take( [&item]( T &&value ) -> void { item.emplace( std::move( value ) ); } );
+    }
+
+    [[nodiscard]]
+    auto capacity() const noexcept -> size_t {
+        //
+        return mask_ + 1;
+    }
+
+    // Approximate, exact only when nobody pushes or pops concurrently.
+    [[nodiscard]]
+    auto size_approx() const noexcept -> size_t {
+        const auto head = dequeue_pos_.load( std::memory_order_relaxed );
+        const auto tail = enqueue_pos_.load( std::memory_order_relaxed );
+        return tail > head ? tail - head : 0;
+    }
+
+private:
+    template <typename Sink>
+    auto try_take( Sink &&sink ) -> bool {
+        auto pos = dequeue_pos_.load( std::memory_order_relaxed );
+        while ( true ) {
+            auto &c = cells_[pos & mask_];
+            const auto seq = c.sequence_.load( std::memory_order_acquire );
+            const auto diff = static_cast<std::ptrdiff_t>( seq ) - static_cast<std::ptrdiff_t>( pos + 1 );
+            if ( diff == 0 ) {
+                if ( dequeue_pos_.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) {
+                    sink( std::move( *c.item() ) );
+                    std::destroy_at( c.item() );
+                    c.sequence_.store( pos + mask_ + 1, std::memory_order_release );
+                    return true;
+                }
+            } else if ( diff < 0 ) {
+                // Cell not filled yet.
+                return false;
+            } else {
+                pos = dequeue_pos_.load( std::memory_order_relaxed );
+            }
+        }
+    }
+
+    struct cell {
+        std::atomic<size_t> sequence_;
+        alignas( T ) std::byte storage_[sizeof( T )];
+
+        auto item() noexcept -> T * {
+            //
+            return std::launder( reinterpret_cast<T *>( storage_ ) );
+        }
+    };
+
+    const size_t mask_;
+    std::unique_ptr<cell[]> cells_;
+
+    alignas( kCacheLine ) std::atomic<size_t> enqueue_pos_{ 0 };
+    alignas( kCacheLine ) std::atomic<size_t> dequeue_pos_{ 0 };
 };
 
 export template <typename T>
@@ -133,7 +434,7 @@ private:
 };
 
 // Semaphore based queue.
-template <typename T>
+export template <typename T>
 class semaphore_queue {
 public:
     semaphore_queue( std::size_t capacity )
@@ -1,9 +1,18 @@
 
 export module poller_std;
 
+export import :cacheline;
 export import :tag;
 export import :list;
 export import :queue;
 export import :workstealingdeque;
 export import :array;
 export import :threadpool;
+export import :frame_allocator;
+export import :executor;
+export import :futex;
+export import :generator;
+export import :affinity;
+export import :profiler;
+export import :algorithm;
+export import :timer_wheel;
@@ -1,35 +1,218 @@
 
 module;
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
 #include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <new>
 #include <optional>
+#include <span>
 #include <thread>
+#include <tuple>
+#include <type_traits>
 #include <vector>
 
 export module poller_std:threadpool;
 
+import :cacheline;
 import :workstealingdeque;
+import :queue;
+import :frame_allocator;
+import :futex;
+import :affinity;
+import :profiler;
 
 namespace poller::pstd {
 
 constexpr auto kCancelled = 1;
 constexpr auto kInvoked = 1 << 1;
 
+// Tasks submitted by non-worker threads wait in a shared MPMC ring, a
+// worker that finds its deque empty takes up to kInjectionBatch of them
+// at once and keeps them in its deque, where siblings can steal them.
+constexpr size_t kInjectionCapacity = 1 << 14;
+constexpr unsigned kInjectionBatch = 32;
+
+// Most items a worker takes from a victim's deque in one probe.
+constexpr int kStealBatch = 32;
+
+// Every kFairnessPeriod-th look for work starts at the lowest lane and
+// takes the oldest task, so low priority and early pushed work keep
+// moving under a steady stream of newer, more urgent tasks.
+constexpr uint32_t kFairnessPeriod = 32;
+
+// Idle worker polls for kSpinRounds rounds, doubling the pause count each
+// round, then yields once and parks. Roughly 2^kSpinRounds pauses, a few
+// microseconds, short enough not to burn CPU of a mostly idle pool. On a
+// single CPU spinning only delays the thread that would submit the work,
+// so the pool goes straight to yield.
+constexpr unsigned kSpinRounds = 8;
+
+// Futex word of one worker, parked worker sleeps on it until a submitter
+// takes it off the idle stack and flips it to kNotified.
+struct alignas( kCacheLine ) SleepSlot {
+    static constexpr uint32_t kAwake = 0;
+    static constexpr uint32_t kParked = 1;
+    static constexpr uint32_t kNotified = 2;
+
+    std::atomic<uint32_t> state_{ kAwake };
+};
+
+// Common header of everything that goes through the task queues, lets
+// plain closures skip the task graph machinery.
+struct WorkItem {
+    enum class Kind : uint8_t {
+        kGraph,
+        kClosure,
+        kResume,
+        kPooledResume,
+    };
+
+    Kind kind_{ Kind::kGraph };
+};
+
+// Suspended coroutine queued as is. Lives in the awaiter, i.e. in the
+// coroutine frame, so nothing is allocated and nothing is released after
+// the resume.
+struct ResumeItem final : WorkItem {
+    ResumeItem() noexcept { kind_ = Kind::kResume; }
+
+    // For handles without an awaiter to live in, see ThreadPool::resume().
+    // Node comes from FrameAllocator and is released before the resume.
+    static auto make( const std::coroutine_handle<> handle ) -> ResumeItem * {
+        auto *item = ::new ( FrameAllocator::allocate( sizeof( ResumeItem ) ) ) ResumeItem{};
+        item->kind_ = Kind::kPooledResume;
+        item->handle_ = handle;
+        return item;
+    }
+
+    std::coroutine_handle<> handle_{ nullptr };
+};
+
+/**
+ * \brief Fire-and-forget function submitted with `ThreadPool::submit`.
+ *
+ * Callable is constructed right inside the node, nodes come from
+ * `FrameAllocator` so they are recycled through per-thread free lists
+ * and a node released on a worker goes back to the submitting thread.
+ * Captures larger than `kInlineSize` are moved to the heap. The node is
+ * released and the callable destroyed also when its constructor or the
+ * call throws.
+ */
+struct Closure final : WorkItem {
+    static constexpr size_t kInlineSize = 48;
+
+    template <typename FuncType>
+    static auto make( FuncType &&func ) -> Closure * {
+        using Func = std::decay_t<FuncType>;
+
+        auto *closure = ::new ( FrameAllocator::allocate( sizeof( Closure ) ) ) Closure{};
+        try {
+            if constexpr ( sizeof( Func ) <= kInlineSize && alignof( Func ) <= alignof( std::max_align_t ) ) {
+                ::new ( closure->storage_ ) Func( std::forward<FuncType>( func ) );
+                closure->call_ = []( Closure *self ) -> void {
+                    auto *inline_target = std::launder( reinterpret_cast<Func *>( self->storage_ ) );
+                    const auto target = std::unique_ptr<Func, DestroyAt<Func>>{ inline_target };
+                    ( *target )();
+                };
+            } else {
+                ::new ( closure->storage_ ) Func *( new Func( std::forward<FuncType>( func ) ) );
+                closure->call_ = []( Closure *self ) -> void {
+                    auto *heap_target = *std::launder( reinterpret_cast<Func **>( self->storage_ ) );
+                    const auto target = std::unique_ptr<Func>{ heap_target };
+                    ( *target )();
+                };
+            }
+        } catch ( ... ) {
+            FrameAllocator::deallocate( closure );
+            throw;
+        }
+        return closure;
+    }
+
+    // Invokes callable and releases the node.
+    auto run() -> void {
+        try {
+            call_( this );
+        } catch ( ... ) {
+            FrameAllocator::deallocate( this );
+            throw;
+        }
+        FrameAllocator::deallocate( this );
+    }
+
+private:
+    // Ends the lifetime of the inline callable, on unwinding too.
+    template <typename Func>
+    struct DestroyAt {
+        auto operator()( Func *target ) const noexcept -> void {
+            //
+            std::destroy_at( target );
+        }
+    };
+
+    Closure() noexcept { kind_ = Kind::kClosure; }
+
+    void ( *call_ )( Closure * ){ nullptr };
+    alignas( std::max_align_t ) std::byte storage_[kInlineSize];
+};
+
 // Code below copied from https://github.com/dpuyda/scheduling licensed under the MIT License.
 // Original code:
 // https://github.com/dpuyda/scheduling
 
+export class Task;
+export class Subflow;
+export class ThreadPool;
+
+// State of one submitted graph, shared by its tasks and the `GraphRun`
+// handle. Kept alive by `self_` while the graph is running.
+struct GraphState {
+    ThreadPool *pool_{ nullptr };
+    // Top level tasks, counters are reset from here before every run.
+    std::vector<Task *> tasks_;
+    size_t runs_left_{ 0 };
+    // Tasks scheduled and not finished yet, the run is over at zero.
+    std::atomic<int> pending_{ 0 };
+    std::atomic<bool> cancelled_{ false };
+    std::atomic_flag failed_;
+    std::exception_ptr exception_{ nullptr };
+    // Futex word, 1 once the last run finished.
+    std::atomic<uint32_t> done_{ 0 };
+    // Suspended coroutine, or the state address once done.
+    std::atomic<void *> waiter_{ nullptr };
+    std::shared_ptr<GraphState> self_;
+};
+
 /**
  * \brief Represents a task in a task graph.
  *
  * A task graph is a collection of tasks and dependencies between them.
  * Dependencies between tasks define the order in which the tasks should be
  * executed.
+ *
+ * Besides plain functions a task may be:
+ * - a condition task, a function returning an integer. Only the successor
+ *   with that index runs next, right away and regardless of its other
+ *   dependencies, which allows branches and loops. Out of range index
+ *   runs nothing.
+ * - a subflow task, a function taking `Subflow &`. Tasks it emplaces form
+ *   a nested graph that is joined before successors of the subflow task
+ *   run.
  */
-class Task {
+export class Task : public WorkItem {
 public:
     /**
       * \brief Creates an empty task.
@@ -49,13 +232,47 @@ public:
       *
       * \param func The function to execute.
       */
-    template <typename TaskType, typename = std::enable_if_t<std::convertible_to<TaskType, std::function<void()>>>>
+    template <typename TaskType>
+        requires std::invocable<TaskType &> && ( !std::integral<std::invoke_result_t<TaskType &>> )
     explicit Task( TaskType &&func )
         : func_{ std::forward<TaskType>( func ) } {}
 
+    /**
+      * \brief Creates a condition task.
+      *
+      * \code{.cpp}
+      * int func();
+      * \endcode
+      *
+      * \param func The function returning index of the successor to run.
+      */
+    template <typename TaskType>
+        requires std::invocable<TaskType &> && std::integral<std::invoke_result_t<TaskType &>>
+    explicit Task( TaskType &&func )
+        : condition_{ [func = std::forward<TaskType>( func )]() mutable -> size_t {
+            return static_cast<size_t>( func() );
+        } } {}
+
+    /**
+      * \brief Creates a subflow task.
+      *
+      * \code{.cpp}
+      * void func( Subflow &subflow );
+      * \endcode
+      *
+      * \param func The function that builds the nested graph.
+      */
+    template <typename TaskType>
+        requires std::invocable<TaskType &, Subflow &>
+    explicit Task( TaskType &&func )
+        : subflow_{ std::forward<TaskType>( func ) } {}
+
     Task( const Task &other )
         : total_predecessors_{ other.total_predecessors_ }
+        , weak_predecessors_{ other.weak_predecessors_ }
         , func_{ other.func_ }
+        , condition_{ other.condition_ }
+        , subflow_{ other.subflow_ }
         , next_{ other.next_ } {
         remaining_predecessors_.store( other.remaining_predecessors_ );
         cancellation_flags_.store( other.cancellation_flags_ );
@@ -63,7 +280,10 @@ public:
 
     Task( Task &&other ) noexcept
         : total_predecessors_{ other.total_predecessors_ }
+        , weak_predecessors_{ other.weak_predecessors_ }
         , func_{ std::move( other.func_ ) }
+        , condition_{ std::move( other.condition_ ) }
+        , subflow_{ std::move( other.subflow_ ) }
         , next_{ std::move( other.next_ ) } {
         remaining_predecessors_.store( other.remaining_predecessors_ );
         cancellation_flags_.store( other.cancellation_flags_ );
@@ -71,18 +291,24 @@ public:
 
     Task &operator=( const Task &other ) {
         total_predecessors_ = other.total_predecessors_;
+        weak_predecessors_ = other.weak_predecessors_;
         remaining_predecessors_.store( other.remaining_predecessors_ );
         cancellation_flags_.store( other.cancellation_flags_ );
         func_ = other.func_;
+        condition_ = other.condition_;
+        subflow_ = other.subflow_;
         next_ = other.next_;
         return *this;
     }
 
     Task &operator=( Task &&other ) noexcept {
         total_predecessors_ = other.total_predecessors_;
+        weak_predecessors_ = other.weak_predecessors_;
         remaining_predecessors_.store( other.remaining_predecessors_ );
         cancellation_flags_.store( other.cancellation_flags_ );
         func_ = std::move( other.func_ );
+        condition_ = std::move( other.condition_ );
+        subflow_ = std::move( other.subflow_ );
         next_ = std::move( other.next_ );
         return *this;
     }
@@ -94,11 +320,7 @@ public:
       *
       * \param task A task that should be executed before the current task.
       */
-    void Succeed( Task *task ) {
-        task->next_.push_back( this );
-        ++total_predecessors_;
-        remaining_predecessors_.fetch_add( 1 );
-    }
+    void Succeed( Task *task ) { Link( task, this ); }
 
     /**
       * \brief Defines tasks that should be executed before the current task.
@@ -107,9 +329,7 @@ public:
       */
     template <typename... TasksType>
     void Succeed( Task *task, const TasksType &...tasks ) {
-        task->next_.push_back( this );
-        ++total_predecessors_;
-        remaining_predecessors_.fetch_add( 1 );
+        Link( task, this );
         Succeed( tasks... );
     }
 
@@ -118,11 +338,7 @@ public:
       *
       * \param task A task that should be executed after the current task.
       */
-    void Precede( Task *task ) {
-        next_.push_back( task );
-        ++task->total_predecessors_;
-        task->remaining_predecessors_.fetch_add( 1 );
-    }
+    void Precede( Task *task ) { Link( this, task ); }
 
     /**
       * \brief Defines tasks that should be executed after the current task.
@@ -131,9 +347,7 @@ public:
       */
     template <typename... TasksType>
     void Precede( Task *task, const TasksType &...tasks ) {
-        next_.push_back( task );
-        ++task->total_predecessors_;
-        task->remaining_predecessors_.fetch_add( 1 );
+        Link( this, task );
         Precede( tasks... );
     }
 
@@ -163,11 +377,181 @@ public:
 
 private:
     friend class ThreadPool;
-    bool delete_{ false }, is_root_{ false };
+    friend class Subflow;
+
+    // Edges leaving a condition task are weak: they don't count towards
+    // the successor's join counter, the condition picks one directly.
+    static void Link( Task *from, Task *to ) {
+        from->next_.push_back( to );
+        if ( from->condition_ ) {
+            ++to->weak_predecessors_;
+        } else {
+            ++to->total_predecessors_;
+            to->remaining_predecessors_.fetch_add( 1 );
+        }
+    }
+
+    bool is_root_{ false };
     int total_predecessors_{ 0 };
+    int weak_predecessors_{ 0 };
     std::atomic<int> remaining_predecessors_{ 0 }, cancellation_flags_{ 0 };
     std::function<void()> func_;
+    std::function<size_t()> condition_;
+    std::function<void( Subflow & )> subflow_;
     std::vector<Task *> next_;
+
+    // Set for the duration of a run, both null for a task submitted alone.
+    GraphState *run_{ nullptr };
+    Task *parent_{ nullptr };
+    // Subflow only, children scheduled and not finished yet.
+    std::atomic<int> join_{ 0 };
+    std::vector<std::unique_ptr<Task>> children_;
+};
+
+/**
+ * \brief Builds the nested graph of a subflow task.
+ *
+ * Emplaced tasks live until the subflow joins and are rebuilt on every run
+ * of the enclosing graph, dependencies are defined with `Precede` and
+ * `Succeed` as usual but only between tasks of the same subflow.
+ */
+export class Subflow {
+public:
+    template <typename TaskType>
+    Task *Emplace( TaskType &&func ) {
+        return parent_.children_.emplace_back( std::make_unique<Task>( std::forward<TaskType>( func ) ) ).get();
+    }
+
+    Task *Emplace() {
+        //
+        return parent_.children_.emplace_back( std::make_unique<Task>() ).get();
+    }
+
+private:
+    friend class ThreadPool;
+
+    explicit Subflow( Task &parent )
+        : parent_{ parent } {}
+
+    Task &parent_;
+};
+
+/**
+ * \brief Handle of a submitted task graph.
+ *
+ * Completes when the last requested run of the graph finished, was
+ * cancelled, or one of its tasks threw. Blocking `wait()` from a worker
+ * thread keeps executing other tasks meanwhile. At most one coroutine may
+ * `co_await` the handle.
+ *
+ * \code{.cpp}
+ * auto run = pool.submit( tasks, 100 );
+ * co_await run;
+ * \endcode
+ */
+export class GraphRun {
+public:
+    struct Awaiter {
+        [[nodiscard]]
+        auto await_ready() const noexcept -> bool {
+            //
+            return !state_ || state_->done_.load( std::memory_order_acquire ) != 0;
+        }
+
+        // Fails if the graph finished in the meantime.
+        auto await_suspend( std::coroutine_handle<> handle ) const noexcept -> bool {
+            void *expected = nullptr;
+            return state_->waiter_.compare_exchange_strong( expected, handle.address(), std::memory_order_acq_rel );
+        }
+
+        // Rethrows exception of the first failed task.
+        auto await_resume() const -> void {
+            if ( state_ && state_->exception_ ) {
+                std::rethrow_exception( state_->exception_ );
+            }
+        }
+
+        GraphState *state_;
+    };
+
+    GraphRun() = default;
+
+    [[nodiscard]]
+    auto isDone() const noexcept -> bool {
+        //
+        return !state_ || state_->done_.load( std::memory_order_acquire ) != 0;
+    }
+
+    // Tasks not started yet are skipped, running ones finish normally.
+    auto cancel() -> void {
+        if ( state_ ) {
+            state_->cancelled_.store( true, std::memory_order_relaxed );
+        }
+    }
+
+    // Rethrows exception of the first failed task.
+    auto wait() const -> void;
+
+    auto operator co_await() const noexcept -> Awaiter {
+        //
+        return Awaiter{ state_.get() };
+    }
+
+private:
+    friend class ThreadPool;
+
+    explicit GraphRun( std::shared_ptr<GraphState> state )
+        : state_{ std::move( state ) } {}
+
+    std::shared_ptr<GraphState> state_;
+};
+
+/**
+ * \brief Lane a task is queued in.
+ *
+ * Workers take from higher lanes first, wherever the task is: own deque,
+ * injection queue or a sibling's deque. Latency sensitive work, e.g.
+ * request completions, goes to kHigh and overtakes bulk processing in
+ * kNormal and kLow sharing the pool.
+ */
+export enum class Priority : uint8_t {
+    kHigh,
+    kNormal,
+    kLow,
+};
+
+constexpr size_t kPriorities = 3;
+
+/**
+ * \brief Deadline of a task, see `ThreadPool::submit( func, deadline )`.
+ */
+export using Deadline = std::chrono::steady_clock::time_point;
+
+// Per-queue deques and injection ring of one priority.
+struct Lane {
+    explicit Lane( const unsigned queues )
+        : queues_( queues ) {
+        /* noop */
+    }
+
+    std::vector<poller::WorkStealingDeque<WorkItem *>> queues_;
+    poller::mpmc_lock_free_queue<WorkItem *> injected_{ kInjectionCapacity };
+    // Injected tasks that found the ring full. Submitters never wait for
+    // room and never run tasks themselves, workers drain this once the
+    // ring is empty. Tasks injected while it is not empty queue up behind.
+    std::mutex overflow_mutex_;
+    std::deque<WorkItem *> overflow_;
+    std::atomic<size_t> overflowed_{ 0 };
+    // Tasks anywhere in the lane, an empty high or low lane is skipped
+    // after one load. Not kept for kNormal, which is always searched.
+    std::atomic<size_t> queued_{ 0 };
+};
+
+struct DeadlineEntry {
+    Deadline at_;
+    // Submission order among equal deadlines.
+    uint64_t sequence_;
+    WorkItem *item_;
 };
 
 /**
@@ -175,7 +559,11 @@ private:
     * threads and allows to execute tasks on these threads.
     *
     * The threads, managed by the thread pool, execute tasks in a work-stealing
-    * manner.
+    * manner. Idle threads spin briefly and then park on their own futex word,
+    * a submit wakes one parked thread only when no other is spinning.
+    *
+    * Tasks go to one of the `Priority` lanes, or to the deadline queue that
+    * runs earliest deadline first ahead of all lanes.
     */
 export class ThreadPool {
 public:
@@ -187,13 +575,27 @@ public:
       * instance is destroyed.
       *
       * \param threads_count The number of threads to create.
+      * \param placement CPUs the threads are pinned to, unpinned by default.
+      * Idle threads steal from siblings on their own NUMA node first.
       */
-    explicit ThreadPool( const unsigned threads_count = std::thread::hardware_concurrency() )
+    explicit ThreadPool(
+      const unsigned threads_count = std::thread::hardware_concurrency(), const Placement &placement = {} )
         : queues_count_{ threads_count + 1 }
-        , queues_{ threads_count + 1 } {
+        , lanes_{ { Lane{ threads_count + 1 }, Lane{ threads_count + 1 }, Lane{ threads_count + 1 } } }
+        , victims_( threads_count + 1 )
+        , local_victims_( threads_count + 1 )
+        , slots_( threads_count + 1 )
+        , profiler_{ threads_count + 1 } {
+        orderVictims( placement );
+        idle_.reserve( threads_count );
         threads_.reserve( threads_count );
         for ( unsigned i = 0; i != threads_count; ++i ) {
-            threads_.emplace_back( [this, i] -> void { run( i + 1 ); } );
+            threads_.emplace_back( [this, i, cpu = placement.cpuFor( i )] -> void {
+                if ( cpu ) {
+                    pinCurrentThread( *cpu );
+                }
+                run( i + 1 );
+            } );
         }
     }
 
@@ -205,8 +607,7 @@ public:
     ~ThreadPool() noexcept {
         wait();
         stop_.test_and_set();
-        tasks_count_ += queues_count_;
-        tasks_count_.notify_all();
+        wakeAll();
         for ( auto &thread : threads_ ) {
             thread.join();
         }
@@ -226,13 +627,34 @@ public:
       * void func();
       * \endcode
       *
+      * No `Task` is created: function is stored in a pooled node together
+      * with up to `Closure::kInlineSize` bytes of captures, so steady state
+      * submission does not allocate.
+      *
       * \param func The function to execute.
+      * \param priority Lane of the function.
       */
     template <typename FuncType, typename = std::enable_if_t<std::convertible_to<FuncType, std::function<void()>>>>
-    auto submit( FuncType &&func ) -> void {
-        auto *task = new Task( std::forward<FuncType>( func ) );
-        task->delete_ = true;
-        submit( task );
+    auto submit( FuncType &&func, const Priority priority = Priority::kNormal ) -> void {
+        //
+        push( Closure::make( std::forward<FuncType>( func ) ), priority );
+    }
+
+    /**
+      * \brief Submits a function ordered by deadline.
+      *
+      * Deadline tasks wait in one pool-wide queue and are taken ahead of
+      * every priority lane, earliest deadline first, submission order among
+      * equal ones. The deadline only orders execution, the function does not
+      * wait for it and runs late if the pool is behind.
+      *
+      * \param func The function to execute.
+      * \param deadline When the function should have run.
+      */
+    template <typename FuncType, typename = std::enable_if_t<std::convertible_to<FuncType, std::function<void()>>>>
+    auto submit( FuncType &&func, const Deadline deadline ) -> void {
+        //
+        pushDeadline( Closure::make( std::forward<FuncType>( func ) ), deadline );
     }
 
     /**
@@ -244,12 +666,18 @@ public:
       * the threads managed by the thread pool. The order of task execution is
       * undetermined.
       *
+      * Worker threads push into their own deque. Any other thread, e.g. an
+      * I/O thread, goes through the lock-free injection queue, so any number
+      * of external threads may submit concurrently. If the injection queue
+      * is full the task goes to an overflow list under a mutex, the caller
+      * never blocks on the pool and never runs queued tasks itself.
+      *
       * \param task The task to execute.
       */
     auto submit( Task *task ) -> void {
-        ++tasks_count_;
-        queues_[index_].Push( task );
-        tasks_count_.notify_one();
+        task->run_ = nullptr;
+        task->parent_ = nullptr;
+        push( task );
     }
 
     /**
@@ -260,18 +688,163 @@ public:
       * submitted, the tasks that do not have predecessors are pushed into the
       * thread pool task queues.
       *
+      * The graph is not copied and may be submitted again once the returned
+      * run completed, counters are reset on every run. A graph must not have
+      * two runs in flight at once, use `times` to run it back to back.
+      *
       * \param tasks The tasks to execute.
+      * \param times How many times to run the graph before the run completes.
+      * \return Handle to wait for, await or cancel the run.
       */
     template <typename TasksType>
-    auto submit( TasksType &tasks ) -> void {
+    auto submit( TasksType &tasks, const size_t times = 1 ) -> GraphRun {
+        auto state = std::make_shared<GraphState>();
+        state->pool_ = this;
+        state->runs_left_ = times;
         for ( auto &task : tasks ) {
-            task.is_root_ = task.total_predecessors_ == 0;
+            task.run_ = state.get();
+            task.parent_ = nullptr;
+            task.is_root_ = task.total_predecessors_ == 0 && task.weak_predecessors_ == 0;
+            state->tasks_.push_back( &task );
         }
-        for ( auto &task : tasks ) {
-            if ( task.is_root_ ) {
-                Submit( &task );
+
+        state->self_ = state;
+        if ( times == 0 ) {
+            finishGraph( state.get() );
+        } else {
+            startGraph( state.get() );
+        }
+        return GraphRun{ std::move( state ) };
+    }
+
+    // Continues the awaiting coroutine on a worker, see schedule().
+    struct ScheduleAwaiter {
+        [[nodiscard]]
+        auto await_ready() const noexcept -> bool {
+            //
+            return false;
+        }
+
+        // Frame may be resumed and gone before push() returns, nothing
+        // here touches the awaiter after the handle is queued.
+        auto await_suspend( std::coroutine_handle<> handle ) noexcept -> void {
+            item_.handle_ = handle;
+            if ( yield_ ) {
+                pool_.inject( &item_, priority_ );
+            } else {
+                pool_.push( &item_, priority_ );
             }
         }
+
+        auto await_resume() const noexcept -> void {
+            //
+        }
+
+        ThreadPool &pool_;
+        Priority priority_{ Priority::kNormal };
+        bool yield_{ false };
+        ResumeItem item_{};
+    };
+
+    // Calls the function on a worker, see run().
+    template <typename Fn>
+    struct RunAwaiter : ScheduleAwaiter {
+        auto await_resume() -> std::invoke_result_t<Fn &> {
+            //
+            return std::invoke( fn_ );
+        }
+
+        Fn fn_;
+    };
+
+    /**
+      * \brief Moves the awaiting coroutine onto the pool.
+      *
+      * The coroutine handle itself goes into the task queue, no closure
+      * or allocation per hop. Code after the `co_await` runs on a worker:
+      *
+      * \code{.cpp}
+      * auto handle( Response response ) -> poller::Task<void> {
+      *     co_await pool.schedule();
+      *     auto parsed = parse( response );  // off the curl thread
+      *     ...
+      * }
+      * \endcode
+      *
+      * A pool without workers resumes it only inside `wait(predicate)`.
+      */
+    [[nodiscard]]
+    auto schedule( const Priority priority = Priority::kNormal ) noexcept -> ScheduleAwaiter {
+        //
+        return ScheduleAwaiter{ *this, priority };
+    }
+
+    /**
+      * \brief Lets a long running coroutine step aside.
+      *
+      * The coroutine is queued behind the tasks already waiting in the
+      * shared injection queue, the worker runs its own queued tasks first
+      * and idle siblings may pick the coroutine up. Awaited outside the
+      * pool it works like `schedule()`.
+      */
+    [[nodiscard]]
+    auto yield( const Priority priority = Priority::kNormal ) noexcept -> ScheduleAwaiter {
+        //
+        return ScheduleAwaiter{ *this, priority, true };
+    }
+
+    /**
+      * \brief Runs a function on a worker and resumes with its result.
+      *
+      * \code{.cpp}
+      * auto document = co_await pool.run( [&]() -> Json { return Json::parse( body ); } );
+      * \endcode
+      *
+      * Same as `co_await schedule()` followed by the call, exceptions of
+      * the function propagate to the awaiting coroutine, which keeps
+      * running on the worker afterwards. The function is stored in the
+      * awaiter, not copied into a task.
+      */
+    template <typename Fn>
+        requires std::invocable<Fn &>
+    [[nodiscard]]
+    auto run( Fn fn, const Priority priority = Priority::kNormal ) -> RunAwaiter<Fn> {
+        //
+        return RunAwaiter<Fn>{ { *this, priority }, std::move( fn ) };
+    }
+
+    /**
+      * \brief Resumes every coroutine on the pool, each one a task of its own.
+      *
+      * Handles are queued at once and the pool is notified once for the
+      * whole batch, waking as many parked workers as there are handles.
+      * Siblings steal single continuations, so a batch spreads over all
+      * idle cores. Queue nodes come from `FrameAllocator`, steady state
+      * submission does not allocate.
+      *
+      * \param handles Suspended coroutines, each resumed exactly once.
+      * \param priority Lane of the continuations.
+      */
+    auto resume( const std::span<const std::coroutine_handle<>> handles, const Priority priority = Priority::kNormal )
+      -> void {
+        if ( handles.empty() ) {
+            return;
+        }
+        auto &lane = this->lane( priority );
+        tasks_count_.fetch_add( static_cast<unsigned>( handles.size() ) );
+        if ( priority != Priority::kNormal ) {
+            lane.queued_.fetch_add( handles.size(), std::memory_order_relaxed );
+        }
+        if ( const auto i = self(); i != 0 ) {
+            for ( const auto handle : handles ) {
+                lane.queues_[i].Push( ResumeItem::make( handle ) );
+            }
+        } else {
+            for ( const auto handle : handles ) {
+                enqueueInjected( ResumeItem::make( handle ), lane );
+            }
+        }
+        notify( handles.size() );
     }
 
     /**
@@ -290,8 +863,8 @@ public:
     template <typename PredicateType>
     auto wait( const PredicateType &predicate ) -> void {
         while ( !predicate() ) {
-            if ( auto *task = getTask() ) {
-                execute( task );
+            if ( auto *item = getTask() ) {
+                execute( item );
             }
         }
     }
@@ -308,69 +881,660 @@ public:
         }
     }
 
+    // Number of worker threads, callers of wait() come on top.
+    [[nodiscard]]
+    auto size() const noexcept -> size_t {
+        //
+        return threads_.size();
+    }
+
+    /**
+      * \brief Scheduling events recorded so far.
+      *
+      * Tasks, steals and idle intervals of every worker, exported as a
+      * Chrome trace or summed up into utilization, steal ratio and queue
+      * depth histogram. Records nothing unless built with
+      * `POLLER_THREADPOOL_PROFILING`, see `kThreadPoolProfiling`.
+      */
+    [[nodiscard]]
+    auto profiler() const noexcept -> const ThreadPoolProfilerType & {
+        //
+        return profiler_;
+    }
+
 private:
     auto run( const unsigned i ) -> void {
+        owner_ = this;
         index_ = i;
-        for ( auto attempts = 0;; ) {
-            if ( constexpr auto max_attempts = 100; ++attempts > max_attempts ) {
-                tasks_count_.wait( 0 );
+        seed_ = ( i + 1 ) * 0x9E3779B9u;
+        // Start of the current idle interval, profiling only.
+        [[maybe_unused]] std::optional<uint64_t> idle_since{};
+        while ( true ) {
+            auto *item = getTask();
+            if ( !item && !stop_.test() ) {
+                if constexpr ( kThreadPoolProfiling ) {
+                    if ( !idle_since ) {
+                        idle_since = profiler_.now();
+                    }
+                }
+                item = spin();
+                if ( !item && !stop_.test() ) {
+                    item = park( i );
+                }
+            }
+            if constexpr ( kThreadPoolProfiling ) {
+                if ( idle_since && ( item || stop_.test() ) ) {
+                    profiler_.idle( i, *idle_since, profiler_.now() );
+                    idle_since.reset();
+                }
             }
-            if ( auto *task = getTask() ) {
-                execute( task );
-                attempts = 0;
+            if ( item ) {
+                execute( item );
             } else if ( stop_.test() ) {
                 return;
             }
         }
     }
 
-    auto execute( Task *task ) -> void {
-        for ( Task *next = nullptr; task; next = nullptr ) {
-            task->remaining_predecessors_.store( task->total_predecessors_ );
-            if ( task->cancellation_flags_.fetch_or( kInvoked ) & kCancelled ) {
+    // Polls for work with exponential backoff before parking, a task
+    // submitted meanwhile is picked up without a futex round trip.
+    auto spin() -> WorkItem * {
+        spinning_.fetch_add( 1 );
+        WorkItem *task{ nullptr };
+        for ( unsigned round = 0; round != spin_rounds_ && !task; ++round ) {
+            for ( unsigned k = 0; k != 1u << round; ++k ) {
+                cpuRelax();
+            }
+            task = getTask();
+        }
+        if ( !task ) {
+            std::this_thread::yield();
+            task = getTask();
+        }
+        // Submitters don't wake anybody while someone spins. The last
+        // spinner that found work hands the role over, more tasks may
+        // have come in behind this one.
+        if ( spinning_.fetch_sub( 1 ) == 1 && task ) {
+            notify();
+        }
+        return task;
+    }
+
+    // Eventcount wait: announce, re-check, sleep. Work pushed before the
+    // fence is found by the re-check, anything pushed after it sees the
+    // worker on the idle stack. Returns the task the re-check found.
+    auto park( const unsigned i ) -> WorkItem * {
+        auto &state = slots_[i].state_;
+        {
+            auto lock = std::lock_guard{ idle_mutex_ };
+            state.store( SleepSlot::kParked, std::memory_order_relaxed );
+            idle_.push_back( i );
+            sleepers_.fetch_add( 1, std::memory_order_relaxed );
+        }
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+
+        if ( auto *item = getTask() ) {
+            unpark( i );
+            return item;
+        }
+        if ( stop_.test() ) {
+            unpark( i );
+            return nullptr;
+        }
+
+        while ( state.load( std::memory_order_acquire ) == SleepSlot::kParked ) {
+            futexWait( state, SleepSlot::kParked );
+        }
+        return nullptr;
+    }
+
+    // Leaves the idle stack without sleeping. If a submitter already took
+    // this worker off the stack the wakeup is simply consumed, the worker
+    // is about to look for work anyway.
+    auto unpark( const unsigned i ) -> void {
+        auto lock = std::lock_guard{ idle_mutex_ };
+        for ( auto it = idle_.begin(); it != idle_.end(); ++it ) {
+            if ( *it == i ) {
+                idle_.erase( it );
+                sleepers_.fetch_sub( 1, std::memory_order_relaxed );
                 break;
             }
-            if ( task->func_ ) {
-                task->func_();
+        }
+        slots_[i].state_.store( SleepSlot::kAwake, std::memory_order_relaxed );
+    }
+
+    // Called after `count` tasks became visible. Costs a fence and two
+    // loads while every worker is busy or spinning, otherwise wakes one
+    // parked worker per task not covered by a spinning one. A worker
+    // woken from park() doesn't pass the role on like a spinner does, so
+    // a batch has to wake its workers itself.
+    auto notify( const size_t count = 1 ) -> void {
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        const auto spinning = spinning_.load( std::memory_order_relaxed );
+        if ( spinning >= count ) {
+            return;
+        }
+        for ( auto left = count - spinning; left != 0 && sleepers_.load( std::memory_order_relaxed ) != 0; --left ) {
+            if ( !wakeOne() ) {
+                return;
+            }
+        }
+    }
+
+    // Takes one worker off the idle stack, false if there was none.
+    auto wakeOne() -> bool {
+        SleepSlot *slot{ nullptr };
+        {
+            auto lock = std::lock_guard{ idle_mutex_ };
+            if ( idle_.empty() ) {
+                return false;
+            }
+            // Most recently parked worker, its caches are still warm.
+            slot = &slots_[idle_.back()];
+            idle_.pop_back();
+            sleepers_.fetch_sub( 1, std::memory_order_relaxed );
+            // Flipped under the lock so unpark() never sees a stale
+            // notification landing on its next park.
+            slot->state_.store( SleepSlot::kNotified, std::memory_order_release );
+        }
+        futexWake( slot->state_ );
+        return true;
+    }
+
+    auto wakeAll() -> void {
+        auto lock = std::lock_guard{ idle_mutex_ };
+        for ( const auto i : idle_ ) {
+            slots_[i].state_.store( SleepSlot::kNotified, std::memory_order_release );
+            futexWake( slots_[i].state_ );
+        }
+        sleepers_.fetch_sub( static_cast<unsigned>( idle_.size() ), std::memory_order_relaxed );
+        idle_.clear();
+    }
+
+    auto push( WorkItem *item, const Priority priority = Priority::kNormal ) -> void {
+        const auto i = self();
+        if ( i == 0 ) {
+            inject( item, priority );
+            return;
+        }
+        ++tasks_count_;
+        enqueued( priority );
+        lane( priority ).queues_[i].Push( item );
+        notify();
+    }
+
+    // Through the shared ring even from a worker, behind everything
+    // already injected.
+    auto inject( WorkItem *item, const Priority priority = Priority::kNormal ) -> void {
+        ++tasks_count_;
+        enqueued( priority );
+        enqueueInjected( item, lane( priority ) );
+        notify();
+    }
+
+    // Ring is full or already spilled, keep the order and don't wait: the
+    // submitter may be an I/O thread that must not run or wait for foreign
+    // work.
+    static auto enqueueInjected( WorkItem *item, Lane &lane ) -> void {
+        if ( lane.overflowed_.load( std::memory_order_relaxed ) != 0 || !lane.injected_.try_push( item ) ) {
+            auto lock = std::lock_guard{ lane.overflow_mutex_ };
+            lane.overflow_.push_back( item );
+            lane.overflowed_.fetch_add( 1, std::memory_order_relaxed );
+        }
+    }
+
+    auto pushDeadline( WorkItem *item, const Deadline deadline ) -> void {
+        ++tasks_count_;
+        {
+            auto lock = std::lock_guard{ deadline_mutex_ };
+            deadlines_.push_back( { deadline, deadline_sequence_++, item } );
+            std::push_heap( deadlines_.begin(), deadlines_.end(), isLater );
+            deadline_count_.fetch_add( 1, std::memory_order_relaxed );
+        }
+        notify();
+    }
+
+    // Heap order, earliest deadline on top.
+    static auto isLater( const DeadlineEntry &a, const DeadlineEntry &b ) noexcept -> bool {
+        //
+        return std::tie( a.at_, a.sequence_ ) > std::tie( b.at_, b.sequence_ );
+    }
+
+    auto lane( const Priority priority ) noexcept -> Lane & {
+        //
+        return lanes_[static_cast<size_t>( priority )];
+    }
+
+    // Counted before the task becomes visible, so a worker re-checking
+    // after park()'s fence never skips a lane that has work.
+    auto enqueued( const Priority priority ) noexcept -> void {
+        if ( priority != Priority::kNormal ) {
+            lane( priority ).queued_.fetch_add( 1, std::memory_order_relaxed );
+        }
+    }
+
+    auto dequeued( const Priority priority ) noexcept -> void {
+        if ( priority != Priority::kNormal ) {
+            lane( priority ).queued_.fetch_sub( 1, std::memory_order_relaxed );
+        }
+    }
+
+    auto execute( WorkItem *item ) -> void {
+        [[maybe_unused]] uint64_t begin{ 0 };
+        [[maybe_unused]] unsigned depth{ 0 };
+        if constexpr ( kThreadPoolProfiling ) {
+            for ( auto &lane : lanes_ ) {
+                depth += self() != 0 ? static_cast<unsigned>( lane.queues_[self()].Size() ) : 0;
+            }
+            begin = profiler_.now();
+        }
+
+        // A throwing task still counts as done, or ~ThreadPool would wait
+        // for it forever. Only reachable from wait( predicate ), workers
+        // terminate.
+        struct Done {
+            ThreadPool &pool_;
+
+            ~Done() {
+                if ( pool_.tasks_count_.fetch_sub( 1 ) == 1 ) {
+                    pool_.tasks_count_.notify_all();
+                }
+            }
+        } done{ *this };
+
+        switch ( item->kind_ ) {
+            case WorkItem::Kind::kClosure: {
+                static_cast<Closure *>( item )->run();
+                break;
+            }
+            case WorkItem::Kind::kResume: {
+                static_cast<ResumeItem *>( item )->handle_.resume();
+                break;
+            }
+            case WorkItem::Kind::kPooledResume: {
+                const auto handle = static_cast<ResumeItem *>( item )->handle_;
+                FrameAllocator::deallocate( item );
+                handle.resume();
+                break;
+            }
+            case WorkItem::Kind::kGraph: {
+                executeGraph( static_cast<Task *>( item ) );
+                break;
+            }
+        }
+
+        if constexpr ( kThreadPoolProfiling ) {
+            profiler_.task( self(), begin, profiler_.now(), depth );
+        }
+    }
+
+    auto executeGraph( Task *task ) -> void {
+        for ( Task *next = nullptr; task; task = next, next = nullptr ) {
+            auto *state = task->run_;
+            task->remaining_predecessors_.store( task->total_predecessors_ );
+            if ( task->cancellation_flags_.fetch_or( kInvoked ) & kCancelled || isCancelled( state ) ) {
+                finishTask( task );
+                continue;
+            }
+
+            auto selected = std::numeric_limits<size_t>::max();
+            try {
+                if ( task->condition_ ) {
+                    selected = task->condition_();
+                } else if ( task->subflow_ ) {
+                    auto subflow = Subflow{ *task };
+                    task->subflow_( subflow );
+                } else if ( task->func_ ) {
+                    task->func_();
+                }
+            } catch ( ... ) {
+                // A task submitted alone has nobody to report to.
+                if ( !state ) {
+                    throw;
+                }
+                if ( !state->failed_.test_and_set() ) {
+                    state->exception_ = std::current_exception();
+                }
+                state->cancelled_.store( true, std::memory_order_relaxed );
+            }
+
+            if ( isCancelled( state ) ) {
+                task->children_.clear();
+                finishTask( task );
+            } else if ( !task->children_.empty() ) {
+                // Finished by the last child, see finishTask().
+                next = startSubflow( task );
+            } else {
+                next = scheduleSuccessors( task, selected );
+                finishTask( task );
+            }
+        }
+    }
+
+    static auto isCancelled( const GraphState *state ) -> bool {
+        //
+        return state && state->cancelled_.load( std::memory_order_relaxed );
+    }
+
+    // Tasks scheduled and not finished in the scope of `task`: its subflow
+    // parent or the whole run.
+    static auto scopeCounter( Task *task ) -> std::atomic<int> * {
+        if ( task->parent_ ) {
+            return &task->parent_->join_;
+        }
+        return task->run_ ? &task->run_->pending_ : nullptr;
+    }
+
+    // Pushes ready successors except one, which is returned to run inline.
+    // Successors are counted in the scope before `task` leaves it.
+    auto scheduleSuccessors( Task *task, const size_t selected ) -> Task * {
+        auto *counter = scopeCounter( task );
+        Task *next{ nullptr };
+        const auto schedule = [&]( Task *successor ) -> void {
+            if ( counter ) {
+                counter->fetch_add( 1, std::memory_order_relaxed );
+            }
+            if ( next ) {
+                submit( successor, task );
+            } else {
+                next = successor;
+            }
+        };
+
+        if ( task->condition_ ) {
+            if ( selected < task->next_.size() ) {
+                schedule( task->next_[selected] );
             }
-            auto it = task->next_.begin();
-            for ( ; it != task->next_.end(); ++it ) {
-                if ( ( *it )->remaining_predecessors_.fetch_sub( 1 ) == 1 ) {
-                    next = *it++;
-                    break;
+        } else {
+            for ( auto *successor : task->next_ ) {
+                if ( successor->remaining_predecessors_.fetch_sub( 1 ) == 1 ) {
+                    schedule( successor );
                 }
             }
-            for ( ; it != task->next_.end(); ++it ) {
-                if ( ( *it )->remaining_predecessors_.fetch_sub( 1 ) == 1 ) {
-                    submit( *it );
+        }
+        return next;
+    }
+
+    // Successors inherit the run and subflow parent of their predecessor.
+    auto submit( Task *task, const Task *from ) -> void {
+        task->run_ = from->run_;
+        task->parent_ = from->parent_;
+        push( task );
+    }
+
+    // Starts children emplaced by a subflow task, returns one root to run
+    // inline. A nested graph without roots is only a cycle, dropped.
+    auto startSubflow( Task *task ) -> Task * {
+        auto roots = std::vector<Task *>{};
+        for ( auto &child : task->children_ ) {
+            child->run_ = task->run_;
+            child->parent_ = task;
+            child->remaining_predecessors_.store( child->total_predecessors_, std::memory_order_relaxed );
+            if ( child->total_predecessors_ == 0 && child->weak_predecessors_ == 0 ) {
+                roots.push_back( child.get() );
+            }
+        }
+        if ( roots.empty() ) {
+            task->children_.clear();
+            auto *next = scheduleSuccessors( task, std::numeric_limits<size_t>::max() );
+            finishTask( task );
+            return next;
+        }
+
+        task->join_.store( static_cast<int>( roots.size() ), std::memory_order_relaxed );
+        for ( size_t k = 1; k != roots.size(); ++k ) {
+            push( roots[k] );
+        }
+        return roots.front();
+    }
+
+    // Leaves the scope of `task`. Last child of a subflow completes its
+    // parent, last task of the run completes the run. Nothing touches
+    // `task` afterwards, a joined subflow frees its children right here.
+    auto finishTask( Task *task ) -> void {
+        auto *counter = scopeCounter( task );
+        if ( !counter || counter->fetch_sub( 1, std::memory_order_acq_rel ) != 1 ) {
+            return;
+        }
+
+        if ( auto *parent = task->parent_ ) {
+            parent->children_.clear();
+            if ( !isCancelled( parent->run_ ) ) {
+                if ( auto *next = scheduleSuccessors( parent, std::numeric_limits<size_t>::max() ) ) {
+                    submit( next, parent );
                 }
             }
-            if ( task->delete_ ) {
-                delete task;
+            finishTask( parent );
+        } else {
+            finishGraph( task->run_ );
+        }
+    }
+
+    // Counters are reset for every run, a cancelled run may have left them
+    // half way. Roots are counted before the first one is pushed so an
+    // early finisher can't see the run empty.
+    auto startGraph( GraphState *state ) -> void {
+        auto roots = 0;
+        for ( auto *task : state->tasks_ ) {
+            task->remaining_predecessors_.store( task->total_predecessors_, std::memory_order_relaxed );
+            roots += task->is_root_ ? 1 : 0;
+        }
+        if ( roots == 0 ) {
+            finishGraph( state );
+            return;
+        }
+
+        state->pending_.store( roots, std::memory_order_relaxed );
+        // Run may be over and the state and tasks gone as soon as the last
+        // root is pushed, stop right there.
+        for ( auto it = state->tasks_.begin(); roots != 0; ++it ) {
+            if ( ( *it )->is_root_ ) {
+                --roots;
+                push( *it );
             }
-            task = next;
         }
-        if ( tasks_count_.fetch_sub( 1 ) == 1 ) {
-            tasks_count_.notify_all();
+    }
+
+    auto finishGraph( GraphState *state ) -> void {
+        if ( !isCancelled( state ) && state->runs_left_ > 1 ) {
+            --state->runs_left_;
+            startGraph( state );
+            return;
+        }
+
+        for ( auto *task : state->tasks_ ) {
+            task->run_ = nullptr;
+        }
+
+        // Handle may be gone already, our reference keeps the state alive
+        // until the end of this function.
+        const auto self = std::move( state->self_ );
+        state->done_.store( 1, std::memory_order_release );
+        futexWake( state->done_, std::numeric_limits<int>::max() );
+        if ( auto *waiter = state->waiter_.exchange( state, std::memory_order_acq_rel ) ) {
+            const auto handle = std::coroutine_handle<>::from_address( waiter );
+            push( Closure::make( [handle]() -> void { handle.resume(); } ) );
         }
     }
 
-    auto getTask() -> Task * {
-        const auto i = index_;
-        auto *task = queues_[i].Pop();
+    auto getTask() -> WorkItem * {
+        const auto i = self();
+        if ( ++picks_ % kFairnessPeriod == 0 ) {
+            for ( auto p = kPriorities; p-- != 0; ) {
+                if ( auto *task = takeFrom( i, static_cast<Priority>( p ), true ) ) {
+                    return task;
+                }
+            }
+        }
+        if ( auto *task = takeDeadline() ) {
+            return task;
+        }
+        for ( size_t p = 0; p != kPriorities; ++p ) {
+            if ( auto *task = takeFrom( i, static_cast<Priority>( p ), false ) ) {
+                return task;
+            }
+        }
+        return nullptr;
+    }
+
+    // Own deque, then the injection ring, then siblings. `oldest` takes
+    // from the top of the own deque too, where thieves take from.
+    auto takeFrom( const unsigned i, const Priority priority, const bool oldest ) -> WorkItem * {
+        auto &lane = this->lane( priority );
+        if ( priority != Priority::kNormal && lane.queued_.load( std::memory_order_relaxed ) == 0 ) {
+            return nullptr;
+        }
+        // Deque is single owner, queues_[0] is never used since any number of
+        // non-worker threads may be inside wait() at once.
+        WorkItem *task{ nullptr };
+        if ( i != 0 ) {
+            task = oldest ? lane.queues_[i].Steal() : lane.queues_[i].Pop();
+        }
+        if ( !task ) {
+            task = takeInjected( i, lane );
+        }
+        if ( !task ) {
+            task = steal( i, lane );
+        }
         if ( task ) {
+            dequeued( priority );
+        }
+        return task;
+    }
+
+    auto takeDeadline() -> WorkItem * {
+        if ( deadline_count_.load( std::memory_order_relaxed ) == 0 ) {
+            return nullptr;
+        }
+        auto lock = std::lock_guard{ deadline_mutex_ };
+        if ( deadlines_.empty() ) {
+            return nullptr;
+        }
+        std::pop_heap( deadlines_.begin(), deadlines_.end(), isLater );
+        auto *item = deadlines_.back().item_;
+        deadlines_.pop_back();
+        deadline_count_.fetch_sub( 1, std::memory_order_relaxed );
+        return item;
+    }
+
+    auto steal( const unsigned i, Lane &lane ) -> WorkItem * {
+        // Same node victims first, then the rest, each group from a random
+        // start so thieves spread over victims instead of queueing on one.
+        const auto &victims = victims_[i];
+        const auto local = local_victims_[i];
+        const auto random = nextRandom();
+        const auto stealFrom = [&]( unsigned j ) -> WorkItem * {
+            // Non-worker threads have no deque to take a batch into.
+            auto *task = i != 0 ? lane.queues_[j].StealHalf( lane.queues_[i], kStealBatch ) : lane.queues_[j].Steal();
+            if constexpr ( kThreadPoolProfiling ) {
+                if ( task ) {
+                    const auto count = i != 0 ? lane.queues_[i].Size() + 1 : 1;
+                    profiler_.steal( i, j, static_cast<unsigned>( count ), profiler_.now() );
+                }
+            }
             return task;
+        };
+        for ( size_t k = 0; k != local; ++k ) {
+            if ( auto *task = stealFrom( victims[( random + k ) % local] ) ) {
+                return task;
+            }
         }
-        for ( unsigned j = 1; j != queues_count_; ++j ) {
-            task = queues_[( i + j ) % queues_count_].Steal();
-            if ( task ) {
+        const auto remote = victims.size() - local;
+        for ( size_t k = 0; k != remote; ++k ) {
+            if ( auto *task = stealFrom( victims[local + ( ( random >> 16 ) + k ) % remote] ) ) {
                 return task;
             }
         }
         return nullptr;
     }
 
+    // xorshift32, only has to scatter thieves over victims.
+    static auto nextRandom() noexcept -> uint32_t {
+        auto x = seed_;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return seed_ = x;
+    }
+
+    // Steal candidates of every queue: siblings on the same NUMA node
+    // first, a cross-node steal drags the task's data over the
+    // interconnect. Non-worker threads have no node and treat everybody
+    // as local.
+    auto orderVictims( const Placement &placement ) -> void {
+        const auto &topology = CpuTopology::get();
+        const auto nodeOf = [&]( unsigned i ) -> unsigned {
+            const auto cpu = placement.cpuFor( i - 1 );
+            return cpu ? topology.nodeOf( *cpu ) : 0;
+        };
+
+        for ( unsigned i = 0; i != queues_count_; ++i ) {
+            auto &victims = victims_[i];
+            for ( unsigned j = 1; j != queues_count_; ++j ) {
+                if ( const auto victim = ( i + j ) % queues_count_; victim != 0 ) {
+                    victims.push_back( victim );
+                }
+            }
+            local_victims_[i] = victims.size();
+            if ( i != 0 ) {
+                const auto node = nodeOf( i );
+                const auto remote =
+                  std::ranges::stable_partition( victims, [&]( unsigned j ) -> bool { return nodeOf( j ) == node; } );
+                local_victims_[i] = static_cast<size_t>( remote.begin() - victims.begin() );
+            }
+        }
+    }
+
+    // Takes one injected task to run now. Workers also move a batch into their
+    // own deque, one CAS per task instead of a trip to the shared ring each.
+    auto takeInjected( const unsigned i, Lane &lane ) -> WorkItem * {
+        WorkItem *task{ nullptr };
+        if ( !lane.injected_.try_pop( task ) ) {
+            return takeOverflow( i, lane );
+        }
+        if ( i != 0 ) {
+            WorkItem *more{ nullptr };
+            for ( unsigned k = 1; k != kInjectionBatch && lane.injected_.try_pop( more ); ++k ) {
+                lane.queues_[i].Push( more );
+            }
+        }
+        return task;
+    }
+
+    // Same as takeInjected() for tasks that did not fit into the ring.
+    auto takeOverflow( const unsigned i, Lane &lane ) -> WorkItem * {
+        if ( lane.overflowed_.load( std::memory_order_relaxed ) == 0 ) {
+            return nullptr;
+        }
+        auto lock = std::lock_guard{ lane.overflow_mutex_ };
+        if ( lane.overflow_.empty() ) {
+            return nullptr;
+        }
+        const auto count = i != 0 ? std::min<size_t>( lane.overflow_.size(), kInjectionBatch ) : 1;
+        auto *task = lane.overflow_.front();
+        lane.overflow_.pop_front();
+        for ( size_t k = 1; k != count; ++k ) {
+            lane.queues_[i].Push( lane.overflow_.front() );
+            lane.overflow_.pop_front();
+        }
+        lane.overflowed_.fetch_sub( count, std::memory_order_relaxed );
+        return task;
+    }
+
+    // Queue of the calling thread in this pool, 0 for threads that are
+    // not its workers, workers of other pools included.
+    [[nodiscard]]
+    auto self() const noexcept -> unsigned {
+        //
+        return owner_ == this ? index_ : 0;
+    }
+
+    friend class GraphRun;
+
+    static thread_local const ThreadPool *owner_;
     static thread_local unsigned index_;
+    static thread_local uint32_t seed_;
+    static thread_local uint32_t picks_;
 
     const unsigned queues_count_;
 
@@ -378,9 +1542,46 @@ private:
     std::atomic<unsigned> tasks_count_;
 
     std::vector<std::thread> threads_;
-    std::vector<poller::WorkStealingDeque<Task *>> queues_;
+    std::array<Lane, kPriorities> lanes_;
+    std::vector<std::vector<unsigned>> victims_;
+    std::vector<size_t> local_victims_;
+
+    // Earliest deadline first, see submit( func, deadline ).
+    std::mutex deadline_mutex_;
+    std::vector<DeadlineEntry> deadlines_;
+    uint64_t deadline_sequence_{ 0 };
+    std::atomic<size_t> deadline_count_{ 0 };
+
+    // Parking state, see park() and notify().
+    const unsigned spin_rounds_{ std::thread::hardware_concurrency() > 1 ? kSpinRounds : 0 };
+    std::atomic<unsigned> spinning_{ 0 };
+    std::atomic<unsigned> sleepers_{ 0 };
+    std::mutex idle_mutex_;
+    std::vector<unsigned> idle_;
+    std::vector<SleepSlot> slots_;
+
+    [[no_unique_address]] ThreadPoolProfilerType profiler_;
 };
 
+inline auto GraphRun::wait() const -> void {
+    if ( !state_ ) {
+        return;
+    }
+    if ( ThreadPool::owner_ == state_->pool_ ) {
+        // Blocking a worker could starve the graph, help it instead.
+        state_->pool_->wait( [this]() -> bool { return isDone(); } );
+    }
+    while ( state_->done_.load( std::memory_order_acquire ) == 0 ) {
+        futexWait( state_->done_, 0 );
+    }
+    if ( state_->exception_ ) {
+        std::rethrow_exception( state_->exception_ );
+    }
+}
+
+inline thread_local const ThreadPool *ThreadPool::owner_{ nullptr };
 inline thread_local unsigned ThreadPool::index_{ 0 };
+inline thread_local uint32_t ThreadPool::seed_{ 0x9E3779B9u };
+inline thread_local uint32_t ThreadPool::picks_{ 0 };
 
 }  // namespace poller::pstd
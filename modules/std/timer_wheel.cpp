@@ -0,0 +1,403 @@
+module;
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <utility>
+
+export module poller_std:timer_wheel;
+
+namespace poller::pstd {
+
+// Every level has 64 slots, a slot of level L is 64^L ticks wide. Eleven
+// levels cover the whole 64 bit tick range, no timer is ever too far out.
+constexpr unsigned kWheelBits = 6;
+constexpr unsigned kWheelSlots = 1u << kWheelBits;
+constexpr unsigned kWheelLevels = ( 64 + kWheelBits - 1 ) / kWheelBits;
+
+// Lists kept next to the wheel slots: due, waiting for the next advance(),
+// and being fired by the current one.
+constexpr uint16_t kExpiredList = kWheelLevels * kWheelSlots;
+constexpr uint16_t kFiringList = kExpiredList + 1;
+constexpr uint16_t kUnarmed = std::numeric_limits<uint16_t>::max();
+
+export class TimerWheel;
+
+/**
+ * \brief Intrusive timer node of a `TimerWheel`.
+ *
+ * Lives wherever its owner puts it, usually embedded in a request or
+ * connection object, the wheel only links it. Destroying an armed timer
+ * cancels it.
+ */
+export class Timer {
+public:
+    using Callback = void ( * )( Timer & );
+
+    explicit Timer( Callback callback ) noexcept
+        : callback_{ callback } {
+        /* noop */
+    }
+
+    Timer( const Timer & ) = delete;
+    Timer( Timer && ) = delete;
+    auto operator=( const Timer & ) -> Timer & = delete;
+    auto operator=( Timer && ) -> Timer & = delete;
+
+    ~Timer() noexcept;
+
+    [[nodiscard]]
+    auto armed() const noexcept -> bool {
+        //
+        return slot_ != kUnarmed;
+    }
+
+private:
+    friend class TimerWheel;
+
+    Callback callback_;
+    Timer *next_{ nullptr };
+    // Pointer that points to this node, list head or previous node's next_.
+    Timer **link_{ nullptr };
+    TimerWheel *wheel_{ nullptr };
+    uint64_t expires_{ 0 };
+    // Ticks between runs, 0 for a one-shot timer.
+    uint64_t period_{ 0 };
+    uint16_t slot_{ kUnarmed };
+};
+
+/**
+ * \brief `Timer` calling a stored function object.
+ *
+ *   CallbackTimer keepAlive{ [&]() -> void { connection.ping(); } };
+ */
+export template <typename Fn>
+class CallbackTimer final : public Timer {
+public:
+    explicit CallbackTimer( Fn fn )
+        : Timer{ &CallbackTimer::fire }
+        , fn_{ std::move( fn ) } {
+        /* noop */
+    }
+
+private:
+    static auto fire( Timer &timer ) -> void {
+        //
+        static_cast<CallbackTimer &>( timer ).fn_();
+    }
+
+    Fn fn_;
+};
+
+/**
+ * \brief Hierarchical timing wheel for delayed and periodic work.
+ *
+ * Schedule, cancel and reschedule are O(1) and never allocate, timers
+ * are intrusive nodes owned by the caller. Time is counted in ticks of
+ * `resolution`: 1ms or finer for request deadlines, 10-100ms for
+ * keep-alive checks and retry backoffs where firing a bit late is fine
+ * and cascades are rarer. A timer never fires before its deadline and at
+ * most one tick plus the advance() period after it.
+ *
+ * The wheel has no thread of its own and is not thread safe. One thread
+ * at a time drives it, typically an event loop or a ThreadPool task, and
+ * schedules from callbacks or between advance() calls:
+ *
+ *   TimerWheel wheel{ 10ms };
+ *   CallbackTimer retry{ [&]() -> void { pool.submit( resend ); } };
+ *   wheel.schedule( retry, 250ms );
+ *   ...
+ *   wheel.advance();
+ *   if ( const auto next = wheel.nextExpiry() ) {
+ *       uv_timer_start( &wake, onWake, ceil<milliseconds>( *next ).count(), 0 );
+ *   }
+ *
+ * Delays count from the time of the last advance(), as libuv's do from
+ * uv_now().
+ */
+export class TimerWheel final {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit TimerWheel(
+      const Clock::duration resolution = std::chrono::milliseconds{ 1 }, const Clock::time_point start = Clock::now() )
+        : resolution_{ std::max( resolution, Clock::duration{ 1 } ) }
+        , origin_{ start }
+        , current_{ start } {
+        /* noop */
+    }
+
+    TimerWheel( const TimerWheel & ) = delete;
+    TimerWheel( TimerWheel && ) = delete;
+    auto operator=( const TimerWheel & ) -> TimerWheel & = delete;
+    auto operator=( TimerWheel && ) -> TimerWheel & = delete;
+
+    ~TimerWheel() noexcept {
+        // Timers outlive the wheel only as unarmed nodes.
+        for ( auto *head : slots_ ) {
+            for ( auto *timer = head; timer; timer = timer->next_ ) {
+                timer->slot_ = kUnarmed;
+                timer->wheel_ = nullptr;
+            }
+        }
+    }
+
+    /**
+     * \brief Arms `timer` to fire `delay` from now, then every `period`
+     * if it is not zero. An armed timer is moved, from another wheel too.
+     */
+    auto schedule( Timer &timer, const Clock::duration delay, const Clock::duration period = {} ) -> void {
+        //
+        scheduleAt( timer, current_ + delay, period );
+    }
+
+    auto scheduleAt( Timer &timer, const Clock::time_point deadline, const Clock::duration period = {} ) -> void {
+        if ( timer.wheel_ ) {
+            timer.wheel_->unlink( timer );
+        }
+        timer.expires_ = ticksUntil( deadline );
+        timer.period_ = period > Clock::duration::zero() ? std::max<uint64_t>( ticksIn( period ), 1 ) : 0;
+        insert( timer );
+    }
+
+    // Moves the next run of `timer`, keeping its period.
+    auto reschedule( Timer &timer, const Clock::duration delay ) -> void {
+        const auto period = timer.period_;
+        if ( timer.wheel_ ) {
+            timer.wheel_->unlink( timer );
+        }
+        timer.expires_ = ticksUntil( current_ + delay );
+        timer.period_ = period;
+        insert( timer );
+    }
+
+    // \return `false` if the timer was not armed on this wheel.
+    auto cancel( Timer &timer ) noexcept -> bool {
+        if ( timer.wheel_ != this ) {
+            return false;
+        }
+        unlink( timer );
+        return true;
+    }
+
+    /**
+     * \brief Moves wheel time to `now` and runs callbacks of every timer
+     * that became due, in no particular order.
+     *
+     * Callbacks may schedule and cancel any timer, destroy their own one
+     * included. Timers that become due from inside a callback fire on the
+     * next advance(), so a callback rearming itself with no delay can't
+     * spin here.
+     *
+     * \return Number of callbacks run.
+     */
+    auto advance( const Clock::time_point now = Clock::now() ) -> size_t {
+        current_ = std::max( current_, now );
+        const auto target = ticksIn( current_ - origin_ );
+        if ( target > now_ ) {
+            cascade( target );
+        }
+
+        while ( auto *timer = slots_[kExpiredList] ) {
+            unlink( *timer );
+            link( *timer, kFiringList );
+        }
+
+        size_t fired = 0;
+        while ( auto *timer = slots_[kFiringList] ) {
+            unlink( *timer );
+            if ( timer->period_ != 0 ) {
+                timer->expires_ += timer->period_;
+                // Runs missed while the wheel was not advanced are dropped.
+                if ( timer->expires_ <= now_ ) {
+                    timer->expires_ = now_ + timer->period_;
+                }
+                insert( *timer );
+            }
+            ++fired;
+            // Timer may be gone after its callback.
+            timer->callback_( *timer );
+        }
+        return fired;
+    }
+
+    /**
+     * \brief Time until the wheel needs the next advance(), nullopt when
+     * no timer is armed.
+     *
+     * Exact for timers within 64 ticks, earlier than the deadline for
+     * farther ones, whose slot is then cascaded closer. Sleeping for it
+     * never makes a timer late.
+     */
+    [[nodiscard]]
+    auto nextExpiry() const noexcept -> std::optional<Clock::duration> {
+        if ( slots_[kExpiredList] || slots_[kFiringList] ) {
+            return Clock::duration::zero();
+        }
+
+        auto best = std::numeric_limits<uint64_t>::max();
+        for ( unsigned level = 0; level != kWheelLevels; ++level ) {
+            const auto mask = occupied_[level];
+            if ( mask == 0 ) {
+                continue;
+            }
+            const auto shift = level * kWheelBits;
+            const auto position = now_ >> shift;
+            // Slots after the current one, wrapping around.
+            const auto rotated = std::rotr( mask, static_cast<int>( ( position + 1 ) % kWheelSlots ) );
+            const auto ahead = static_cast<uint64_t>( std::countr_zero( rotated ) ) + 1;
+            best = std::min( best, ( position + ahead ) << shift );
+        }
+        if ( best == std::numeric_limits<uint64_t>::max() ) {
+            return std::nullopt;
+        }
+        const auto at = origin_ + resolution_ * static_cast<Clock::rep>( best );
+        return std::max( at - current_, Clock::duration::zero() );
+    }
+
+    [[nodiscard]]
+    auto size() const noexcept -> size_t {
+        //
+        return size_;
+    }
+
+    [[nodiscard]]
+    auto empty() const noexcept -> bool {
+        //
+        return size_ == 0;
+    }
+
+    [[nodiscard]]
+    auto resolution() const noexcept -> Clock::duration {
+        //
+        return resolution_;
+    }
+
+    // Wheel time, as of the last advance().
+    [[nodiscard]]
+    auto now() const noexcept -> Clock::time_point {
+        //
+        return current_;
+    }
+
+private:
+    // Whole ticks in `duration`, rounded down.
+    [[nodiscard]]
+    auto ticksIn( const Clock::duration duration ) const noexcept -> uint64_t {
+        //
+        return duration > Clock::duration::zero() ? static_cast<uint64_t>( duration / resolution_ ) : 0;
+    }
+
+    // First tick at or after `deadline`.
+    [[nodiscard]]
+    auto ticksUntil( const Clock::time_point deadline ) const noexcept -> uint64_t {
+        const auto since = deadline - origin_;
+        if ( since <= Clock::duration::zero() ) {
+            return 0;
+        }
+        return static_cast<uint64_t>( ( since + resolution_ - Clock::duration{ 1 } ) / resolution_ );
+    }
+
+    // Level is picked by the highest tick bit where expiry and wheel time
+    // differ, so a timer waits in the coarsest slot that still tells it
+    // apart from now and moves down as the wheel reaches that slot.
+    auto insert( Timer &timer ) noexcept -> void {
+        if ( timer.expires_ <= now_ ) {
+            link( timer, kExpiredList );
+            return;
+        }
+        const auto highest = 63 - std::countl_zero( timer.expires_ ^ now_ );
+        const auto level = static_cast<unsigned>( highest ) / kWheelBits;
+        const auto slot = ( timer.expires_ >> ( level * kWheelBits ) ) % kWheelSlots;
+        link( timer, static_cast<uint16_t>( level * kWheelSlots + slot ) );
+        occupied_[level] |= uint64_t{ 1 } << slot;
+    }
+
+    auto link( Timer &timer, const uint16_t slot ) noexcept -> void {
+        auto &head = slots_[slot];
+        timer.next_ = head;
+        if ( head ) {
+            head->link_ = &timer.next_;
+        }
+        head = &timer;
+        timer.link_ = &head;
+        timer.slot_ = slot;
+        timer.wheel_ = this;
+        ++size_;
+    }
+
+    auto unlink( Timer &timer ) noexcept -> void {
+        *timer.link_ = timer.next_;
+        if ( timer.next_ ) {
+            timer.next_->link_ = timer.link_;
+        }
+        if ( timer.slot_ < kExpiredList && !slots_[timer.slot_] ) {
+            occupied_[timer.slot_ / kWheelSlots] &= ~( uint64_t{ 1 } << ( timer.slot_ % kWheelSlots ) );
+        }
+        timer.next_ = nullptr;
+        timer.link_ = nullptr;
+        timer.slot_ = kUnarmed;
+        timer.wheel_ = nullptr;
+        --size_;
+    }
+
+    // Takes every slot the wheel passed on the way to `target`, on every
+    // level, and reinserts its timers against the new time: due ones go
+    // to the expired list, the rest one or more levels down.
+    auto cascade( const uint64_t target ) noexcept -> void {
+        Timer *pending{ nullptr };
+        for ( unsigned level = 0; level != kWheelLevels; ++level ) {
+            const auto shift = level * kWheelBits;
+            const auto from = now_ >> shift;
+            const auto to = target >> shift;
+            if ( from == to ) {
+                break;
+            }
+            auto mask = occupied_[level];
+            if ( to - from < kWheelSlots ) {
+                // Slots from + 1 to `to`, wrapping around.
+                const auto passed = ( uint64_t{ 1 } << ( to - from ) ) - 1;
+                mask &= std::rotl( passed, static_cast<int>( ( from + 1 ) % kWheelSlots ) );
+            }
+            occupied_[level] &= ~mask;
+            for ( ; mask != 0; mask &= mask - 1 ) {
+                auto &head = slots_[level * kWheelSlots + std::countr_zero( mask )];
+                while ( auto *timer = head ) {
+                    head = timer->next_;
+                    timer->next_ = pending;
+                    pending = timer;
+                    --size_;
+                }
+            }
+        }
+
+        now_ = target;
+        while ( auto *timer = pending ) {
+            pending = timer->next_;
+            insert( *timer );
+        }
+    }
+
+private:
+    Clock::duration resolution_;
+    Clock::time_point origin_;
+    Clock::time_point current_;
+    // Ticks since origin_, wheel slots up to it are processed.
+    uint64_t now_{ 0 };
+    size_t size_{ 0 };
+    std::array<uint64_t, kWheelLevels> occupied_{};
+    std::array<Timer *, kFiringList + 1> slots_{};
+};
+
+inline Timer::~Timer() noexcept {
+    if ( wheel_ ) {
+        wheel_->cancel( *this );
+    }
+}
+
+}  // namespace poller::pstd
@@ -1,6 +1,7 @@
 
 module;
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <functional>
@@ -11,6 +12,7 @@ module;
 
 export module poller_std:workstealingdeque;
 
+import :cacheline;
 import :array;
 
 namespace poller {
@@ -19,14 +21,15 @@ namespace poller {
 // the Apache License 2.0.
 // Original code:
 // https://github.com/google/filament/blob/main/libs/utils/include/utils/WorkStealingDequeue.h
-template <typename T>
+export template <typename T>
     requires std::is_pointer_v<T>
 class WorkStealingDeque {
 public:
     explicit WorkStealingDeque( const int capacity = 1024 )
         : top_{ 0 }
         , bottom_{ 0 }
-        , array_{ new Array<T>{ capacity } } {
+        , array_{ new Array<T>{ capacity } }
+        , min_capacity_{ capacity } {
         assert( capacity && ( capacity & capacity - 1 ) == 0 );
         garbage_.reserve( 64 );
     }
@@ -57,6 +60,7 @@ public:
         // std::memory_order_release is used because we release the item we just
         // pushed to other threads which are calling steal().
         bottom_.store( bottom + 1, std::memory_order_release );
+        NoteOccupancy( array, bottom + 1, top );
     }
 
     [[nodiscard]] T Pop() {
@@ -80,7 +84,9 @@ public:
         if ( top < bottom ) {
             // The queue isn't empty, and it's not the last item, just return it, this
             // is the common case.
-            return array->Get( bottom );
+            const auto item = array->Get( bottom );
+            NoteOccupancy( array, bottom, top );
+            return item;
         }
         T item{ nullptr };
         if ( top == bottom ) {
@@ -108,6 +114,7 @@ public:
         // std::memory_order_relaxed used because we're not publishing any data. No
         // concurrent writes to bottom_ possible, it's always safe to write bottom_.
         bottom_.store( top, std::memory_order_relaxed );
+        NoteOccupancy( array, top, top );
         return item;
     }
 
@@ -128,9 +135,14 @@ public:
             return nullptr;
         }
 
-        // The queue isn't empty.
-        auto *array = array_.load( std::memory_order_acquire );
+        // The queue isn't empty. Announce ourselves before loading array_, the
+        // owner doesn't free a retired array while anybody may still read it.
+        // std::memory_order_seq_cst pairs with the array_ store and stealers_
+        // load in Reclaim().
+        stealers_.fetch_add( 1, std::memory_order_seq_cst );
+        auto *array = array_.load( std::memory_order_seq_cst );
         const auto item = array->Get( top );
+        stealers_.fetch_sub( 1, std::memory_order_release );
         if ( !top_.compare_exchange_strong( top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) ) {
             // Failure: the item we just tried to steal was pop()'ed under our feet,
             // simply discard it; nothing to do -- it's okay to try again.
@@ -140,22 +152,107 @@ public:
         return item;
     }
 
+    // Takes up to half of the items, at most `limit`, from the top. The first
+    // one is returned, the rest go into `thief`, which must be owned by the
+    // calling thread. A thief that finds a deep queue walks away with a batch
+    // and doesn't come back for every item, and its siblings can steal the
+    // batch from it in turn.
+    //
+    // Every item is still claimed by its own CAS on top_: pop() takes items
+    // without CAS while it sees top_ below bottom_, so claiming a range at
+    // once could hand the same item to both sides. Consecutive CASes hit a
+    // cache line the thief already owns, which is the cheap part anyway.
+    [[nodiscard]] T StealHalf( WorkStealingDeque &thief, const int limit ) {
+        const auto size = bottom_.load( std::memory_order_relaxed ) - top_.load( std::memory_order_relaxed );
+        const auto first = Steal();
+        if ( !first ) {
+            return nullptr;
+        }
+        for ( auto count = std::min( size / 2, limit ) - 1; count > 0; --count ) {
+            const auto item = Steal();
+            if ( !item ) {
+                // Empty or lost a race, either way others are here too.
+                break;
+            }
+            thief.Push( item );
+        }
+        return first;
+    }
+
+    // Items left, exact only for the owner while nobody steals.
+    [[nodiscard]] int Size() const {
+        const auto size = bottom_.load( std::memory_order_relaxed ) - top_.load( std::memory_order_relaxed );
+        return size > 0 ? size : 0;
+    }
+
 private:
+    // Number of consecutive push()/pop() calls that must see the queue less
+    // than a quarter full before it shrinks, a single quiet moment between
+    // bursts shouldn't trigger a copy.
+    static constexpr int kShrinkAfter = 1024;
+
     [[nodiscard]] Array<T> *Resize( Array<T> *array, const size_t bottom, const size_t top ) {
-        auto *tmp = array->Resize( bottom, top );
+        return Replace( array, array->Resize( bottom, top ) );
+    }
+
+    Array<T> *Replace( Array<T> *array, Array<T> *tmp ) {
         garbage_.push_back( array );
         std::swap( array, tmp );
-        array_.store( array, std::memory_order_release );
+        // std::memory_order_seq_cst, see Reclaim().
+        array_.store( array, std::memory_order_seq_cst );
+        Reclaim();
         return array;
     }
 
-#ifdef __cpp_lib_hardware_interference_size
-    alignas( std::hardware_destructive_interference_size ) std::atomic<int> top_, bottom_;
-#else
-    std::atomic<int> top_, bottom_;
-#endif
+    // Frees retired arrays once no steal() is in flight. A stealer announced
+    // after our stealers_ load is ordered after the array_ store as well and
+    // can only see the current array. Under constant stealing this may keep
+    // failing, we simply retry on the next push()/pop().
+    void Reclaim() {
+        if ( stealers_.load( std::memory_order_seq_cst ) != 0 ) {
+            return;
+        }
+        for ( auto *array : garbage_ ) {
+            delete array;
+        }
+        garbage_.clear();
+    }
+
+    // Owner only, live items are [top, bottom). Shrinks a queue inflated by a
+    // burst once the load has stayed low for kShrinkAfter operations, down to
+    // the smallest power of two at least four times the current size.
+    void NoteOccupancy( Array<T> *array, const int bottom, const int top ) {
+        if ( !garbage_.empty() ) {
+            Reclaim();
+        }
+
+        const auto capacity = array->Capacity();
+        const auto size = bottom - top;
+        if ( capacity <= min_capacity_ || size >= capacity / 4 ) {
+            low_occupancy_ = 0;
+            return;
+        }
+        if ( ++low_occupancy_ != kShrinkAfter ) {
+            return;
+        }
+        low_occupancy_ = 0;
+
+        auto target = capacity / 2;
+        while ( target > min_capacity_ && size < target / 4 ) {
+            target /= 2;
+        }
+        Replace( array, array->Resize( bottom, top, target ) );
+    }
+
+    // stealers_ shares the line with top_, steal() writes both anyway.
+    alignas( kCacheLine ) std::atomic<int> top_;
+    std::atomic<int> stealers_{ 0 };
+    alignas( kCacheLine ) std::atomic<int> bottom_;
     std::atomic<Array<T> *> array_;
+    // Arrays replaced by Resize() or a shrink, owner only.
     std::vector<Array<T> *> garbage_;
+    const int min_capacity_;
+    int low_occupancy_{ 0 };
 };
 
 }  // namespace poller
\ No newline at end of file